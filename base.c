@@ -1,6 +1,15 @@
+#include <assert.h>
 #include <endian.h>
+#include <errno.h>
+#include <linux/futex.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "base.h"
 
@@ -79,6 +88,77 @@ int unpack_pldm_header(const struct pldm_msg_hdr *msg,
 	return PLDM_SUCCESS;
 }
 
+int pack_pldm_header_fast(uint8_t msg_type, uint8_t instance_id,
+			  uint8_t pldm_type, uint8_t command,
+			  struct pldm_msg_hdr *msg)
+{
+	/* Rq and D bits by message type, with the reserved one invalid */
+	static const uint8_t rq_d[] = {0x00, 0x80, 0xff, 0xc0};
+
+	if (msg == NULL || msg_type > PLDM_ASYNC_REQUEST_NOTIFY) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+	uint8_t bits = rq_d[msg_type];
+	if ((instance_id & ~PLDM_INSTANCE_ID_MASK) |
+	    (pldm_type & ~PLDM_MSG_TYPE_MASK) | (bits & ~PLDM_RQ_D_MASK)) {
+		return pldm_type & ~PLDM_MSG_TYPE_MASK
+			   ? PLDM_ERROR_INVALID_PLDM_TYPE
+			   : PLDM_ERROR_INVALID_DATA;
+	}
+
+	/* The first two bytes in one store */
+	uint16_t bytes = htole16((bits | instance_id) |
+				 (PLDM_CURRENT_VERSION << 6 | pldm_type) << 8);
+	memcpy(msg, &bytes, sizeof(bytes));
+	msg->command = command;
+
+	return PLDM_SUCCESS;
+}
+
+int unpack_pldm_header_fast(const struct pldm_msg_hdr *msg, uint8_t *msg_type,
+			    uint8_t *instance_id, uint8_t *pldm_type,
+			    uint8_t *command)
+{
+	/* Message type by Rq and D bits, as unpack_pldm_header() */
+	static const uint8_t msg_types[] = {PLDM_RESPONSE, PLDM_RESPONSE,
+					    PLDM_REQUEST,
+					    PLDM_ASYNC_REQUEST_NOTIFY};
+
+	if (msg == NULL) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	uint8_t bytes[sizeof(struct pldm_msg_hdr)];
+	memcpy(bytes, msg, sizeof(bytes));
+	*msg_type = msg_types[(bytes[0] & PLDM_RQ_D_MASK) >> PLDM_RQ_D_SHIFT];
+	*instance_id = bytes[0] & PLDM_INSTANCE_ID_MASK;
+	*pldm_type = bytes[1] & PLDM_MSG_TYPE_MASK;
+	*command = bytes[2];
+
+	return PLDM_SUCCESS;
+}
+
+size_t validate_pldm_headers(const struct pldm_msg_hdr *hdrs, size_t count,
+			     bool *valid)
+{
+	const uint8_t *bytes = (const uint8_t *)hdrs;
+	size_t num_valid = 0;
+
+	/* No branches, so that the loop vectorizes */
+	for (size_t i = 0; i < count; ++i) {
+		uint8_t byte0 = bytes[i * sizeof(struct pldm_msg_hdr)];
+		uint8_t byte1 = bytes[i * sizeof(struct pldm_msg_hdr) + 1];
+		bool ok = !(byte0 & 0x20) &
+			  ((byte0 & PLDM_RQ_D_MASK) != 0x40) &
+			  ((byte1 & ~PLDM_MSG_TYPE_MASK) ==
+			   PLDM_CURRENT_VERSION << 6);
+		valid[i] = ok;
+		num_valid += ok;
+	}
+
+	return num_valid;
+}
+
 int encode_get_types_req(uint8_t instance_id, struct pldm_msg *msg)
 {
 	if (msg == NULL) {
@@ -555,3 +635,1833 @@ int encode_header_only_request(const uint8_t instance_id,
 
 	return rc;
 }
+
+/* An instance ID is in use while its bit is set in map. owner holds the time
+ * it was acquired in its low bits, or 0 while it is free or being acquired or
+ * released, so that only IDs held for the whole expiry interval are taken
+ * over. The high bits count the times it was handed out, so that the owner
+ * word doubles as the token a holder releases the ID with, and a holder whose
+ * ID was taken over cannot release it.
+ */
+#define INSTANCE_ID_TIME_MASK ((UINT64_C(1) << 48) - 1)
+
+struct instance_id_map {
+	_Atomic uint32_t map;
+	_Atomic uint32_t waiters;
+	_Atomic uint32_t next; /* where to look for a free ID first */
+	_Atomic uint64_t owner[PLDM_INSTANCE_MAX];
+};
+
+typedef struct pldm_instance_id_alloc {
+	uint32_t expiry_ms;
+	uint64_t (*now_ms)(void);
+	struct instance_id_map tids[PLDM_TID_MAX + 1];
+} pldm_instance_id_alloc;
+
+static uint64_t instance_id_now_ms()
+{
+	/* Milliseconds are plenty for expiry, and the coarse clock is cheaper */
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+
+	/* Never 0 */
+	return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000 + 1;
+}
+
+/* The owner word of the next holder of an ID */
+static uint64_t instance_id_next_owner(uint64_t owner, uint64_t now)
+{
+	return ((owner | INSTANCE_ID_TIME_MASK) + 1) |
+	       (now & INSTANCE_ID_TIME_MASK);
+}
+
+pldm_instance_id_alloc *pldm_instance_id_alloc_init(uint32_t expiry_ms)
+{
+	pldm_instance_id_alloc *alloc =
+	    calloc(1, sizeof(pldm_instance_id_alloc));
+	assert(alloc != NULL);
+	alloc->expiry_ms = expiry_ms;
+	alloc->now_ms = instance_id_now_ms;
+
+	return alloc;
+}
+
+void pldm_instance_id_alloc_destroy(pldm_instance_id_alloc *alloc)
+{
+	assert(alloc != NULL);
+
+	free(alloc);
+}
+
+void pldm_instance_id_alloc_set_clock(pldm_instance_id_alloc *alloc,
+				      uint64_t (*now_ms)(void))
+{
+	assert(alloc != NULL);
+
+	alloc->now_ms = now_ms != NULL ? now_ms : instance_id_now_ms;
+}
+
+/* Take over an ID that was held for longer than the expiry interval */
+static bool instance_id_reclaim(const pldm_instance_id_alloc *alloc,
+				struct instance_id_map *ids, uint64_t now,
+				uint8_t *instance_id, uint64_t *token)
+{
+	for (uint8_t i = 0; i < PLDM_INSTANCE_MAX; ++i) {
+		uint64_t owner =
+		    atomic_load_explicit(&ids->owner[i], memory_order_acquire);
+		uint64_t acquired_at = owner & INSTANCE_ID_TIME_MASK;
+		/* Another thread may have acquired the ID after now was read */
+		if (acquired_at == 0 || acquired_at >= now ||
+		    now - acquired_at < alloc->expiry_ms) {
+			continue;
+		}
+		uint64_t next = instance_id_next_owner(owner, now);
+		if (atomic_compare_exchange_strong_explicit(
+			&ids->owner[i], &owner, next, memory_order_acq_rel,
+			memory_order_relaxed)) {
+			*instance_id = i;
+			*token = next;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int pldm_instance_id_try_acquire(pldm_instance_id_alloc *alloc, uint8_t tid,
+				 uint8_t *instance_id, uint64_t *token)
+{
+	if (alloc == NULL || instance_id == NULL || token == NULL) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	struct instance_id_map *ids = &alloc->tids[tid];
+	uint32_t map = atomic_load_explicit(&ids->map, memory_order_relaxed);
+	uint8_t id;
+	do {
+		if (map == UINT32_MAX) {
+			if (instance_id_reclaim(alloc, ids, alloc->now_ms(),
+						instance_id, token)) {
+				return PLDM_SUCCESS;
+			}
+			return PLDM_ERROR_NOT_READY;
+		}
+
+		/* Go round the IDs rather than reuse the last one released,
+		 * so that a late response is less likely to match a new
+		 * request
+		 */
+		uint32_t next =
+		    atomic_load_explicit(&ids->next, memory_order_relaxed);
+		uint32_t free_ids = ~map;
+		uint32_t after_next = free_ids & (UINT32_MAX << next);
+		id = __builtin_ctz(after_next ? after_next : free_ids);
+	} while (!atomic_compare_exchange_weak_explicit(
+	    &ids->map, &map, map | 1u << id, memory_order_acquire,
+	    memory_order_relaxed));
+
+	atomic_store_explicit(&ids->next, (id + 1) % PLDM_INSTANCE_MAX,
+			      memory_order_relaxed);
+	/* Nobody else writes owner while it is 0 and the bit is set */
+	uint64_t owner =
+	    atomic_load_explicit(&ids->owner[id], memory_order_relaxed);
+	*token = instance_id_next_owner(owner, alloc->now_ms());
+	atomic_store_explicit(&ids->owner[id], *token, memory_order_release);
+	*instance_id = id;
+
+	return PLDM_SUCCESS;
+}
+
+int pldm_instance_id_acquire(pldm_instance_id_alloc *alloc, uint8_t tid,
+			     uint32_t timeout_ms, uint8_t *instance_id,
+			     uint64_t *token)
+{
+	if (alloc == NULL || instance_id == NULL || token == NULL) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	int rc = pldm_instance_id_try_acquire(alloc, tid, instance_id, token);
+	if (rc != PLDM_ERROR_NOT_READY) {
+		return rc;
+	}
+
+	/* The timeout is measured on the monotonic clock the wait sleeps on,
+	 * the expiry of IDs on the allocator's clock
+	 */
+	struct instance_id_map *ids = &alloc->tids[tid];
+	uint64_t deadline = instance_id_now_ms() + timeout_ms;
+	for (; rc == PLDM_ERROR_NOT_READY;
+	     rc = pldm_instance_id_try_acquire(alloc, tid, instance_id,
+					       token)) {
+		uint64_t now = instance_id_now_ms();
+		if (now >= deadline) {
+			break;
+		}
+
+		/* Wake up in time to reclaim the oldest ID */
+		uint64_t wait_ms = deadline - now;
+		now = alloc->now_ms();
+		for (uint8_t i = 0; i < PLDM_INSTANCE_MAX; ++i) {
+			uint64_t acquired_at =
+			    atomic_load_explicit(&ids->owner[i],
+						 memory_order_relaxed) &
+			    INSTANCE_ID_TIME_MASK;
+			if (acquired_at == 0) {
+				continue;
+			}
+			uint64_t expires_at = acquired_at + alloc->expiry_ms;
+			uint64_t until = expires_at > now ? expires_at - now : 0;
+			if (until < wait_ms) {
+				wait_ms = until;
+			}
+		}
+
+		struct timespec timeout = {.tv_sec = wait_ms / 1000,
+					   .tv_nsec =
+					       (wait_ms % 1000) * 1000000};
+		atomic_fetch_add_explicit(&ids->waiters, 1,
+					  memory_order_seq_cst);
+		/* Sleep only while all IDs are still in use */
+		syscall(SYS_futex, (uint32_t *)&ids->map, FUTEX_WAIT_PRIVATE,
+			UINT32_MAX, &timeout, NULL, 0);
+		atomic_fetch_sub_explicit(&ids->waiters, 1,
+					  memory_order_relaxed);
+	}
+
+	return rc;
+}
+
+int pldm_instance_id_release(pldm_instance_id_alloc *alloc, uint8_t tid,
+			     uint8_t instance_id, uint64_t token)
+{
+	if (alloc == NULL || instance_id >= PLDM_INSTANCE_MAX ||
+	    (token & INSTANCE_ID_TIME_MASK) == 0) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	/* Fails if the ID was released already or taken over since */
+	struct instance_id_map *ids = &alloc->tids[tid];
+	uint64_t owner = token;
+	if (!atomic_compare_exchange_strong_explicit(
+		&ids->owner[instance_id], &owner,
+		token & ~INSTANCE_ID_TIME_MASK, memory_order_acq_rel,
+		memory_order_relaxed)) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+	atomic_fetch_and_explicit(&ids->map, ~(1u << instance_id),
+				  memory_order_seq_cst);
+
+	if (atomic_load_explicit(&ids->waiters, memory_order_seq_cst)) {
+		syscall(SYS_futex, (uint32_t *)&ids->map, FUTEX_WAKE_PRIVATE,
+			1, NULL, NULL, 0);
+	}
+
+	return PLDM_SUCCESS;
+}
+
+int pldm_instance_id_encode_request_header(pldm_instance_id_alloc *alloc,
+					   uint8_t tid, uint8_t pldm_type,
+					   uint8_t command, struct pldm_msg *msg,
+					   uint64_t *token)
+{
+	if (msg == NULL) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	uint8_t instance_id;
+	int rc = pldm_instance_id_try_acquire(alloc, tid, &instance_id, token);
+	if (rc != PLDM_SUCCESS) {
+		return rc;
+	}
+
+	rc = encode_pldm_header(instance_id, pldm_type, command, PLDM_REQUEST,
+				msg);
+	if (rc != PLDM_SUCCESS) {
+		pldm_instance_id_release(alloc, tid, instance_id, *token);
+	}
+
+	return rc;
+}
+
+#define REQUEST_TRACKER_NONE UINT16_MAX
+#define REQUEST_TRACKER_SLOTS 256
+
+struct request_tracker_entry {
+	uint64_t deadline_ms;
+	void *context;
+	uint16_t prev; /* in the timer wheel slot */
+	uint16_t next;
+	uint8_t slot;
+	uint8_t pldm_type;
+	uint8_t command;
+	bool in_use;
+};
+
+/* Entries are indexed by TID and instance ID. The timer wheel has a list of
+ * entries per tick of resolution_ms, modulo the number of slots; entries
+ * due in a later turn of the wheel are skipped until then.
+ */
+typedef struct pldm_request_tracker {
+	struct request_tracker_entry
+	    entries[(PLDM_TID_MAX + 1) * PLDM_INSTANCE_MAX];
+	uint16_t slots[REQUEST_TRACKER_SLOTS];
+	uint64_t tick; /* next tick to expire */
+	uint32_t resolution_ms;
+} pldm_request_tracker;
+
+pldm_request_tracker *pldm_request_tracker_init(uint32_t resolution_ms,
+						uint64_t now_ms)
+{
+	assert(resolution_ms != 0);
+
+	pldm_request_tracker *tracker = malloc(sizeof(pldm_request_tracker));
+	assert(tracker != NULL);
+	memset(tracker->entries, 0, sizeof(tracker->entries));
+	for (size_t i = 0; i < REQUEST_TRACKER_SLOTS; ++i) {
+		tracker->slots[i] = REQUEST_TRACKER_NONE;
+	}
+	tracker->resolution_ms = resolution_ms;
+	tracker->tick = now_ms / resolution_ms;
+
+	return tracker;
+}
+
+void pldm_request_tracker_destroy(pldm_request_tracker *tracker)
+{
+	assert(tracker != NULL);
+
+	free(tracker);
+}
+
+static void request_tracker_unlink(pldm_request_tracker *tracker,
+				   uint16_t idx)
+{
+	struct request_tracker_entry *entry = &tracker->entries[idx];
+	if (entry->prev != REQUEST_TRACKER_NONE) {
+		tracker->entries[entry->prev].next = entry->next;
+	} else {
+		tracker->slots[entry->slot] = entry->next;
+	}
+	if (entry->next != REQUEST_TRACKER_NONE) {
+		tracker->entries[entry->next].prev = entry->prev;
+	}
+	entry->in_use = false;
+}
+
+int pldm_request_tracker_register(pldm_request_tracker *tracker, uint8_t tid,
+				  uint8_t instance_id, uint8_t pldm_type,
+				  uint8_t command, uint64_t deadline_ms,
+				  void *context)
+{
+	if (tracker == NULL || instance_id >= PLDM_INSTANCE_MAX) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	uint16_t idx = tid * PLDM_INSTANCE_MAX + instance_id;
+	struct request_tracker_entry *entry = &tracker->entries[idx];
+	if (entry->in_use) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	entry->deadline_ms = deadline_ms;
+	entry->context = context;
+	entry->pldm_type = pldm_type;
+	entry->command = command;
+	entry->in_use = true;
+
+	/* Already due requests expire on the next tick */
+	uint64_t tick = deadline_ms / tracker->resolution_ms;
+	if (tick < tracker->tick) {
+		tick = tracker->tick;
+	}
+	entry->slot = tick % REQUEST_TRACKER_SLOTS;
+	uint16_t *slot = &tracker->slots[entry->slot];
+	entry->prev = REQUEST_TRACKER_NONE;
+	entry->next = *slot;
+	if (*slot != REQUEST_TRACKER_NONE) {
+		tracker->entries[*slot].prev = idx;
+	}
+	*slot = idx;
+
+	return PLDM_SUCCESS;
+}
+
+int pldm_request_tracker_match(const pldm_request_tracker *tracker,
+			       uint8_t tid, const struct pldm_msg_hdr *msg,
+			       void **context)
+{
+	if (tracker == NULL || msg == NULL) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	struct pldm_header_info hdr;
+	int rc = unpack_pldm_header(msg, &hdr);
+	if (rc != PLDM_SUCCESS) {
+		return rc;
+	}
+	if (hdr.msg_type != PLDM_RESPONSE) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	const struct request_tracker_entry *entry =
+	    &tracker->entries[tid * PLDM_INSTANCE_MAX + hdr.instance];
+	if (!entry->in_use || entry->pldm_type != hdr.pldm_type ||
+	    entry->command != hdr.command) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+	if (context != NULL) {
+		*context = entry->context;
+	}
+
+	return PLDM_SUCCESS;
+}
+
+int pldm_request_tracker_complete(pldm_request_tracker *tracker, uint8_t tid,
+				  uint8_t instance_id)
+{
+	if (tracker == NULL || instance_id >= PLDM_INSTANCE_MAX) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	uint16_t idx = tid * PLDM_INSTANCE_MAX + instance_id;
+	if (!tracker->entries[idx].in_use) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+	request_tracker_unlink(tracker, idx);
+
+	return PLDM_SUCCESS;
+}
+
+size_t pldm_request_tracker_expire(pldm_request_tracker *tracker,
+				   uint64_t now_ms,
+				   struct pldm_request_expiry *expired,
+				   size_t max_expired)
+{
+	assert(tracker != NULL);
+	assert(expired != NULL || max_expired == 0);
+
+	uint64_t now_tick = now_ms / tracker->resolution_ms;
+	if (now_tick < tracker->tick) {
+		return 0;
+	}
+
+	/* Past one turn of the wheel, each slot is visited once */
+	uint64_t last_tick = now_tick;
+	if (last_tick - tracker->tick >= REQUEST_TRACKER_SLOTS) {
+		last_tick = tracker->tick + REQUEST_TRACKER_SLOTS - 1;
+	}
+
+	size_t n = 0;
+	for (uint64_t tick = tracker->tick; tick <= last_tick; ++tick) {
+		uint16_t idx = tracker->slots[tick % REQUEST_TRACKER_SLOTS];
+		while (idx != REQUEST_TRACKER_NONE) {
+			struct request_tracker_entry *entry =
+			    &tracker->entries[idx];
+			uint16_t next = entry->next;
+			if (entry->deadline_ms <= now_ms) {
+				if (n == max_expired) {
+					/* Resume from this slot next time */
+					tracker->tick = tick;
+					return n;
+				}
+				expired[n].tid = idx / PLDM_INSTANCE_MAX;
+				expired[n].instance_id =
+				    idx % PLDM_INSTANCE_MAX;
+				expired[n].pldm_type = entry->pldm_type;
+				expired[n].command = entry->command;
+				expired[n].context = entry->context;
+				++n;
+				request_tracker_unlink(tracker, idx);
+			}
+			idx = next;
+		}
+	}
+	tracker->tick = now_tick;
+
+	return n;
+}
+
+struct responder_entry {
+	pldm_responder_handler handler;
+	void *ctx;
+};
+
+/* Handlers are indexed by PLDM type and command, and the bitmaps reported
+ * by GetPLDMTypes and GetPLDMCommands are kept in step with them
+ */
+typedef struct pldm_responder {
+	struct responder_entry handlers[PLDM_MAX_TYPES]
+				       [PLDM_MAX_CMDS_PER_TYPE];
+	bitfield8_t types[PLDM_MAX_TYPES / 8];
+	bitfield8_t commands[PLDM_MAX_TYPES][PLDM_MAX_CMDS_PER_TYPE / 8];
+} pldm_responder;
+
+static int responder_get_types(void *ctx, const struct pldm_header_info *hdr,
+			       const struct pldm_msg *request,
+			       size_t payload_length, struct pldm_msg *response,
+			       size_t *response_payload_length)
+{
+	(void)request;
+	(void)payload_length;
+
+	const pldm_responder *responder = ctx;
+	if (*response_payload_length < PLDM_GET_TYPES_RESP_BYTES) {
+		return PLDM_ERROR_INVALID_LENGTH;
+	}
+	*response_payload_length = PLDM_GET_TYPES_RESP_BYTES;
+
+	return encode_get_types_resp(hdr->instance, PLDM_SUCCESS,
+				     responder->types, response);
+}
+
+static int responder_get_commands(void *ctx,
+				  const struct pldm_header_info *hdr,
+				  const struct pldm_msg *request,
+				  size_t payload_length,
+				  struct pldm_msg *response,
+				  size_t *response_payload_length)
+{
+	const pldm_responder *responder = ctx;
+	if (*response_payload_length < PLDM_GET_COMMANDS_RESP_BYTES) {
+		return PLDM_ERROR_INVALID_LENGTH;
+	}
+
+	uint8_t type;
+	ver32_t version;
+	uint8_t cc =
+	    decode_get_commands_req(request, payload_length, &type, &version);
+	if (cc == PLDM_SUCCESS &&
+	    (type >= PLDM_MAX_TYPES ||
+	     !(responder->types[type / 8].byte & 1 << type % 8))) {
+		cc = PLDM_ERROR_INVALID_PLDM_TYPE;
+	}
+	if (cc != PLDM_SUCCESS) {
+		*response_payload_length = 1;
+		return encode_cc_only_resp(hdr->instance, hdr->pldm_type,
+					   hdr->command, cc, response);
+	}
+	*response_payload_length = PLDM_GET_COMMANDS_RESP_BYTES;
+
+	return encode_get_commands_resp(hdr->instance, PLDM_SUCCESS,
+					responder->commands[type], response);
+}
+
+pldm_responder *pldm_responder_init()
+{
+	pldm_responder *responder = calloc(1, sizeof(pldm_responder));
+	assert(responder != NULL);
+
+	pldm_responder_register(responder, PLDM_BASE, PLDM_GET_PLDM_TYPES,
+				responder_get_types, responder);
+	pldm_responder_register(responder, PLDM_BASE, PLDM_GET_PLDM_COMMANDS,
+				responder_get_commands, responder);
+
+	return responder;
+}
+
+void pldm_responder_destroy(pldm_responder *responder)
+{
+	assert(responder != NULL);
+
+	free(responder);
+}
+
+int pldm_responder_register(pldm_responder *responder, uint8_t pldm_type,
+			    uint8_t command, pldm_responder_handler handler,
+			    void *ctx)
+{
+	if (responder == NULL || pldm_type >= PLDM_MAX_TYPES) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	struct responder_entry *entry =
+	    &responder->handlers[pldm_type][command];
+	entry->handler = handler;
+	entry->ctx = ctx;
+
+	bitfield8_t *commands = responder->commands[pldm_type];
+	if (handler != NULL) {
+		commands[command / 8].byte |= 1 << command % 8;
+		responder->types[pldm_type / 8].byte |= 1 << pldm_type % 8;
+		return PLDM_SUCCESS;
+	}
+
+	commands[command / 8].byte &= ~(1 << command % 8);
+	for (size_t i = 0; i < PLDM_MAX_CMDS_PER_TYPE / 8; ++i) {
+		if (commands[i].byte) {
+			return PLDM_SUCCESS;
+		}
+	}
+	responder->types[pldm_type / 8].byte &= ~(1 << pldm_type % 8);
+
+	return PLDM_SUCCESS;
+}
+
+int pldm_responder_dispatch(const pldm_responder *responder,
+			    const struct pldm_msg *request,
+			    size_t payload_length, struct pldm_msg *response,
+			    size_t *response_payload_length)
+{
+	if (responder == NULL || request == NULL || response == NULL ||
+	    response_payload_length == NULL) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	struct pldm_header_info hdr;
+	int rc = unpack_pldm_header(&request->hdr, &hdr);
+	if (rc != PLDM_SUCCESS) {
+		return rc;
+	}
+	if (hdr.msg_type != PLDM_REQUEST) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	const struct responder_entry *entry =
+	    &responder->handlers[hdr.pldm_type][hdr.command];
+	if (entry->handler == NULL) {
+		if (*response_payload_length < 1) {
+			return PLDM_ERROR_INVALID_LENGTH;
+		}
+		/* A type is supported while it has a command */
+		bool type_supported = responder->types[hdr.pldm_type / 8].byte &
+				      1 << hdr.pldm_type % 8;
+		*response_payload_length = 1;
+		return encode_cc_only_resp(
+		    hdr.instance, hdr.pldm_type, hdr.command,
+		    type_supported ? PLDM_ERROR_UNSUPPORTED_PLDM_CMD
+				   : PLDM_ERROR_INVALID_PLDM_TYPE,
+		    response);
+	}
+
+	return entry->handler(entry->ctx, &hdr, request, payload_length,
+			      response, response_payload_length);
+}
+
+struct msg_pool_block {
+	struct msg_pool_block *next;
+	size_t size_class;
+	max_align_t data[];
+};
+
+static const size_t msg_pool_class_sizes[PLDM_MSG_POOL_NUM_CLASSES] = {
+    PLDM_MSG_POOL_SMALL_SIZE, PLDM_MSG_POOL_BASELINE_SIZE,
+    PLDM_MSG_POOL_MAX_SIZE};
+
+static _Thread_local struct {
+	struct msg_pool_block *free[PLDM_MSG_POOL_NUM_CLASSES];
+	size_t num_free[PLDM_MSG_POOL_NUM_CLASSES];
+	struct pldm_msg_pool_stats stats;
+} msg_pool;
+
+struct pldm_msg *pldm_msg_pool_acquire(size_t payload_length)
+{
+	if (payload_length >
+	    PLDM_MSG_POOL_MAX_SIZE - sizeof(struct pldm_msg_hdr)) {
+		return NULL;
+	}
+
+	size_t size = sizeof(struct pldm_msg_hdr) + payload_length;
+	size_t size_class = 0;
+	while (msg_pool_class_sizes[size_class] < size) {
+		++size_class;
+	}
+
+	struct msg_pool_block *block = msg_pool.free[size_class];
+	if (block != NULL) {
+		msg_pool.free[size_class] = block->next;
+		--msg_pool.num_free[size_class];
+		--msg_pool.stats.cached;
+	} else {
+		block = malloc(sizeof(*block) +
+			       msg_pool_class_sizes[size_class]);
+		if (block == NULL) {
+			return NULL;
+		}
+		block->size_class = size_class;
+		++msg_pool.stats.heap_allocations;
+	}
+	++msg_pool.stats.acquired;
+
+	return (struct pldm_msg *)block->data;
+}
+
+void pldm_msg_pool_release(struct pldm_msg *msg)
+{
+	if (msg == NULL) {
+		return;
+	}
+
+	struct msg_pool_block *block =
+	    (struct msg_pool_block *)((uint8_t *)msg -
+				      offsetof(struct msg_pool_block, data));
+	size_t size_class = block->size_class;
+	assert(size_class < PLDM_MSG_POOL_NUM_CLASSES);
+	++msg_pool.stats.released;
+
+	if (msg_pool.num_free[size_class] >= PLDM_MSG_POOL_MAX_CACHED) {
+		free(block);
+		++msg_pool.stats.heap_frees;
+		return;
+	}
+	block->next = msg_pool.free[size_class];
+	msg_pool.free[size_class] = block;
+	++msg_pool.num_free[size_class];
+	++msg_pool.stats.cached;
+}
+
+void pldm_msg_pool_drain()
+{
+	for (size_t i = 0; i < PLDM_MSG_POOL_NUM_CLASSES; ++i) {
+		while (msg_pool.free[i] != NULL) {
+			struct msg_pool_block *block = msg_pool.free[i];
+			msg_pool.free[i] = block->next;
+			free(block);
+			++msg_pool.stats.heap_frees;
+		}
+		msg_pool.num_free[i] = 0;
+	}
+	msg_pool.stats.cached = 0;
+}
+
+void pldm_msg_pool_get_stats(struct pldm_msg_pool_stats *stats)
+{
+	assert(stats != NULL);
+
+	*stats = msg_pool.stats;
+}
+
+enum discovery_state {
+	DISCOVERY_GET_TID,
+	DISCOVERY_GET_TYPES,
+	DISCOVERY_PER_TYPE,
+	DISCOVERY_DONE,
+	DISCOVERY_FAILED,
+};
+
+struct discovery_request {
+	uint8_t command;
+	uint8_t type;
+};
+
+struct discovery_endpoint {
+	enum discovery_state state;
+	bool need_request; /* GetTID or GetPLDMTypes not yet sent */
+	uint64_t need_version;
+	uint64_t need_commands;
+	uint32_t outstanding;
+	uint8_t next_instance_id;
+	uint8_t retries;
+	struct discovery_request requests[PLDM_INSTANCE_MAX];
+	struct pldm_version_reassembler versions[PLDM_MAX_TYPES];
+	ver32_t newest[PLDM_MAX_TYPES]; /* buffers of the reassemblers */
+	struct pldm_discovery_record record;
+};
+
+struct pldm_discovery {
+	size_t window;
+	size_t in_flight;
+	struct discovery_endpoint *endpoints[PLDM_TID_MAX + 1];
+	uint8_t active[PLDM_TID_MAX + 1];
+	size_t num_active;
+	size_t cursor;
+};
+
+pldm_discovery *pldm_discovery_init(size_t window)
+{
+	assert(window > 0);
+
+	pldm_discovery *discovery = calloc(1, sizeof(pldm_discovery));
+	assert(discovery != NULL);
+	discovery->window = window;
+
+	return discovery;
+}
+
+void pldm_discovery_destroy(pldm_discovery *discovery)
+{
+	assert(discovery != NULL);
+
+	for (size_t i = 0; i <= PLDM_TID_MAX; ++i) {
+		free(discovery->endpoints[i]);
+	}
+	free(discovery);
+}
+
+static void discovery_deactivate(pldm_discovery *discovery, uint8_t eid)
+{
+	for (size_t i = 0; i < discovery->num_active; ++i) {
+		if (discovery->active[i] == eid) {
+			discovery->active[i] =
+			    discovery->active[--discovery->num_active];
+			return;
+		}
+	}
+}
+
+static void discovery_fail(pldm_discovery *discovery, uint8_t eid)
+{
+	struct discovery_endpoint *ep = discovery->endpoints[eid];
+
+	discovery->in_flight -= __builtin_popcount(ep->outstanding);
+	ep->outstanding = 0;
+	ep->state = DISCOVERY_FAILED;
+	discovery_deactivate(discovery, eid);
+}
+
+static void discovery_check_done(pldm_discovery *discovery, uint8_t eid)
+{
+	struct discovery_endpoint *ep = discovery->endpoints[eid];
+
+	if (ep->state == DISCOVERY_PER_TYPE && ep->need_version == 0 &&
+	    ep->need_commands == 0 && ep->outstanding == 0) {
+		ep->state = DISCOVERY_DONE;
+		discovery_deactivate(discovery, eid);
+	}
+}
+
+/* Start the GetPLDMVersion transfer of a type */
+static void discovery_version_reset(struct discovery_endpoint *ep,
+				    uint8_t type)
+{
+	pldm_version_reassembler_init(&ep->versions[type], &ep->newest[type],
+				      1);
+}
+
+int pldm_discovery_add(pldm_discovery *discovery, uint8_t eid)
+{
+	assert(discovery != NULL);
+
+	struct discovery_endpoint *ep = discovery->endpoints[eid];
+	if (ep == NULL) {
+		ep = malloc(sizeof(*ep));
+		assert(ep != NULL);
+		discovery->endpoints[eid] = ep;
+	} else if (ep->outstanding != 0) {
+		return PLDM_ERROR_NOT_READY;
+	} else if (ep->state != DISCOVERY_DONE &&
+		   ep->state != DISCOVERY_FAILED) {
+		discovery_deactivate(discovery, eid);
+	}
+
+	memset(ep, 0, sizeof(*ep));
+	ep->state = DISCOVERY_GET_TID;
+	ep->need_request = true;
+	ep->record.eid = eid;
+	discovery->active[discovery->num_active++] = eid;
+
+	return PLDM_SUCCESS;
+}
+
+/* Encode the next request of an endpoint, if it has one to make */
+static bool discovery_endpoint_request(struct discovery_endpoint *ep,
+				       uint8_t instance_id,
+				       struct pldm_msg *msg,
+				       size_t *payload_length)
+{
+	struct discovery_request *request = &ep->requests[instance_id];
+
+	if (ep->state == DISCOVERY_GET_TID ||
+	    ep->state == DISCOVERY_GET_TYPES) {
+		if (!ep->need_request) {
+			return false;
+		}
+		ep->need_request = false;
+		request->type = PLDM_BASE;
+		if (ep->state == DISCOVERY_GET_TID) {
+			request->command = PLDM_GET_TID;
+			*payload_length = 0;
+			encode_get_tid_req(instance_id, msg);
+		} else {
+			request->command = PLDM_GET_PLDM_TYPES;
+			*payload_length = 0;
+			encode_get_types_req(instance_id, msg);
+		}
+		return true;
+	}
+
+	if (ep->need_version != 0) {
+		uint8_t type = __builtin_ctzll(ep->need_version);
+		ep->need_version &= ~(1ull << type);
+		request->type = type;
+		request->command = PLDM_GET_PLDM_VERSION;
+		*payload_length = PLDM_GET_VERSION_REQ_BYTES;
+		pldm_version_reassembler_encode_req(&ep->versions[type],
+						    instance_id, type, msg);
+		return true;
+	}
+
+	if (ep->need_commands != 0) {
+		uint8_t type = __builtin_ctzll(ep->need_commands);
+		ep->need_commands &= ~(1ull << type);
+		request->type = type;
+		request->command = PLDM_GET_PLDM_COMMANDS;
+		*payload_length = PLDM_GET_COMMANDS_REQ_BYTES;
+		encode_get_commands_req(instance_id, type,
+					ep->record.versions[type], msg);
+		return true;
+	}
+
+	return false;
+}
+
+int pldm_discovery_next_request(pldm_discovery *discovery, uint8_t *eid,
+				struct pldm_msg *msg, size_t *payload_length)
+{
+	assert(discovery != NULL && eid != NULL && msg != NULL &&
+	       payload_length != NULL);
+
+	if (*payload_length < PLDM_DISCOVERY_REQ_BYTES) {
+		return PLDM_ERROR_INVALID_LENGTH;
+	}
+	if (discovery->in_flight >= discovery->window) {
+		return PLDM_ERROR_NOT_READY;
+	}
+
+	for (size_t i = 0; i < discovery->num_active; ++i) {
+		size_t pos = (discovery->cursor + i) % discovery->num_active;
+		struct discovery_endpoint *ep =
+		    discovery->endpoints[discovery->active[pos]];
+		if (ep->outstanding == UINT32_MAX) {
+			continue;
+		}
+
+		uint8_t instance_id = ep->next_instance_id;
+		while (ep->outstanding & (1u << instance_id)) {
+			instance_id = (instance_id + 1) % PLDM_INSTANCE_MAX;
+		}
+		if (!discovery_endpoint_request(ep, instance_id, msg,
+						payload_length)) {
+			continue;
+		}
+
+		ep->outstanding |= 1u << instance_id;
+		ep->next_instance_id = (instance_id + 1) % PLDM_INSTANCE_MAX;
+		++discovery->in_flight;
+		*eid = discovery->active[pos];
+		discovery->cursor = pos + 1;
+		return PLDM_SUCCESS;
+	}
+
+	return PLDM_ERROR_NOT_READY;
+}
+
+/* Put a request back in the queue of its endpoint */
+static void discovery_retry(pldm_discovery *discovery, uint8_t eid,
+			    uint8_t instance_id)
+{
+	struct discovery_endpoint *ep = discovery->endpoints[eid];
+	const struct discovery_request *request = &ep->requests[instance_id];
+
+	if (ep->retries++ >= PLDM_DISCOVERY_MAX_RETRIES) {
+		discovery_fail(discovery, eid);
+		return;
+	}
+
+	switch (request->command) {
+	case PLDM_GET_TID:
+	case PLDM_GET_PLDM_TYPES:
+		ep->need_request = true;
+		break;
+	case PLDM_GET_PLDM_VERSION:
+		discovery_version_reset(ep, request->type);
+		ep->need_version |= 1ull << request->type;
+		break;
+	default:
+		ep->need_commands |= 1ull << request->type;
+		break;
+	}
+}
+
+int pldm_discovery_handle_response(pldm_discovery *discovery, uint8_t eid,
+				   const struct pldm_msg *msg,
+				   size_t payload_length)
+{
+	assert(discovery != NULL && msg != NULL);
+
+	struct discovery_endpoint *ep = discovery->endpoints[eid];
+	uint8_t instance_id = msg->hdr.instance_id;
+	if (ep == NULL || !(ep->outstanding & (1u << instance_id)) ||
+	    msg->hdr.request != 0 || msg->hdr.type != PLDM_BASE ||
+	    msg->hdr.command != ep->requests[instance_id].command) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	ep->outstanding &= ~(1u << instance_id);
+	--discovery->in_flight;
+	if (payload_length < 1) {
+		discovery_retry(discovery, eid, instance_id);
+		return PLDM_SUCCESS;
+	}
+
+	const struct discovery_request *request = &ep->requests[instance_id];
+	uint8_t completion_code = PLDM_SUCCESS;
+	int rc = PLDM_SUCCESS;
+	switch (request->command) {
+	case PLDM_GET_TID:
+		rc = decode_get_tid_resp(msg, payload_length, &completion_code,
+					 &ep->record.tid);
+		if (rc == PLDM_SUCCESS && completion_code == PLDM_SUCCESS) {
+			ep->state = DISCOVERY_GET_TYPES;
+			ep->need_request = true;
+		}
+		break;
+	case PLDM_GET_PLDM_TYPES:
+		rc = decode_get_types_resp(msg, payload_length,
+					   &completion_code, ep->record.types);
+		if (rc == PLDM_SUCCESS && completion_code == PLDM_SUCCESS) {
+			ep->state = DISCOVERY_PER_TYPE;
+			for (uint8_t type = 0; type < PLDM_MAX_TYPES; ++type) {
+				if (ep->record.types[type / 8].byte &
+				    (1 << (type % 8))) {
+					discovery_version_reset(ep, type);
+					ep->need_version |= 1ull << type;
+				}
+			}
+		}
+		break;
+	case PLDM_GET_PLDM_VERSION: {
+		bool complete = false;
+		rc = pldm_version_reassembler_add(&ep->versions[request->type],
+						  msg, payload_length,
+						  &completion_code, &complete);
+		if (rc == PLDM_SUCCESS && completion_code == PLDM_SUCCESS) {
+			if (complete) {
+				ep->record.versions[request->type] =
+				    ep->versions[request->type].first;
+				ep->need_commands |= 1ull << request->type;
+			} else {
+				ep->need_version |= 1ull << request->type;
+			}
+		}
+		break;
+	}
+	default:
+		rc = decode_get_commands_resp(
+		    msg, payload_length, &completion_code,
+		    ep->record.commands[request->type]);
+		break;
+	}
+
+	if (rc != PLDM_SUCCESS) {
+		discovery_retry(discovery, eid, instance_id);
+	} else if (completion_code != PLDM_SUCCESS) {
+		if (ep->state == DISCOVERY_PER_TYPE) {
+			ep->record.types[request->type / 8].byte &=
+			    ~(1 << (request->type % 8));
+		} else {
+			discovery_fail(discovery, eid);
+		}
+	}
+	discovery_check_done(discovery, eid);
+
+	return PLDM_SUCCESS;
+}
+
+int pldm_discovery_cancel(pldm_discovery *discovery, uint8_t eid,
+			  uint8_t instance_id)
+{
+	assert(discovery != NULL);
+
+	struct discovery_endpoint *ep = discovery->endpoints[eid];
+	if (ep == NULL || instance_id >= PLDM_INSTANCE_MAX ||
+	    !(ep->outstanding & (1u << instance_id))) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	ep->outstanding &= ~(1u << instance_id);
+	--discovery->in_flight;
+	discovery_retry(discovery, eid, instance_id);
+
+	return PLDM_SUCCESS;
+}
+
+size_t pldm_discovery_in_progress(const pldm_discovery *discovery)
+{
+	assert(discovery != NULL);
+
+	return discovery->num_active;
+}
+
+int pldm_discovery_get_record(const pldm_discovery *discovery, uint8_t eid,
+			      const struct pldm_discovery_record **record)
+{
+	assert(discovery != NULL && record != NULL);
+
+	const struct discovery_endpoint *ep = discovery->endpoints[eid];
+	if (ep == NULL) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+	if (ep->state == DISCOVERY_FAILED) {
+		return PLDM_ERROR;
+	}
+	if (ep->state != DISCOVERY_DONE) {
+		return PLDM_ERROR_NOT_READY;
+	}
+
+	*record = &ep->record;
+	return PLDM_SUCCESS;
+}
+
+extern inline bool
+pldm_capabilities_type_supported(const struct pldm_capabilities *caps,
+				 uint8_t type);
+extern inline bool
+pldm_capabilities_command_supported(const struct pldm_capabilities *caps,
+				    uint8_t type, uint8_t command);
+
+static uint64_t capabilities_load_le64(const uint8_t *bytes)
+{
+	uint64_t word = 0;
+	memcpy(&word, bytes, sizeof(word));
+	return le64toh(word);
+}
+
+static void capabilities_store_le64(uint8_t *bytes, uint64_t word)
+{
+	word = htole64(word);
+	memcpy(bytes, &word, sizeof(word));
+}
+
+void pldm_capabilities_set_types(struct pldm_capabilities *caps,
+				 const bitfield8_t *types)
+{
+	assert(caps != NULL && types != NULL);
+
+	caps->types = capabilities_load_le64(&types->byte);
+	for (uint8_t type = 0; type < PLDM_MAX_TYPES; ++type) {
+		if (!((caps->types >> type) & 1)) {
+			memset(caps->commands[type], 0,
+			       sizeof(caps->commands[type]));
+			memset(&caps->versions[type], 0,
+			       sizeof(caps->versions[type]));
+		}
+	}
+}
+
+int pldm_capabilities_set_commands(struct pldm_capabilities *caps,
+				   uint8_t type, ver32_t version,
+				   const bitfield8_t *commands)
+{
+	assert(caps != NULL && commands != NULL);
+
+	if (!pldm_capabilities_type_supported(caps, type)) {
+		return PLDM_ERROR_INVALID_PLDM_TYPE;
+	}
+
+	caps->versions[type] = version;
+	for (size_t i = 0; i < PLDM_MAX_CMDS_PER_TYPE / 64; ++i) {
+		caps->commands[type][i] =
+		    capabilities_load_le64(&commands[i * 8].byte);
+	}
+
+	return PLDM_SUCCESS;
+}
+
+void pldm_capabilities_from_discovery(
+    struct pldm_capabilities *caps, const struct pldm_discovery_record *record)
+{
+	assert(caps != NULL && record != NULL);
+
+	memset(caps, 0, sizeof(*caps));
+	pldm_capabilities_set_types(caps, record->types);
+	for (uint8_t type = 0; type < PLDM_MAX_TYPES; ++type) {
+		if ((caps->types >> type) & 1) {
+			pldm_capabilities_set_commands(
+			    caps, type, record->versions[type],
+			    record->commands[type]);
+		}
+	}
+}
+
+#define CAPABILITY_NONE SIZE_MAX
+#define CAPABILITY_MAGIC 0x50434150 /* "PCAP" */
+#define CAPABILITY_HDR_SIZE 8	     /* magic and number of entries */
+#define CAPABILITY_ENTRY_SIZE (PLDM_CAPABILITY_UID_SIZE + sizeof(uint64_t))
+#define CAPABILITY_TYPE_SIZE                                                   \
+	(sizeof(ver32_t) + PLDM_MAX_CMDS_PER_TYPE / 8)
+#define CAPABILITY_CRC_SIZE 4
+
+struct capability_entry {
+	uint8_t uid[PLDM_CAPABILITY_UID_SIZE];
+	bool bound;
+	uint8_t tid;
+	struct pldm_capabilities caps;
+};
+
+struct pldm_capability_cache {
+	struct capability_entry *entries;
+	size_t num_entries;
+	size_t capacity;
+	size_t by_tid[PLDM_TID_MAX + 1];
+};
+
+pldm_capability_cache *pldm_capability_cache_init()
+{
+	pldm_capability_cache *cache = calloc(1, sizeof(pldm_capability_cache));
+	assert(cache != NULL);
+	for (size_t i = 0; i <= PLDM_TID_MAX; ++i) {
+		cache->by_tid[i] = CAPABILITY_NONE;
+	}
+
+	return cache;
+}
+
+void pldm_capability_cache_destroy(pldm_capability_cache *cache)
+{
+	assert(cache != NULL);
+
+	free(cache->entries);
+	free(cache);
+}
+
+static size_t capability_cache_find_uid(const pldm_capability_cache *cache,
+					const uint8_t *uid)
+{
+	for (size_t i = 0; i < cache->num_entries; ++i) {
+		if (!memcmp(cache->entries[i].uid, uid,
+			    PLDM_CAPABILITY_UID_SIZE)) {
+			return i;
+		}
+	}
+
+	return CAPABILITY_NONE;
+}
+
+static void capability_cache_unbind(pldm_capability_cache *cache, uint8_t tid)
+{
+	size_t idx = cache->by_tid[tid];
+	if (idx != CAPABILITY_NONE) {
+		cache->entries[idx].bound = false;
+		cache->by_tid[tid] = CAPABILITY_NONE;
+	}
+}
+
+static void capability_cache_bind_entry(pldm_capability_cache *cache,
+					size_t idx, uint8_t tid)
+{
+	struct capability_entry *entry = &cache->entries[idx];
+
+	if (entry->bound) {
+		cache->by_tid[entry->tid] = CAPABILITY_NONE;
+	}
+	capability_cache_unbind(cache, tid);
+	entry->bound = true;
+	entry->tid = tid;
+	cache->by_tid[tid] = idx;
+}
+
+static size_t capability_cache_add(pldm_capability_cache *cache,
+				   const uint8_t *uid)
+{
+	if (cache->num_entries == cache->capacity) {
+		cache->capacity = cache->capacity ? cache->capacity * 2 : 4;
+		cache->entries =
+		    realloc(cache->entries,
+			    cache->capacity * sizeof(*cache->entries));
+		assert(cache->entries != NULL);
+	}
+
+	struct capability_entry *entry = &cache->entries[cache->num_entries];
+	memcpy(entry->uid, uid, PLDM_CAPABILITY_UID_SIZE);
+	entry->bound = false;
+
+	return cache->num_entries++;
+}
+
+void pldm_capability_cache_set(pldm_capability_cache *cache, uint8_t tid,
+			       const uint8_t *uid,
+			       const struct pldm_capabilities *caps)
+{
+	assert(cache != NULL && uid != NULL && caps != NULL);
+
+	size_t idx = capability_cache_find_uid(cache, uid);
+	if (idx == CAPABILITY_NONE) {
+		idx = capability_cache_add(cache, uid);
+	}
+	cache->entries[idx].caps = *caps;
+	capability_cache_bind_entry(cache, idx, tid);
+}
+
+const struct pldm_capabilities *
+pldm_capability_cache_get(const pldm_capability_cache *cache, uint8_t tid)
+{
+	assert(cache != NULL);
+
+	size_t idx = cache->by_tid[tid];
+	return idx == CAPABILITY_NONE ? NULL : &cache->entries[idx].caps;
+}
+
+int pldm_capability_cache_bind(pldm_capability_cache *cache,
+			       const uint8_t *uid, uint8_t tid)
+{
+	assert(cache != NULL && uid != NULL);
+
+	size_t idx = capability_cache_find_uid(cache, uid);
+	if (idx == CAPABILITY_NONE) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+	capability_cache_bind_entry(cache, idx, tid);
+
+	return PLDM_SUCCESS;
+}
+
+void pldm_capability_cache_remove(pldm_capability_cache *cache, uint8_t tid)
+{
+	assert(cache != NULL);
+
+	size_t idx = cache->by_tid[tid];
+	if (idx == CAPABILITY_NONE) {
+		return;
+	}
+
+	cache->by_tid[tid] = CAPABILITY_NONE;
+	size_t last = --cache->num_entries;
+	if (idx != last) {
+		cache->entries[idx] = cache->entries[last];
+		if (cache->entries[idx].bound) {
+			cache->by_tid[cache->entries[idx].tid] = idx;
+		}
+	}
+}
+
+size_t pldm_capability_cache_saved_size(const pldm_capability_cache *cache)
+{
+	assert(cache != NULL);
+
+	size_t size = CAPABILITY_HDR_SIZE + CAPABILITY_CRC_SIZE;
+	for (size_t i = 0; i < cache->num_entries; ++i) {
+		size += CAPABILITY_ENTRY_SIZE +
+			CAPABILITY_TYPE_SIZE *
+			    __builtin_popcountll(cache->entries[i].caps.types);
+	}
+
+	return size;
+}
+
+int pldm_capability_cache_save(const pldm_capability_cache *cache,
+			       uint8_t *data, size_t size)
+{
+	assert(cache != NULL && data != NULL);
+
+	size_t saved_size = pldm_capability_cache_saved_size(cache);
+	if (size < saved_size) {
+		return PLDM_ERROR_INVALID_LENGTH;
+	}
+
+	uint32_t word = htole32(CAPABILITY_MAGIC);
+	memcpy(data, &word, sizeof(word));
+	word = htole32(cache->num_entries);
+	memcpy(data + 4, &word, sizeof(word));
+	uint8_t *pos = data + CAPABILITY_HDR_SIZE;
+
+	for (size_t i = 0; i < cache->num_entries; ++i) {
+		const struct capability_entry *entry = &cache->entries[i];
+		memcpy(pos, entry->uid, PLDM_CAPABILITY_UID_SIZE);
+		pos += PLDM_CAPABILITY_UID_SIZE;
+		capabilities_store_le64(pos, entry->caps.types);
+		pos += sizeof(uint64_t);
+
+		for (uint64_t types = entry->caps.types; types != 0;
+		     types &= types - 1) {
+			uint8_t type = __builtin_ctzll(types);
+			memcpy(pos, &entry->caps.versions[type],
+			       sizeof(ver32_t));
+			pos += sizeof(ver32_t);
+			for (size_t j = 0; j < PLDM_MAX_CMDS_PER_TYPE / 64;
+			     ++j) {
+				capabilities_store_le64(
+				    pos, entry->caps.commands[type][j]);
+				pos += sizeof(uint64_t);
+			}
+		}
+	}
+
+	word = htole32(crc32(data, pos - data));
+	memcpy(pos, &word, sizeof(word));
+
+	return PLDM_SUCCESS;
+}
+
+/* Read one saved entry, returning its size or 0 if it runs past the end */
+static size_t capability_cache_parse_entry(const uint8_t *data, size_t size,
+					   struct capability_entry *entry)
+{
+	if (size < CAPABILITY_ENTRY_SIZE) {
+		return 0;
+	}
+	uint64_t types =
+	    capabilities_load_le64(data + PLDM_CAPABILITY_UID_SIZE);
+	size_t entry_size = CAPABILITY_ENTRY_SIZE +
+			    CAPABILITY_TYPE_SIZE * __builtin_popcountll(types);
+	if (size < entry_size) {
+		return 0;
+	}
+	if (entry == NULL) {
+		return entry_size;
+	}
+
+	memset(entry, 0, sizeof(*entry));
+	memcpy(entry->uid, data, PLDM_CAPABILITY_UID_SIZE);
+	entry->caps.types = types;
+	const uint8_t *pos = data + CAPABILITY_ENTRY_SIZE;
+	for (; types != 0; types &= types - 1) {
+		uint8_t type = __builtin_ctzll(types);
+		memcpy(&entry->caps.versions[type], pos, sizeof(ver32_t));
+		pos += sizeof(ver32_t);
+		for (size_t j = 0; j < PLDM_MAX_CMDS_PER_TYPE / 64; ++j) {
+			entry->caps.commands[type][j] =
+			    capabilities_load_le64(pos);
+			pos += sizeof(uint64_t);
+		}
+	}
+
+	return entry_size;
+}
+
+int pldm_capability_cache_load(pldm_capability_cache *cache,
+			       const uint8_t *data, size_t size)
+{
+	assert(cache != NULL && data != NULL);
+
+	if (size < CAPABILITY_HDR_SIZE + CAPABILITY_CRC_SIZE) {
+		return PLDM_ERROR_INVALID_LENGTH;
+	}
+
+	uint32_t magic = 0;
+	uint32_t num_entries = 0;
+	uint32_t crc = 0;
+	memcpy(&magic, data, sizeof(magic));
+	memcpy(&num_entries, data + 4, sizeof(num_entries));
+	memcpy(&crc, data + size - CAPABILITY_CRC_SIZE, sizeof(crc));
+	size -= CAPABILITY_CRC_SIZE;
+	if (le32toh(magic) != CAPABILITY_MAGIC ||
+	    le32toh(crc) != crc32(data, size)) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+	num_entries = le32toh(num_entries);
+
+	/* Check every entry fits before loading any */
+	size_t offset = CAPABILITY_HDR_SIZE;
+	for (uint32_t i = 0; i < num_entries; ++i) {
+		size_t entry_size = capability_cache_parse_entry(
+		    data + offset, size - offset, NULL);
+		if (entry_size == 0) {
+			return PLDM_ERROR_INVALID_DATA;
+		}
+		offset += entry_size;
+	}
+	if (offset != size) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	offset = CAPABILITY_HDR_SIZE;
+	for (uint32_t i = 0; i < num_entries; ++i) {
+		struct capability_entry entry;
+		offset += capability_cache_parse_entry(
+		    data + offset, size - offset, &entry);
+
+		size_t idx = capability_cache_find_uid(cache, entry.uid);
+		if (idx == CAPABILITY_NONE) {
+			idx = capability_cache_add(cache, entry.uid);
+		} else if (cache->entries[idx].bound) {
+			continue;
+		}
+		cache->entries[idx] = entry;
+	}
+
+	return PLDM_SUCCESS;
+}
+
+#define VERSION_CRC_SIZE 4
+
+/* Sort key of a version field: absent first, then by number */
+static uint8_t ver32_field_key(uint8_t field)
+{
+	if (field == 0xff) {
+		return 0;
+	}
+	if ((field & 0xf0) == 0xf0) {
+		return 1 + (field & 0x0f);
+	}
+	return 1 + bcd2dec8(field);
+}
+
+static uint32_t ver32_key(const ver32_t *version)
+{
+	return (uint32_t)ver32_field_key(version->major) << 24 |
+	       (uint32_t)ver32_field_key(version->minor) << 16 |
+	       (uint32_t)ver32_field_key(version->update) << 8 |
+	       version->alpha;
+}
+
+int pldm_ver32_compare(const ver32_t *a, const ver32_t *b)
+{
+	assert(a != NULL && b != NULL);
+
+	uint32_t key_a = ver32_key(a);
+	uint32_t key_b = ver32_key(b);
+	return (key_a > key_b) - (key_a < key_b);
+}
+
+int encode_get_version_resp_multipart(uint8_t instance_id,
+				      const ver32_t *versions,
+				      size_t num_versions,
+				      uint32_t transfer_handle,
+				      uint8_t transfer_opflag,
+				      size_t max_payload_length,
+				      struct pldm_msg *msg,
+				      size_t *payload_length)
+{
+	if (versions == NULL || num_versions == 0 || msg == NULL ||
+	    payload_length == NULL) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+	if (max_payload_length <= PLDM_GET_VERSION_RESP_FIXED_BYTES) {
+		return PLDM_ERROR_INVALID_LENGTH;
+	}
+
+	size_t versions_size = num_versions * sizeof(ver32_t);
+	size_t total = versions_size + VERSION_CRC_SIZE;
+	size_t offset = transfer_handle;
+	uint8_t completion_code = PLDM_SUCCESS;
+	if (!check_transfer_operation_flag_valid(transfer_opflag)) {
+		completion_code = PLDM_INVALID_TRANSFER_OPERATION_FLAG;
+	} else if (transfer_opflag == PLDM_GET_FIRSTPART) {
+		offset = 0;
+	} else if (offset == 0 || offset >= total) {
+		completion_code = PLDM_ERROR_INVALID_DATA;
+	}
+	if (completion_code != PLDM_SUCCESS) {
+		*payload_length = 1;
+		return encode_cc_only_resp(instance_id, PLDM_BASE,
+					   PLDM_GET_PLDM_VERSION,
+					   completion_code, msg);
+	}
+
+	size_t size = max_payload_length - PLDM_GET_VERSION_RESP_FIXED_BYTES;
+	if (size > total - offset) {
+		size = total - offset;
+	}
+	bool last = offset + size == total;
+	uint8_t transfer_flag = offset == 0 ? (last ? PLDM_START_AND_END
+						    : PLDM_START)
+					    : (last ? PLDM_END : PLDM_MIDDLE);
+
+	uint8_t crc[VERSION_CRC_SIZE];
+	uint32_t crc32_le = htole32(crc32(versions, versions_size));
+	memcpy(crc, &crc32_le, sizeof(crc));
+
+	/* The part holds versions, the CRC32, or the end of one and the start
+	 * of the other */
+	struct variable_field data = {NULL, 0};
+	size_t from_versions = 0;
+	if (offset < versions_size) {
+		from_versions = versions_size - offset;
+		from_versions = from_versions < size ? from_versions : size;
+		data.ptr = (const uint8_t *)versions + offset;
+		data.length = from_versions;
+	} else {
+		data.ptr = crc + (offset - versions_size);
+		data.length = size;
+	}
+
+	int rc = encode_get_version_resp(instance_id, PLDM_SUCCESS,
+					 last ? 0 : offset + size,
+					 transfer_flag, &data, msg);
+	if (rc != PLDM_SUCCESS) {
+		return rc;
+	}
+	if (from_versions != 0 && from_versions < size) {
+		struct pldm_get_version_resp *response =
+		    (struct pldm_get_version_resp *)msg->payload;
+		memcpy(response->version_data + from_versions, crc,
+		       size - from_versions);
+	}
+	*payload_length = PLDM_GET_VERSION_RESP_FIXED_BYTES + size;
+
+	return PLDM_SUCCESS;
+}
+
+void pldm_version_reassembler_init(struct pldm_version_reassembler *reassembler,
+				   ver32_t *versions, size_t max_versions)
+{
+	assert(reassembler != NULL && versions != NULL && max_versions > 0);
+
+	memset(reassembler, 0, sizeof(*reassembler));
+	reassembler->versions = versions;
+	reassembler->max_versions = max_versions;
+	reassembler->transfer_opflag = PLDM_GET_FIRSTPART;
+}
+
+int pldm_version_reassembler_encode_req(
+    const struct pldm_version_reassembler *reassembler, uint8_t instance_id,
+    uint8_t type, struct pldm_msg *msg)
+{
+	assert(reassembler != NULL);
+
+	return encode_get_version_req(instance_id,
+				      reassembler->transfer_handle,
+				      reassembler->transfer_opflag, type, msg);
+}
+
+/* Keep a version, in order, dropping the oldest once the buffer is full */
+static void version_reassembler_insert(struct pldm_version_reassembler *r,
+				       const ver32_t *version)
+{
+	size_t pos = r->num_versions;
+	if (pos == r->max_versions) {
+		if (pldm_ver32_compare(version, &r->versions[0]) <= 0) {
+			return;
+		}
+		memmove(&r->versions[0], &r->versions[1],
+			(pos - 1) * sizeof(ver32_t));
+		--pos;
+	} else {
+		++r->num_versions;
+	}
+
+	while (pos > 0 &&
+	       pldm_ver32_compare(&r->versions[pos - 1], version) > 0) {
+		r->versions[pos] = r->versions[pos - 1];
+		--pos;
+	}
+	r->versions[pos] = *version;
+}
+
+/* Take version data that cannot be the CRC32 */
+static void version_reassembler_consume(struct pldm_version_reassembler *r,
+					const uint8_t *data, size_t length)
+{
+	r->crc = crc32_update(r->crc, data, length);
+
+	size_t done = r->length - r->tail_length;
+	while (length > 0) {
+		size_t pos = done % sizeof(ver32_t);
+		size_t n = sizeof(ver32_t) - pos;
+		n = n < length ? n : length;
+		memcpy((uint8_t *)&r->partial + pos, data, n);
+		if (pos + n == sizeof(ver32_t)) {
+			if (done < sizeof(ver32_t)) {
+				r->first = r->partial;
+			}
+			version_reassembler_insert(r, &r->partial);
+		}
+		data += n;
+		length -= n;
+		done += n;
+	}
+}
+
+/* Add a part of the version data, holding back the last VERSION_CRC_SIZE
+ * bytes which may be the CRC32 itself */
+static void version_reassembler_append(struct pldm_version_reassembler *r,
+				       const uint8_t *data, size_t length)
+{
+	size_t total = r->tail_length + length;
+	if (total <= VERSION_CRC_SIZE) {
+		memcpy(r->tail + r->tail_length, data, length);
+		r->tail_length = total;
+		r->length += length;
+		return;
+	}
+
+	size_t emit = total - VERSION_CRC_SIZE;
+	size_t from_tail = emit < r->tail_length ? emit : r->tail_length;
+	version_reassembler_consume(r, r->tail, from_tail);
+	r->tail_length -= from_tail;
+	memmove(r->tail, r->tail + from_tail, r->tail_length);
+
+	version_reassembler_consume(r, data, emit - from_tail);
+	r->length += length;
+	memcpy(r->tail + r->tail_length, data + emit - from_tail,
+	       length - (emit - from_tail));
+	r->tail_length = VERSION_CRC_SIZE;
+}
+
+int pldm_version_reassembler_add(struct pldm_version_reassembler *reassembler,
+				 const struct pldm_msg *msg,
+				 size_t payload_length,
+				 uint8_t *completion_code, bool *complete)
+{
+	assert(reassembler != NULL && complete != NULL);
+
+	*complete = false;
+	if (payload_length < 1) {
+		return PLDM_ERROR_INVALID_LENGTH;
+	}
+
+	uint32_t next_transfer_handle = 0;
+	uint8_t transfer_flag = 0;
+	struct variable_field data = {NULL, 0};
+	int rc = decode_get_version_resp(msg, payload_length, completion_code,
+					 &next_transfer_handle, &transfer_flag,
+					 &data);
+	if (rc != PLDM_SUCCESS || *completion_code != PLDM_SUCCESS) {
+		return rc;
+	}
+
+	bool first = transfer_flag == PLDM_START ||
+		     transfer_flag == PLDM_START_AND_END;
+	if (first != (reassembler->transfer_opflag == PLDM_GET_FIRSTPART)) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+	version_reassembler_append(reassembler, data.ptr, data.length);
+
+	if (transfer_flag == PLDM_START || transfer_flag == PLDM_MIDDLE) {
+		reassembler->transfer_handle = next_transfer_handle;
+		reassembler->transfer_opflag = PLDM_GET_NEXTPART;
+		return PLDM_SUCCESS;
+	}
+
+	uint32_t crc = 0;
+	memcpy(&crc, reassembler->tail, sizeof(crc));
+	if (reassembler->length < sizeof(ver32_t) + VERSION_CRC_SIZE ||
+	    reassembler->length % sizeof(ver32_t) != 0 ||
+	    reassembler->crc != le32toh(crc)) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+	*complete = true;
+
+	return PLDM_SUCCESS;
+}
+
+int pldm_version_highest_common(const ver32_t *a, size_t num_a,
+				const ver32_t *b, size_t num_b,
+				ver32_t *common)
+{
+	assert((a != NULL || num_a == 0) && (b != NULL || num_b == 0) &&
+	       common != NULL);
+
+	while (num_a > 0 && num_b > 0) {
+		int cmp = pldm_ver32_compare(&a[num_a - 1], &b[num_b - 1]);
+		if (cmp == 0) {
+			*common = a[num_a - 1];
+			return PLDM_SUCCESS;
+		}
+		if (cmp > 0) {
+			--num_a;
+		} else {
+			--num_b;
+		}
+	}
+
+	return PLDM_ERROR;
+}
+
+struct pldm_response_template {
+	size_t size;
+	uint8_t msg[];
+};
+
+pldm_response_template *
+pldm_response_template_init(const struct pldm_msg *msg, size_t payload_length)
+{
+	assert(msg != NULL);
+
+	if (msg->hdr.request != 0 || msg->hdr.datagram != 0) {
+		return NULL;
+	}
+
+	size_t size = sizeof(struct pldm_msg_hdr) + payload_length;
+	pldm_response_template *tmpl =
+	    malloc(sizeof(pldm_response_template) + size);
+	assert(tmpl != NULL);
+	tmpl->size = size;
+	memcpy(tmpl->msg, msg, size);
+
+	return tmpl;
+}
+
+void pldm_response_template_destroy(pldm_response_template *tmpl)
+{
+	assert(tmpl != NULL);
+
+	free(tmpl);
+}
+
+static uint8_t response_template_hdr_byte(const pldm_response_template *tmpl,
+					  uint8_t instance_id)
+{
+	return (tmpl->msg[0] & ~PLDM_INSTANCE_ID_MASK) | instance_id;
+}
+
+/* Copy with fixed-size blocks, the last one overlapping, which the compiler
+ * turns into a few loads and stores instead of a call to memcpy(). The
+ * instance ID goes into the first block before it is stored. */
+static void response_template_copy(uint8_t *dst, const uint8_t *src,
+				   size_t size, uint8_t hdr_byte)
+{
+	if (size >= 16) {
+		uint8_t block[16];
+		memcpy(block, src, 16);
+		block[0] = hdr_byte;
+		memcpy(dst, block, 16);
+		for (size_t i = 16; i + 16 < size; i += 16) {
+			memcpy(dst + i, src + i, 16);
+		}
+		if (size > 16) {
+			memcpy(dst + size - 16, src + size - 16, 16);
+		}
+	} else {
+		dst[0] = hdr_byte;
+		for (size_t i = 1; i < size; ++i) {
+			dst[i] = src[i];
+		}
+	}
+}
+
+int pldm_response_template_encode(const pldm_response_template *tmpl,
+				  uint8_t instance_id, struct pldm_msg *msg,
+				  size_t *payload_length)
+{
+	assert(tmpl != NULL && msg != NULL && payload_length != NULL);
+
+	if (instance_id > PLDM_INSTANCE_ID_MASK) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+	if (sizeof(struct pldm_msg_hdr) + *payload_length < tmpl->size) {
+		return PLDM_ERROR_INVALID_LENGTH;
+	}
+
+	uint8_t *bytes = (uint8_t *)msg;
+	response_template_copy(bytes, tmpl->msg, tmpl->size,
+			       response_template_hdr_byte(tmpl, instance_id));
+	*payload_length = tmpl->size - sizeof(struct pldm_msg_hdr);
+
+	return PLDM_SUCCESS;
+}
+
+int pldm_response_template_iov(const pldm_response_template *tmpl,
+			       uint8_t instance_id, uint8_t *hdr_byte,
+			       struct iovec *iov)
+{
+	assert(tmpl != NULL && hdr_byte != NULL && iov != NULL);
+
+	if (instance_id > PLDM_INSTANCE_ID_MASK) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	*hdr_byte = response_template_hdr_byte(tmpl, instance_id);
+	iov[0].iov_base = hdr_byte;
+	iov[0].iov_len = 1;
+	iov[1].iov_base = (void *)(tmpl->msg + 1);
+	iov[1].iov_len = tmpl->size - 1;
+
+	return PLDM_SUCCESS;
+}
+
+int pldm_response_template_handler(void *ctx,
+				   const struct pldm_header_info *hdr,
+				   const struct pldm_msg *request,
+				   size_t payload_length,
+				   struct pldm_msg *response,
+				   size_t *response_payload_length)
+{
+	(void)request;
+	(void)payload_length;
+
+	assert(ctx != NULL && hdr != NULL);
+
+	return pldm_response_template_encode(ctx, hdr->instance, response,
+					     response_payload_length);
+}
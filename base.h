@@ -6,8 +6,10 @@ extern "C" {
 #endif
 
 #include <asm/byteorder.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <sys/uio.h>
 
 #include "pldm_types.h"
 #include "utils.h"
@@ -67,6 +69,7 @@ typedef uint8_t pldm_type_t;
 #define PLDM_TID_MAX 0xFF
 #define PLDM_INSTANCE_ID_MASK 0x1F
 #define PLDM_INSTANCE_MAX 32
+#define PLDM_INSTANCE_ID_EXPIRY_MS 5000
 #define PLDM_MAX_TYPES 64
 #define PLDM_MAX_CMDS_PER_TYPE 256
 
@@ -256,6 +259,49 @@ int pack_pldm_header(const struct pldm_header_info *hdr,
 int unpack_pldm_header(const struct pldm_msg_hdr *msg,
 		       struct pldm_header_info *hdr);
 
+/** @brief Pack a PLDM header, without going through pldm_header_info
+ *
+ *  The header is built in one go rather than field by field.
+ *
+ *  @param[in] msg_type - PLDM message type, a MessageType
+ *  @param[in] instance_id - Message's instance id
+ *  @param[in] pldm_type - PLDM Type
+ *  @param[in] command - PLDM Command
+ *  @param[out] msg - Header will be written to this
+ *  @return PLDM_SUCCESS, PLDM_ERROR_INVALID_PLDM_TYPE or
+ *          PLDM_ERROR_INVALID_DATA
+ */
+int pack_pldm_header_fast(uint8_t msg_type, uint8_t instance_id,
+			  uint8_t pldm_type, uint8_t command,
+			  struct pldm_msg_hdr *msg);
+
+/** @brief Unpack a PLDM header, without going through pldm_header_info
+ *
+ *  @param[in] msg - PLDM message header
+ *  @param[out] msg_type - PLDM message type, a MessageType
+ *  @param[out] instance_id - Message's instance id
+ *  @param[out] pldm_type - PLDM Type
+ *  @param[out] command - PLDM Command
+ *  @return PLDM_SUCCESS or PLDM_ERROR_INVALID_DATA
+ */
+int unpack_pldm_header_fast(const struct pldm_msg_hdr *msg, uint8_t *msg_type,
+			    uint8_t *instance_id, uint8_t *pldm_type,
+			    uint8_t *command);
+
+/** @brief Check an array of received PLDM headers at once
+ *
+ *  A header is valid if its reserved bit is clear, its header version is
+ *  PLDM_CURRENT_VERSION, and its Rq and D bits are not the reserved
+ *  combination.
+ *
+ *  @param[in] hdrs - PLDM message headers, one after the other
+ *  @param[in] count - Number of headers
+ *  @param[out] valid - Whether each header is valid
+ *  @return Number of valid headers
+ */
+size_t validate_pldm_headers(const struct pldm_msg_hdr *hdrs, size_t count,
+			     bool *valid);
+
 /* Requester */
 
 /* GetPLDMTypes */
@@ -604,6 +650,828 @@ int encode_pldm_header(const uint8_t instance_id, const uint8_t pldm_type,
 		       const uint8_t command, const uint8_t msg_type,
 		       struct pldm_msg *msg);
 
+/** @struct pldm_instance_id_alloc
+ *
+ *  opaque structure allocating the instance IDs of requests to each
+ *  terminus, safe to share between threads without locking
+ */
+typedef struct pldm_instance_id_alloc pldm_instance_id_alloc;
+
+/** @brief Make a new instance ID allocator, with all IDs free
+ *
+ *  @param[in] expiry_ms - Time after which an ID that was not released may be
+ *             handed out again, e.g. PLDM_INSTANCE_ID_EXPIRY_MS
+ *  @return opaque pointer that acts as a handle to the allocator
+ */
+pldm_instance_id_alloc *pldm_instance_id_alloc_init(uint32_t expiry_ms);
+
+/** @brief Destroy an instance ID allocator
+ *
+ *  @param[in] alloc - opaque pointer acting as a handle to the allocator
+ */
+void pldm_instance_id_alloc_destroy(pldm_instance_id_alloc *alloc);
+
+/** @brief Set the clock an instance ID allocator times IDs with
+ *
+ *  @param[in] alloc - opaque pointer acting as a handle to the allocator
+ *  The clock only times the expiry of IDs. The timeout of
+ *  pldm_instance_id_acquire() is always measured on the monotonic clock.
+ *
+ *  @param[in] now_ms - Returns the time in milliseconds, never 0, or NULL
+ *             for the monotonic clock, which is the default
+ */
+void pldm_instance_id_alloc_set_clock(pldm_instance_id_alloc *alloc,
+				      uint64_t (*now_ms)(void));
+
+/** @brief Acquire an instance ID for a request to a terminus, without
+ *         waiting
+ *
+ *  IDs are handed out in turn rather than lowest first. When all are in use,
+ *  one that has been held for longer than the expiry interval is handed out
+ *  again, and the token of its previous holder no longer releases it.
+ *
+ *  @param[in] alloc - opaque pointer acting as a handle to the allocator
+ *  @param[in] tid - Terminus ID
+ *  @param[out] instance_id - Acquired instance ID
+ *  @param[out] token - Token to release the ID with
+ *  @return PLDM_SUCCESS, PLDM_ERROR_NOT_READY if all IDs are in use, or
+ *          PLDM_ERROR_INVALID_DATA
+ */
+int pldm_instance_id_try_acquire(pldm_instance_id_alloc *alloc, uint8_t tid,
+				 uint8_t *instance_id, uint64_t *token);
+
+/** @brief Acquire an instance ID for a request to a terminus, waiting for
+ *         one to be released or to expire if all are in use
+ *
+ *  @param[in] alloc - opaque pointer acting as a handle to the allocator
+ *  @param[in] tid - Terminus ID
+ *  @param[in] timeout_ms - How long to wait at most, on the monotonic clock
+ *             whatever the clock of the allocator
+ *  @param[out] instance_id - Acquired instance ID
+ *  @param[out] token - Token to release the ID with
+ *  @return PLDM_SUCCESS, PLDM_ERROR_NOT_READY on timeout, or
+ *          PLDM_ERROR_INVALID_DATA
+ */
+int pldm_instance_id_acquire(pldm_instance_id_alloc *alloc, uint8_t tid,
+			     uint32_t timeout_ms, uint8_t *instance_id,
+			     uint64_t *token);
+
+/** @brief Release an instance ID, once the response to its request arrived
+ *         or the request was given up
+ *
+ *  @param[in] alloc - opaque pointer acting as a handle to the allocator
+ *  @param[in] tid - Terminus ID
+ *  @param[in] instance_id - Instance ID to release
+ *  @param[in] token - Token the ID was acquired with
+ *  @return PLDM_SUCCESS, or PLDM_ERROR_INVALID_DATA if the ID is not held
+ *          with this token, as when it was released already or expired and
+ *          was handed out again
+ */
+int pldm_instance_id_release(pldm_instance_id_alloc *alloc, uint8_t tid,
+			     uint8_t instance_id, uint64_t token);
+
+/** @brief Acquire an instance ID, without waiting, and encode the header of
+ *         a request with it
+ *
+ *  The ID is in msg->hdr.instance_id, to be released like any other.
+ *
+ *  @param[in] alloc - opaque pointer acting as a handle to the allocator
+ *  @param[in] tid - Terminus ID
+ *  @param[in] pldm_type - PLDM Type
+ *  @param[in] command - PLDM Command
+ *  @param[out] msg - Message will be written to this
+ *  @param[out] token - Token to release the ID with
+ *  @return pldm_completion_codes, as pldm_instance_id_try_acquire() and
+ *          encode_pldm_header()
+ */
+int pldm_instance_id_encode_request_header(pldm_instance_id_alloc *alloc,
+					   uint8_t tid, uint8_t pldm_type,
+					   uint8_t command, struct pldm_msg *msg,
+					   uint64_t *token);
+
+/** @struct pldm_request_tracker
+ *
+ *  opaque structure tracking the requests awaiting a response, by TID and
+ *  instance ID, with a timer wheel of their deadlines. It is allocated once
+ *  and then needs no allocation.
+ */
+typedef struct pldm_request_tracker pldm_request_tracker;
+
+/** @struct pldm_request_expiry
+ *
+ *  A request whose deadline passed without a response
+ */
+struct pldm_request_expiry {
+	uint8_t tid;
+	uint8_t instance_id;
+	uint8_t pldm_type;
+	uint8_t command;
+	void *context; //!< as registered
+};
+
+/** @brief Make a new request tracker, with no requests
+ *
+ *  @param[in] resolution_ms - Granularity of deadlines, must not be 0
+ *  @param[in] now_ms - Current time, on the clock deadlines are given on
+ *  @return opaque pointer that acts as a handle to the tracker
+ */
+pldm_request_tracker *pldm_request_tracker_init(uint32_t resolution_ms,
+						uint64_t now_ms);
+
+/** @brief Destroy a request tracker
+ *
+ *  @param[in] tracker - opaque pointer acting as a handle to the tracker
+ */
+void pldm_request_tracker_destroy(pldm_request_tracker *tracker);
+
+/** @brief Track a request that was sent
+ *
+ *  @param[in/out] tracker - opaque pointer acting as a handle to the tracker
+ *  @param[in] tid - Terminus ID the request was sent to
+ *  @param[in] instance_id - Instance ID of the request
+ *  @param[in] pldm_type - PLDM Type of the request
+ *  @param[in] command - PLDM Command of the request
+ *  @param[in] deadline_ms - Time after which the request expires
+ *  @param[in] context - Caller data returned with the request
+ *  @return PLDM_SUCCESS, or PLDM_ERROR_INVALID_DATA if a request with the
+ *          same TID and instance ID is already tracked
+ */
+int pldm_request_tracker_register(pldm_request_tracker *tracker, uint8_t tid,
+				  uint8_t instance_id, uint8_t pldm_type,
+				  uint8_t command, uint64_t deadline_ms,
+				  void *context);
+
+/** @brief Find the request a response answers
+ *
+ *  The request stays tracked until pldm_request_tracker_complete().
+ *
+ *  @param[in] tracker - opaque pointer acting as a handle to the tracker
+ *  @param[in] tid - Terminus ID the response came from
+ *  @param[in] msg - Header of the response
+ *  @param[out] context - If not NULL, caller data of the request
+ *  @return PLDM_SUCCESS, or PLDM_ERROR_INVALID_DATA if msg is not a
+ *          response to a tracked request of the same PLDM Type and Command
+ */
+int pldm_request_tracker_match(const pldm_request_tracker *tracker,
+			       uint8_t tid, const struct pldm_msg_hdr *msg,
+			       void **context);
+
+/** @brief Stop tracking a request, e.g. once its response was handled
+ *
+ *  @param[in/out] tracker - opaque pointer acting as a handle to the tracker
+ *  @param[in] tid - Terminus ID the request was sent to
+ *  @param[in] instance_id - Instance ID of the request
+ *  @return PLDM_SUCCESS, or PLDM_ERROR_INVALID_DATA if no such request is
+ *          tracked
+ */
+int pldm_request_tracker_complete(pldm_request_tracker *tracker, uint8_t tid,
+				  uint8_t instance_id);
+
+/** @brief Stop tracking the requests whose deadline passed, to retry or fail
+ *         them
+ *
+ *  @param[in/out] tracker - opaque pointer acting as a handle to the tracker
+ *  @param[in] now_ms - Current time
+ *  @param[out] expired - Expired requests
+ *  @param[in] max_expired - Size of expired. If more requests expired, the
+ *             rest are returned by the next call.
+ *  @return Number of expired requests returned
+ */
+size_t pldm_request_tracker_expire(pldm_request_tracker *tracker,
+				   uint64_t now_ms,
+				   struct pldm_request_expiry *expired,
+				   size_t max_expired);
+
+/** @brief Handler of the requests of one PLDM type and command
+ *
+ *  @param[in] ctx - Caller data given at registration
+ *  @param[in] hdr - Unpacked header of the request
+ *  @param[in] request - Request message, for its decode_*_req() function
+ *  @param[in] payload_length - Length of the request payload
+ *  @param[out] response - Response message will be written to this
+ *  @param[in/out] response_payload_length - Space for the response payload
+ *                 on input, length of the response payload on output
+ *  @return pldm_completion_codes
+ */
+typedef int (*pldm_responder_handler)(void *ctx,
+				      const struct pldm_header_info *hdr,
+				      const struct pldm_msg *request,
+				      size_t payload_length,
+				      struct pldm_msg *response,
+				      size_t *response_payload_length);
+
+/** @struct pldm_responder
+ *
+ *  opaque structure dispatching requests to handlers through a table indexed
+ *  by PLDM type and command
+ */
+typedef struct pldm_responder pldm_responder;
+
+/** @brief Make a new responder
+ *
+ *  GetPLDMTypes and GetPLDMCommands are handled from the start, and report
+ *  the PLDM types and commands with a registered handler.
+ *
+ *  @return opaque pointer that acts as a handle to the responder
+ */
+pldm_responder *pldm_responder_init();
+
+/** @brief Destroy a responder
+ *
+ *  @param[in] responder - opaque pointer acting as a handle to the responder
+ */
+void pldm_responder_destroy(pldm_responder *responder);
+
+/** @brief Set the handler of a PLDM type and command
+ *
+ *  @param[in/out] responder - opaque pointer acting as a handle to the
+ *                 responder
+ *  @param[in] pldm_type - PLDM Type
+ *  @param[in] command - PLDM Command
+ *  @param[in] handler - Handler, replacing any previous one, or NULL to
+ *             no longer support the command
+ *  @param[in] ctx - Caller data passed to the handler
+ *  @return PLDM_SUCCESS, or PLDM_ERROR_INVALID_DATA if pldm_type is not
+ *          below PLDM_MAX_TYPES
+ */
+int pldm_responder_register(pldm_responder *responder, uint8_t pldm_type,
+			    uint8_t command, pldm_responder_handler handler,
+			    void *ctx);
+
+/** @brief Call the handler of a request
+ *
+ *  Requests of a PLDM type without any handler get a
+ *  PLDM_ERROR_INVALID_PLDM_TYPE response, and other requests without a
+ *  handler a PLDM_ERROR_UNSUPPORTED_PLDM_CMD response.
+ *
+ *  @param[in] responder - opaque pointer acting as a handle to the responder
+ *  @param[in] request - Request message
+ *  @param[in] payload_length - Length of the request payload
+ *  @param[out] response - Response message will be written to this
+ *  @param[in/out] response_payload_length - Space for the response payload
+ *                 on input, length of the response payload on output
+ *  @return pldm_completion_codes of the handler, or PLDM_ERROR_INVALID_DATA
+ *          if the message is not a request
+ */
+int pldm_responder_dispatch(const pldm_responder *responder,
+			    const struct pldm_msg *request,
+			    size_t payload_length, struct pldm_msg *response,
+			    size_t *response_payload_length);
+
+/* Message buffer pool */
+
+#define PLDM_MSG_POOL_NUM_CLASSES 3
+/* Header with a completion code and a few bytes of payload */
+#define PLDM_MSG_POOL_SMALL_SIZE 16
+/* MCTP baseline transmission unit */
+#define PLDM_MSG_POOL_BASELINE_SIZE 64
+/* Largest message the pool hands out */
+#define PLDM_MSG_POOL_MAX_SIZE 4096
+/* Free buffers kept per size class and thread */
+#define PLDM_MSG_POOL_MAX_CACHED 32
+
+/** @struct pldm_msg_pool_stats
+ *
+ *  Counters of the message buffer pool of the calling thread
+ */
+struct pldm_msg_pool_stats {
+	size_t acquired;	 //!< Buffers handed out
+	size_t released;	 //!< Buffers given back
+	size_t heap_allocations; //!< Buffers taken from the heap
+	size_t heap_frees;	 //!< Buffers returned to the heap
+	size_t cached;		 //!< Free buffers held by the pool
+};
+
+/** @brief Get a message buffer from the pool of the calling thread
+ *
+ *  The buffer is taken from the smallest size class that fits the message,
+ *  and only comes from the heap when that class has no free buffer left.
+ *  Its contents are not initialised.
+ *
+ *  @param[in] payload_length - Length of the message payload
+ *  @return message buffer with room for a header and payload_length bytes,
+ *          or NULL if the message is larger than PLDM_MSG_POOL_MAX_SIZE
+ */
+struct pldm_msg *pldm_msg_pool_acquire(size_t payload_length);
+
+/** @brief Give a message buffer back to the pool of the calling thread
+ *
+ *  The buffer may have been acquired on another thread. Once
+ *  PLDM_MSG_POOL_MAX_CACHED buffers of its size class are free, it goes
+ *  back to the heap instead. The calling thread must call
+ *  pldm_msg_pool_drain() before it exits.
+ *
+ *  @param[in] msg - Buffer from pldm_msg_pool_acquire(), or NULL
+ */
+void pldm_msg_pool_release(struct pldm_msg *msg);
+
+/** @brief Return the free buffers of the calling thread to the heap
+ *
+ *  Every thread that released buffers to the pool must call this before it
+ *  exits. The pool does not hook thread exit, so the buffers cached by a
+ *  thread that exits without draining are leaked.
+ */
+void pldm_msg_pool_drain();
+
+/** @brief Get the counters of the pool of the calling thread
+ *
+ *  @param[out] stats - Counters since the thread started
+ */
+void pldm_msg_pool_get_stats(struct pldm_msg_pool_stats *stats);
+
+/* Endpoint discovery */
+
+#define PLDM_DISCOVERY_MAX_RETRIES 3
+/* Largest request payload the discovery makes */
+#define PLDM_DISCOVERY_REQ_BYTES PLDM_GET_VERSION_REQ_BYTES
+
+/** @struct pldm_discovery_record
+ *
+ *  What discovery learnt about an endpoint
+ */
+struct pldm_discovery_record {
+	uint8_t eid;		//!< Endpoint the requests went to
+	uint8_t tid;		//!< Terminus ID from GetTID
+	bitfield8_t types[8];	//!< Types from GetPLDMTypes that answered
+				//!< GetPLDMVersion and GetPLDMCommands
+	ver32_t versions[PLDM_MAX_TYPES]; //!< First version of each type
+	bitfield8_t commands[PLDM_MAX_TYPES]
+			    [PLDM_MAX_CMDS_PER_TYPE / 8]; //!< Commands of each
+							  //!< type
+};
+
+/** @struct pldm_discovery
+ *
+ *  opaque structure walking endpoints through GetTID, GetPLDMTypes, and
+ *  GetPLDMVersion and GetPLDMCommands for each type, with many requests in
+ *  flight at once. It does no I/O: the caller sends the requests it makes
+ *  and feeds back the responses.
+ */
+typedef struct pldm_discovery pldm_discovery;
+
+/** @brief Make a new discovery
+ *
+ *  @param[in] window - Most requests in flight at once, over all endpoints
+ *  @return opaque pointer that acts as a handle to the discovery
+ */
+pldm_discovery *pldm_discovery_init(size_t window);
+
+/** @brief Destroy a discovery
+ *
+ *  @param[in] discovery - opaque pointer acting as a handle to the discovery
+ */
+void pldm_discovery_destroy(pldm_discovery *discovery);
+
+/** @brief Start discovering an endpoint
+ *
+ *  An endpoint already known is discovered again from the start.
+ *
+ *  @param[in/out] discovery - opaque pointer acting as a handle to the
+ *                 discovery
+ *  @param[in] eid - Endpoint to discover
+ *  @return PLDM_SUCCESS, or PLDM_ERROR_NOT_READY if requests to the endpoint
+ *          are still in flight
+ */
+int pldm_discovery_add(pldm_discovery *discovery, uint8_t eid);
+
+/** @brief Make the next request to send
+ *
+ *  Endpoints take turns, and the requests of each endpoint that do not
+ *  depend on each other are all made before any response comes back.
+ *
+ *  @param[in/out] discovery - opaque pointer acting as a handle to the
+ *                 discovery
+ *  @param[out] eid - Endpoint to send the request to
+ *  @param[out] msg - Request message will be written to this
+ *  @param[in/out] payload_length - Space for the request payload on input,
+ *                 at least PLDM_DISCOVERY_REQ_BYTES, length of the request
+ *                 payload on output
+ *  @return PLDM_SUCCESS, PLDM_ERROR_NOT_READY if the window is full or
+ *          no request can be made until a response comes back, or
+ *          PLDM_ERROR_INVALID_LENGTH
+ */
+int pldm_discovery_next_request(pldm_discovery *discovery, uint8_t *eid,
+				struct pldm_msg *msg, size_t *payload_length);
+
+/** @brief Feed a response back
+ *
+ *  Responses that do not decode, or whose version data fails the CRC32
+ *  check, make the request again. Types whose GetPLDMVersion or
+ *  GetPLDMCommands fail with a completion code are left out of the record.
+ *
+ *  @param[in/out] discovery - opaque pointer acting as a handle to the
+ *                 discovery
+ *  @param[in] eid - Endpoint the response came from
+ *  @param[in] msg - Response message
+ *  @param[in] payload_length - Length of the response payload
+ *  @return PLDM_SUCCESS, or PLDM_ERROR_INVALID_DATA if the response does not
+ *          match a request in flight
+ */
+int pldm_discovery_handle_response(pldm_discovery *discovery, uint8_t eid,
+				   const struct pldm_msg *msg,
+				   size_t payload_length);
+
+/** @brief Give up on a request, for instance when it timed out
+ *
+ *  The request is made again, unless the endpoint already used up
+ *  PLDM_DISCOVERY_MAX_RETRIES, in which case its discovery fails.
+ *
+ *  @param[in/out] discovery - opaque pointer acting as a handle to the
+ *                 discovery
+ *  @param[in] eid - Endpoint the request went to
+ *  @param[in] instance_id - Instance ID of the request
+ *  @return PLDM_SUCCESS, or PLDM_ERROR_INVALID_DATA if no such request is in
+ *          flight
+ */
+int pldm_discovery_cancel(pldm_discovery *discovery, uint8_t eid,
+			  uint8_t instance_id);
+
+/** @brief Get the number of endpoints still being discovered
+ *
+ *  @param[in] discovery - opaque pointer acting as a handle to the discovery
+ *  @return number of endpoints neither done nor failed
+ */
+size_t pldm_discovery_in_progress(const pldm_discovery *discovery);
+
+/** @brief Get what was learnt about an endpoint
+ *
+ *  @param[in] discovery - opaque pointer acting as a handle to the discovery
+ *  @param[in] eid - Endpoint
+ *  @param[out] record - Record of the endpoint, valid until it is added again
+ *              or the discovery is destroyed
+ *  @return PLDM_SUCCESS, PLDM_ERROR_NOT_READY while discovery of the
+ *          endpoint is in progress, PLDM_ERROR if it failed, or
+ *          PLDM_ERROR_INVALID_DATA if the endpoint was never added
+ */
+int pldm_discovery_get_record(const pldm_discovery *discovery, uint8_t eid,
+			      const struct pldm_discovery_record **record);
+
+/* Capability cache */
+
+#define PLDM_CAPABILITY_UID_SIZE 16
+
+/** @struct pldm_capabilities
+ *
+ *  Types, versions and commands of a terminus, with the bitmaps in 64-bit
+ *  words so that a check is a shift and a mask
+ */
+struct pldm_capabilities {
+	uint64_t types; //!< Bit n set if type n is supported
+	uint64_t commands[PLDM_MAX_TYPES]
+			 [PLDM_MAX_CMDS_PER_TYPE / 64]; //!< Bit n % 64 of
+							//!< word n / 64 set
+							//!< if command n is
+							//!< supported
+	ver32_t versions[PLDM_MAX_TYPES]; //!< Version of each type
+};
+
+/** @brief Check whether a terminus supports a PLDM type
+ *
+ *  @param[in] caps - Capabilities of the terminus
+ *  @param[in] type - PLDM Type
+ *  @return true if the type is supported
+ */
+inline bool
+pldm_capabilities_type_supported(const struct pldm_capabilities *caps,
+				 uint8_t type)
+{
+	return type < PLDM_MAX_TYPES && ((caps->types >> type) & 1);
+}
+
+/** @brief Check whether a terminus supports a command
+ *
+ *  @param[in] caps - Capabilities of the terminus
+ *  @param[in] type - PLDM Type
+ *  @param[in] command - PLDM Command
+ *  @return true if the type and command are supported
+ */
+inline bool
+pldm_capabilities_command_supported(const struct pldm_capabilities *caps,
+				    uint8_t type, uint8_t command)
+{
+	return type < PLDM_MAX_TYPES &&
+	       ((caps->commands[type][command / 64] >> (command % 64)) & 1);
+}
+
+/** @brief Set the types of a terminus from a GetPLDMTypes response
+ *
+ *  Commands and versions of types no longer supported are cleared.
+ *
+ *  @param[in/out] caps - Capabilities of the terminus
+ *  @param[in] types - Types from decode_get_types_resp()
+ */
+void pldm_capabilities_set_types(struct pldm_capabilities *caps,
+				 const bitfield8_t *types);
+
+/** @brief Set the version and commands of a type from GetPLDMVersion and
+ *         GetPLDMCommands responses
+ *
+ *  @param[in/out] caps - Capabilities of the terminus
+ *  @param[in] type - PLDM Type, which must be supported
+ *  @param[in] version - Version of the type
+ *  @param[in] commands - Commands from decode_get_commands_resp()
+ *  @return PLDM_SUCCESS, or PLDM_ERROR_INVALID_PLDM_TYPE if the type is not
+ *          supported
+ */
+int pldm_capabilities_set_commands(struct pldm_capabilities *caps,
+				   uint8_t type, ver32_t version,
+				   const bitfield8_t *commands);
+
+/** @brief Convert what discovery learnt about an endpoint
+ *
+ *  @param[out] caps - Capabilities of the terminus
+ *  @param[in] record - Record from pldm_discovery_get_record()
+ */
+void pldm_capabilities_from_discovery(
+    struct pldm_capabilities *caps, const struct pldm_discovery_record *record);
+
+/** @struct pldm_capability_cache
+ *
+ *  opaque structure holding the capabilities of termini by TID, and by
+ *  terminus UID so they can be saved and loaded on a later boot
+ */
+typedef struct pldm_capability_cache pldm_capability_cache;
+
+/** @brief Make a new, empty capability cache
+ *
+ *  @return opaque pointer that acts as a handle to the cache
+ */
+pldm_capability_cache *pldm_capability_cache_init();
+
+/** @brief Destroy a capability cache
+ *
+ *  @param[in] cache - opaque pointer acting as a handle to the cache
+ */
+void pldm_capability_cache_destroy(pldm_capability_cache *cache);
+
+/** @brief Store the capabilities of a terminus
+ *
+ *  Replaces what was stored for the TID or the UID before.
+ *
+ *  @param[in/out] cache - opaque pointer acting as a handle to the cache
+ *  @param[in] tid - Terminus ID
+ *  @param[in] uid - PLDM_CAPABILITY_UID_SIZE bytes UID from GetTerminusUID
+ *  @param[in] caps - Capabilities of the terminus
+ */
+void pldm_capability_cache_set(pldm_capability_cache *cache, uint8_t tid,
+			       const uint8_t *uid,
+			       const struct pldm_capabilities *caps);
+
+/** @brief Get the capabilities of a terminus
+ *
+ *  @param[in] cache - opaque pointer acting as a handle to the cache
+ *  @param[in] tid - Terminus ID
+ *  @return capabilities of the terminus, valid until the cache changes, or
+ *          NULL if there are none for the TID
+ */
+const struct pldm_capabilities *
+pldm_capability_cache_get(const pldm_capability_cache *cache, uint8_t tid);
+
+/** @brief Give a terminus the capabilities stored for its UID
+ *
+ *  This is how a terminus seen on an earlier boot skips discovery: after
+ *  pldm_capability_cache_load(), look its UID up under its new TID.
+ *
+ *  @param[in/out] cache - opaque pointer acting as a handle to the cache
+ *  @param[in] uid - PLDM_CAPABILITY_UID_SIZE bytes UID from GetTerminusUID
+ *  @param[in] tid - Terminus ID the terminus has now
+ *  @return PLDM_SUCCESS, or PLDM_ERROR_INVALID_DATA if nothing is stored for
+ *          the UID and the terminus must be discovered
+ */
+int pldm_capability_cache_bind(pldm_capability_cache *cache,
+			       const uint8_t *uid, uint8_t tid);
+
+/** @brief Forget the capabilities of a terminus
+ *
+ *  @param[in/out] cache - opaque pointer acting as a handle to the cache
+ *  @param[in] tid - Terminus ID
+ */
+void pldm_capability_cache_remove(pldm_capability_cache *cache, uint8_t tid);
+
+/** @brief Get the size pldm_capability_cache_save() needs
+ *
+ *  @param[in] cache - opaque pointer acting as a handle to the cache
+ *  @return size in bytes
+ */
+size_t pldm_capability_cache_saved_size(const pldm_capability_cache *cache);
+
+/** @brief Save the cache, keyed by UID, to a buffer
+ *
+ *  Only the types a terminus supports take up space. The data is little
+ *  endian and ends with a CRC32.
+ *
+ *  @param[in] cache - opaque pointer acting as a handle to the cache
+ *  @param[out] data - Buffer to save to
+ *  @param[in] size - Size of the buffer
+ *  @return PLDM_SUCCESS, or PLDM_ERROR_INVALID_LENGTH if the buffer is
+ *          smaller than pldm_capability_cache_saved_size()
+ */
+int pldm_capability_cache_save(const pldm_capability_cache *cache,
+			       uint8_t *data, size_t size);
+
+/** @brief Load saved capabilities
+ *
+ *  The loaded capabilities belong to no TID until
+ *  pldm_capability_cache_bind(). UIDs already bound to a TID keep what they
+ *  have. Nothing is loaded unless all of the data is valid.
+ *
+ *  @param[in/out] cache - opaque pointer acting as a handle to the cache
+ *  @param[in] data - Data from pldm_capability_cache_save()
+ *  @param[in] size - Size of the data
+ *  @return PLDM_SUCCESS, PLDM_ERROR_INVALID_LENGTH, or
+ *          PLDM_ERROR_INVALID_DATA if the data is malformed or fails its
+ *          CRC32
+ */
+int pldm_capability_cache_load(pldm_capability_cache *cache,
+			       const uint8_t *data, size_t size);
+
+/* Multipart GetPLDMVersion */
+
+/** @brief Compare two versions
+ *
+ *  Major, minor and update are compared as numbers, whether encoded as one
+ *  digit (0xFn) or two BCD digits, and an absent update (0xFF) comes before
+ *  any other. The alpha byte breaks ties.
+ *
+ *  @param[in] a - Version
+ *  @param[in] b - Version
+ *  @return negative, zero or positive as a is older than, the same as or
+ *          newer than b
+ */
+int pldm_ver32_compare(const ver32_t *a, const ver32_t *b);
+
+/** @brief Create a part of a GetPLDMVersion response
+ *
+ *  The version data, the versions followed by their CRC32, is split into
+ *  parts that fit max_payload_length. The transfer handle of a part is the
+ *  offset of its data, so no state is kept between requests.
+ *
+ *  @param[in] instance_id - Message's instance id
+ *  @param[in] versions - Versions of the PLDM type
+ *  @param[in] num_versions - Number of versions, at least one
+ *  @param[in] transfer_handle - Handle from the request
+ *  @param[in] transfer_opflag - Operation flag from the request
+ *  @param[in] max_payload_length - Largest response payload to make, more
+ *             than PLDM_GET_VERSION_RESP_FIXED_BYTES
+ *  @param[out] msg - Response message will be written to this
+ *  @param[out] payload_length - Length of the response payload
+ *  @return PLDM_SUCCESS, with a PLDM_INVALID_TRANSFER_OPERATION_FLAG or
+ *          PLDM_ERROR_INVALID_DATA completion code in msg for a bad
+ *          operation flag or transfer handle, or PLDM_ERROR_INVALID_DATA or
+ *          PLDM_ERROR_INVALID_LENGTH for bad arguments
+ */
+int encode_get_version_resp_multipart(uint8_t instance_id,
+				      const ver32_t *versions,
+				      size_t num_versions,
+				      uint32_t transfer_handle,
+				      uint8_t transfer_opflag,
+				      size_t max_payload_length,
+				      struct pldm_msg *msg,
+				      size_t *payload_length);
+
+/** @struct pldm_version_reassembler
+ *
+ *  Requester side of a multipart GetPLDMVersion transfer. The CRC32 is
+ *  computed as the parts arrive, holding back the last four bytes until
+ *  the transfer ends, and the versions are kept sorted.
+ */
+struct pldm_version_reassembler {
+	ver32_t *versions;	  //!< Newest versions so far, oldest first
+	size_t max_versions;	  //!< Room in versions
+	size_t num_versions;	  //!< Versions kept in versions
+	uint32_t transfer_handle; //!< Handle of the next request
+	uint8_t transfer_opflag;  //!< Operation flag of the next request
+	uint32_t crc;		  //!< CRC32 of the data before the tail
+	size_t length;		  //!< Bytes of version data so far
+	uint8_t tail[4];	  //!< Last bytes, which may be the CRC32
+	size_t tail_length;	  //!< Bytes in tail
+	ver32_t partial;	  //!< Version split across parts
+	ver32_t first;		  //!< First version in the data
+};
+
+/** @brief Start a multipart GetPLDMVersion transfer
+ *
+ *  @param[out] reassembler - Transfer state
+ *  @param[out] versions - Buffer for the versions. If the terminus reports
+ *              more than max_versions, only the newest are kept.
+ *  @param[in] max_versions - Room in versions, at least one
+ */
+void pldm_version_reassembler_init(struct pldm_version_reassembler *reassembler,
+				   ver32_t *versions, size_t max_versions);
+
+/** @brief Create the next GetPLDMVersion request of a transfer
+ *
+ *  @param[in] reassembler - Transfer state
+ *  @param[in] instance_id - Message's instance id
+ *  @param[in] type - PLDM Type
+ *  @param[out] msg - Request message will be written to this, with room for
+ *              PLDM_GET_VERSION_REQ_BYTES of payload
+ *  @return pldm_completion_codes
+ */
+int pldm_version_reassembler_encode_req(
+    const struct pldm_version_reassembler *reassembler, uint8_t instance_id,
+    uint8_t type, struct pldm_msg *msg);
+
+/** @brief Add a GetPLDMVersion response to a transfer
+ *
+ *  @param[in/out] reassembler - Transfer state
+ *  @param[in] msg - Response message
+ *  @param[in] payload_length - Length of the response payload
+ *  @param[out] completion_code - Completion code of the response
+ *  @param[out] complete - Set once the whole version data checked out
+ *  @return PLDM_SUCCESS, PLDM_ERROR_INVALID_LENGTH, or
+ *          PLDM_ERROR_INVALID_DATA if the response does not follow on from
+ *          the previous one or the CRC32 does not match. After an error the
+ *          transfer must be started again.
+ */
+int pldm_version_reassembler_add(struct pldm_version_reassembler *reassembler,
+				 const struct pldm_msg *msg,
+				 size_t payload_length,
+				 uint8_t *completion_code, bool *complete);
+
+/** @brief Find the newest version two lists have in common
+ *
+ *  @param[in] a - Versions, oldest first
+ *  @param[in] num_a - Number of versions in a
+ *  @param[in] b - Versions, oldest first
+ *  @param[in] num_b - Number of versions in b
+ *  @param[out] common - Newest version in both lists
+ *  @return PLDM_SUCCESS, or PLDM_ERROR if there is none
+ */
+int pldm_version_highest_common(const ver32_t *a, size_t num_a,
+				const ver32_t *b, size_t num_b,
+				ver32_t *common);
+
+/* Response templates */
+
+/** @struct pldm_response_template
+ *
+ *  opaque structure holding a response encoded once, to be sent again with
+ *  only the instance ID changed
+ */
+typedef struct pldm_response_template pldm_response_template;
+
+/** @brief Make a template of a response
+ *
+ *  @param[in] msg - Response message, for instance from
+ *             encode_get_types_resp()
+ *  @param[in] payload_length - Length of the response payload
+ *  @return opaque pointer that acts as a handle to the template, or NULL if
+ *          msg is not a response
+ */
+pldm_response_template *
+pldm_response_template_init(const struct pldm_msg *msg, size_t payload_length);
+
+/** @brief Destroy a response template
+ *
+ *  @param[in] tmpl - opaque pointer acting as a handle to the template
+ */
+void pldm_response_template_destroy(pldm_response_template *tmpl);
+
+/** @brief Copy a response template, setting the instance ID
+ *
+ *  @param[in] tmpl - opaque pointer acting as a handle to the template
+ *  @param[in] instance_id - Instance ID of the request
+ *  @param[out] msg - Response message will be written to this
+ *  @param[in/out] payload_length - Space for the response payload on input,
+ *                 length of the response payload on output
+ *  @return PLDM_SUCCESS, PLDM_ERROR_INVALID_DATA for a bad instance ID, or
+ *          PLDM_ERROR_INVALID_LENGTH if the response does not fit
+ */
+int pldm_response_template_encode(const pldm_response_template *tmpl,
+				  uint8_t instance_id, struct pldm_msg *msg,
+				  size_t *payload_length);
+
+/** @brief Point an I/O vector at a response template, for writev() or
+ *         sendmsg()
+ *
+ *  Only the first byte of the header changes with the instance ID. It is
+ *  written to hdr_byte, which iov[0] points at, and iov[1] points at the
+ *  rest of the template, so nothing else is copied.
+ *
+ *  @param[in] tmpl - opaque pointer acting as a handle to the template
+ *  @param[in] instance_id - Instance ID of the request
+ *  @param[out] hdr_byte - First byte of the response, which must outlive
+ *              the I/O
+ *  @param[out] iov - Two entries, valid while the template is
+ *  @return PLDM_SUCCESS, or PLDM_ERROR_INVALID_DATA for a bad instance ID
+ */
+int pldm_response_template_iov(const pldm_response_template *tmpl,
+			       uint8_t instance_id, uint8_t *hdr_byte,
+			       struct iovec *iov);
+
+/** @brief Responder handler answering with a template
+ *
+ *  Register it with pldm_responder_register(), with the template as ctx,
+ *  for commands whose response never changes.
+ */
+int pldm_response_template_handler(void *ctx,
+				   const struct pldm_header_info *hdr,
+				   const struct pldm_msg *request,
+				   size_t payload_length,
+				   struct pldm_msg *response,
+				   size_t *response_payload_length);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <endian.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "fru.h"
@@ -201,71 +202,1073 @@ int encode_fru_record(uint8_t *fru_table, size_t total_size, size_t *curr_size,
 	return PLDM_SUCCESS;
 }
 
-static bool is_table_end(const struct pldm_fru_record_data_format *p,
-			 const void *table, size_t table_size)
+static const size_t fru_record_hdr_size =
+    sizeof(struct pldm_fru_record_data_format) -
+    sizeof(struct pldm_fru_record_tlv);
+static const size_t fru_tlv_hdr_size =
+    sizeof(struct pldm_fru_record_tlv) - 1;
+
+/* Size of the record at the start of @record, or 0 if the record header or
+ * any of its fields runs past the @size bytes available */
+static size_t fru_record_size(const uint8_t *record, size_t size)
+{
+	if (size < fru_record_hdr_size) {
+		return 0;
+	}
+
+	uint8_t num_fru_fields =
+	    ((const struct pldm_fru_record_data_format *)record)->num_fru_fields;
+	size_t pos = fru_record_hdr_size;
+	for (uint8_t i = 0; i < num_fru_fields; ++i) {
+		if (size - pos < fru_tlv_hdr_size ||
+		    size - pos - fru_tlv_hdr_size < record[pos + 1]) {
+			return 0;
+		}
+		pos += fru_tlv_hdr_size + record[pos + 1];
+	}
+
+	return pos;
+}
+
+bool pldm_fru_record_iter_init(struct pldm_fru_record_iter *iter,
+			       const uint8_t *table, size_t table_size)
 {
-	return p ==
-	       (const struct pldm_fru_record_data_format *)((uint8_t *)table +
-							    table_size);
+	if (iter == NULL || (table == NULL && table_size)) {
+		return false;
+	}
+
+	size_t pos = 0;
+	while (pos < table_size) {
+		size_t size = fru_record_size(table + pos, table_size - pos);
+		if (size == 0) {
+			return false;
+		}
+		pos += size;
+	}
+
+	iter->pos = table;
+	iter->end = table + table_size;
+
+	return true;
 }
 
-void get_fru_record_by_option(const uint8_t *table, size_t table_size,
-			      uint8_t *record_table, size_t *record_size,
-			      uint16_t rsi, uint8_t rt, uint8_t ft)
+bool pldm_fru_record_iter_next(struct pldm_fru_record_iter *iter,
+			       struct pldm_fru_record_view *record)
 {
-	const struct pldm_fru_record_data_format *record_data_src =
-	    (const struct pldm_fru_record_data_format *)table;
+	if (iter->pos == iter->end) {
+		return false;
+	}
+
+	const struct pldm_fru_record_data_format *src =
+	    (const struct pldm_fru_record_data_format *)iter->pos;
+	record->record_set_id = le16toh(src->record_set_id);
+	record->record_type = src->record_type;
+	record->num_fru_fields = src->num_fru_fields;
+	record->encoding_type = src->encoding_type;
+	record->tlvs = (const uint8_t *)src->tlvs;
+
+	const uint8_t *tlv = record->tlvs;
+	for (uint8_t i = 0; i < record->num_fru_fields; ++i) {
+		tlv += fru_tlv_hdr_size + tlv[1];
+	}
+	iter->pos = tlv;
+
+	return true;
+}
+
+void pldm_fru_field_iter_init(struct pldm_fru_field_iter *iter,
+			      const struct pldm_fru_record_view *record)
+{
+	iter->pos = record->tlvs;
+	iter->remaining = record->num_fru_fields;
+}
+
+bool pldm_fru_field_iter_next(struct pldm_fru_field_iter *iter,
+			      struct pldm_fru_field_view *field)
+{
+	if (iter->remaining == 0) {
+		return false;
+	}
+
+	const struct pldm_fru_record_tlv *tlv =
+	    (const struct pldm_fru_record_tlv *)iter->pos;
+	field->type = tlv->type;
+	field->length = tlv->length;
+	field->value = tlv->value;
+	iter->pos += fru_tlv_hdr_size + tlv->length;
+	--iter->remaining;
+
+	return true;
+}
+
+int get_fru_record_by_option(const uint8_t *table, size_t table_size,
+			     uint8_t *record_table, size_t *record_size,
+			     uint16_t rsi, uint8_t rt, uint8_t ft)
+{
+	struct pldm_fru_record_iter records;
+	struct pldm_fru_record_view record;
+	struct pldm_fru_field_iter fields;
+	struct pldm_fru_field_view field;
 	struct pldm_fru_record_data_format *record_data_dest;
 	int count = 0;
 
-	const struct pldm_fru_record_tlv *tlv;
 	size_t len;
 	uint8_t *pos = record_table;
 
-	while (!is_table_end(record_data_src, table, table_size)) {
-		if ((record_data_src->record_set_id != htole16(rsi) &&
-		     rsi != 0) ||
-		    (record_data_src->record_type != rt && rt != 0)) {
-			tlv = record_data_src->tlvs;
-			for (int i = 0; i < record_data_src->num_fru_fields;
-			     i++) {
-				len = sizeof(*tlv) - 1 + tlv->length;
-				tlv = (const struct pldm_fru_record_tlv
-					   *)((char *)tlv + len);
-			}
-			record_data_src =
-			    (const struct pldm_fru_record_data_format *)(tlv);
-			continue;
-		}
+	if (!pldm_fru_record_iter_init(&records, table, table_size)) {
+		*record_size = 0;
+		return PLDM_ERROR_INVALID_LENGTH;
+	}
+
+	while (pldm_fru_record_iter_next(&records, &record)) {
+		if ((record.record_set_id != rsi && rsi != 0) ||
+		    (record.record_type != rt && rt != 0)) {
+			continue;
+		}
+
+		len = fru_record_hdr_size;
+		assert(pos - record_table + len < *record_size);
+		memcpy(pos, record.tlvs - len, len);
+
+		record_data_dest = (struct pldm_fru_record_data_format *)pos;
+		pos += len;
+
+		pldm_fru_field_iter_init(&fields, &record);
+		count = 0;
+		while (pldm_fru_field_iter_next(&fields, &field)) {
+			len = fru_tlv_hdr_size + field.length;
+			if (field.type == ft || ft == 0) {
+				assert(pos - record_table + len < *record_size);
+				memcpy(pos, field.value - fru_tlv_hdr_size,
+				       len);
+				pos += len;
+				count++;
+			}
+		}
+		record_data_dest->num_fru_fields = count;
+	}
+
+	*record_size = pos - record_table;
+
+	return PLDM_SUCCESS;
+}
+
+#define FRU_INDEX_NONE UINT32_MAX
+
+struct fru_index_record {
+	uint32_t offset;    /* of the record in the table */
+	uint32_t first_tlv; /* in pldm_fru_table_index.tlv_offsets */
+	uint32_t next;	    /* next record of the same record set */
+	uint16_t record_set_id;
+	uint8_t record_type;
+	uint8_t num_fru_fields;
+};
+
+struct fru_index_rsi {
+	uint32_t first; /* FRU_INDEX_NONE for a free slot */
+	uint32_t last;
+	uint16_t record_set_id;
+};
+
+typedef struct pldm_fru_table_index {
+	size_t indexed_size;
+	struct fru_index_record *records;
+	uint32_t num_records;
+	uint32_t records_capacity;
+	uint32_t *tlv_offsets;
+	uint32_t num_tlvs;
+	uint32_t tlvs_capacity;
+	struct fru_index_rsi *rsis; /* open addressing, keyed on rsi */
+	uint32_t num_rsis;
+	uint32_t rsis_capacity;
+} pldm_fru_table_index;
+
+pldm_fru_table_index *pldm_fru_table_index_init()
+{
+	pldm_fru_table_index *index = calloc(1, sizeof(pldm_fru_table_index));
+	assert(index != NULL);
+
+	return index;
+}
+
+void pldm_fru_table_index_destroy(pldm_fru_table_index *index)
+{
+	assert(index != NULL);
+
+	free(index->records);
+	free(index->tlv_offsets);
+	free(index->rsis);
+	free(index);
+}
+
+static struct fru_index_rsi *fru_index_find_rsi(struct fru_index_rsi *rsis,
+						uint32_t capacity,
+						uint16_t record_set_id)
+{
+	uint32_t i = (record_set_id * 0x9e3779b1u) & (capacity - 1);
+	while (rsis[i].first != FRU_INDEX_NONE &&
+	       rsis[i].record_set_id != record_set_id) {
+		i = (i + 1) & (capacity - 1);
+	}
+
+	return &rsis[i];
+}
+
+static void fru_index_add_rsi(pldm_fru_table_index *index,
+			      uint32_t record_idx)
+{
+	struct fru_index_record *record = &index->records[record_idx];
+
+	if (2 * (index->num_rsis + 1) > index->rsis_capacity) {
+		uint32_t capacity =
+		    index->rsis_capacity ? index->rsis_capacity * 2 : 16;
+		struct fru_index_rsi *rsis =
+		    malloc(capacity * sizeof(struct fru_index_rsi));
+		assert(rsis != NULL);
+		for (uint32_t i = 0; i < capacity; ++i) {
+			rsis[i].first = FRU_INDEX_NONE;
+		}
+		for (uint32_t i = 0; i < index->rsis_capacity; ++i) {
+			if (index->rsis[i].first != FRU_INDEX_NONE) {
+				*fru_index_find_rsi(
+				    rsis, capacity,
+				    index->rsis[i].record_set_id) =
+				    index->rsis[i];
+			}
+		}
+		free(index->rsis);
+		index->rsis = rsis;
+		index->rsis_capacity = capacity;
+	}
+
+	struct fru_index_rsi *rsi = fru_index_find_rsi(
+	    index->rsis, index->rsis_capacity, record->record_set_id);
+	if (rsi->first == FRU_INDEX_NONE) {
+		rsi->first = record_idx;
+		rsi->record_set_id = record->record_set_id;
+		++index->num_rsis;
+	} else {
+		index->records[rsi->last].next = record_idx;
+	}
+	rsi->last = record_idx;
+}
+
+static void fru_index_reset(pldm_fru_table_index *index)
+{
+	index->indexed_size = 0;
+	index->num_records = 0;
+	index->num_tlvs = 0;
+	index->num_rsis = 0;
+	for (uint32_t i = 0; i < index->rsis_capacity; ++i) {
+		index->rsis[i].first = FRU_INDEX_NONE;
+	}
+}
+
+int pldm_fru_table_index_update(pldm_fru_table_index *index,
+				const uint8_t *table, size_t table_size)
+{
+	if (index == NULL || (table == NULL && table_size)) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	if (table_size < index->indexed_size) {
+		fru_index_reset(index);
+	}
+
+	size_t offset = index->indexed_size;
+	while (offset < table_size) {
+		/* Check the whole record fits before indexing any of it */
+		if (fru_record_size(table + offset, table_size - offset) ==
+		    0) {
+			return PLDM_ERROR_INVALID_LENGTH;
+		}
+		const struct pldm_fru_record_data_format *record =
+		    (const struct pldm_fru_record_data_format *)(table +
+								 offset);
+
+		if (index->num_records == index->records_capacity) {
+			index->records_capacity = index->records_capacity
+						      ? index->records_capacity * 2
+						      : 16;
+			index->records = realloc(
+			    index->records, index->records_capacity *
+						sizeof(struct fru_index_record));
+			assert(index->records != NULL);
+		}
+		if (index->num_tlvs + record->num_fru_fields >
+		    index->tlvs_capacity) {
+			while (index->num_tlvs + record->num_fru_fields >
+			       index->tlvs_capacity) {
+				index->tlvs_capacity =
+				    index->tlvs_capacity
+					? index->tlvs_capacity * 2
+					: 64;
+			}
+			index->tlv_offsets =
+			    realloc(index->tlv_offsets,
+				    index->tlvs_capacity * sizeof(uint32_t));
+			assert(index->tlv_offsets != NULL);
+		}
+
+		struct fru_index_record *entry =
+		    &index->records[index->num_records];
+		entry->offset = offset;
+		entry->first_tlv = index->num_tlvs;
+		entry->next = FRU_INDEX_NONE;
+		entry->record_set_id = le16toh(record->record_set_id);
+		entry->record_type = record->record_type;
+		entry->num_fru_fields = record->num_fru_fields;
+
+		size_t tlv_offset = offset + fru_record_hdr_size;
+		for (uint8_t i = 0; i < record->num_fru_fields; ++i) {
+			index->tlv_offsets[index->num_tlvs++] = tlv_offset;
+			tlv_offset += fru_tlv_hdr_size + table[tlv_offset + 1];
+		}
+		fru_index_add_rsi(index, index->num_records++);
+
+		offset = tlv_offset;
+		index->indexed_size = offset;
+	}
+
+	return PLDM_SUCCESS;
+}
+
+size_t pldm_fru_table_index_get_num_records(const pldm_fru_table_index *index)
+{
+	assert(index != NULL);
+	return index->num_records;
+}
+
+size_t pldm_fru_table_index_get_num_rsis(const pldm_fru_table_index *index)
+{
+	assert(index != NULL);
+	return index->num_rsis;
+}
+
+/* Next record of the record set, or of the table if rsi is 0 */
+static uint32_t fru_index_next_record(const pldm_fru_table_index *index,
+				      uint32_t record_idx, uint16_t rsi)
+{
+	if (rsi != 0) {
+		return index->records[record_idx].next;
+	}
+
+	return record_idx + 1 < index->num_records ? record_idx + 1
+						   : FRU_INDEX_NONE;
+}
+
+int pldm_fru_table_index_get_record_by_option(
+    const pldm_fru_table_index *index, const uint8_t *table,
+    uint8_t *record_table, size_t *record_size, uint16_t rsi, uint8_t rt,
+    uint8_t ft)
+{
+	if (index == NULL || record_table == NULL || record_size == NULL ||
+	    (table == NULL && index->num_records)) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	uint32_t record_idx = index->num_records ? 0 : FRU_INDEX_NONE;
+	if (rsi != 0) {
+		record_idx = FRU_INDEX_NONE;
+		if (index->num_rsis) {
+			struct fru_index_rsi *entry = fru_index_find_rsi(
+			    index->rsis, index->rsis_capacity, rsi);
+			record_idx = entry->first;
+		}
+	}
+
+	size_t pos = 0;
+	for (; record_idx != FRU_INDEX_NONE;
+	     record_idx = fru_index_next_record(index, record_idx, rsi)) {
+		const struct fru_index_record *record =
+		    &index->records[record_idx];
+		if (record->record_type != rt && rt != 0) {
+			continue;
+		}
+
+		if (*record_size - pos < fru_record_hdr_size) {
+			return PLDM_ERROR_INVALID_LENGTH;
+		}
+		struct pldm_fru_record_data_format *record_data_dest =
+		    (struct pldm_fru_record_data_format *)(record_table + pos);
+		memcpy(record_data_dest, table + record->offset,
+		       fru_record_hdr_size);
+		pos += fru_record_hdr_size;
+
+		uint8_t count = 0;
+		for (uint8_t i = 0; i < record->num_fru_fields; ++i) {
+			const uint8_t *tlv =
+			    table + index->tlv_offsets[record->first_tlv + i];
+			size_t len = fru_tlv_hdr_size + tlv[1];
+			if (tlv[0] != ft && ft != 0) {
+				continue;
+			}
+			if (*record_size - pos < len) {
+				return PLDM_ERROR_INVALID_LENGTH;
+			}
+			memcpy(record_table + pos, tlv, len);
+			pos += len;
+			++count;
+		}
+		record_data_dest->num_fru_fields = count;
+	}
+
+	*record_size = pos;
+	return PLDM_SUCCESS;
+}
+
+/* The data transfer handle of a GetFRURecordByOption part is the record to
+ * resume from, and 0 to start with its header or the field to resume from
+ * plus 1
+ */
+#define FRU_BY_OPTION_HANDLE(record, field) ((record) << 8 | (field))
+#define FRU_BY_OPTION_HANDLE_RECORD(handle) ((handle) >> 8)
+#define FRU_BY_OPTION_HANDLE_FIELD(handle) ((handle)&0xff)
+
+static uint8_t fru_index_count_fields(const pldm_fru_table_index *index,
+				      const uint8_t *table,
+				      const struct fru_index_record *record,
+				      uint8_t ft)
+{
+	if (ft == 0) {
+		return record->num_fru_fields;
+	}
+
+	uint8_t count = 0;
+	for (uint8_t i = 0; i < record->num_fru_fields; ++i) {
+		if (table[index->tlv_offsets[record->first_tlv + i]] == ft) {
+			++count;
+		}
+	}
+
+	return count;
+}
+
+int pldm_fru_table_index_encode_record_by_option_resp(
+    const pldm_fru_table_index *index, const uint8_t *table,
+    uint8_t instance_id, uint32_t data_transfer_handle,
+    uint8_t transfer_op_flag, uint16_t rsi, uint8_t rt, uint8_t ft,
+    struct pldm_msg *msg, size_t *payload_length)
+{
+	if (index == NULL || msg == NULL || payload_length == NULL ||
+	    (table == NULL && index->num_records)) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+	if (*payload_length < PLDM_GET_FRU_RECORD_BY_OPTION_MIN_RESP_BYTES) {
+		return PLDM_ERROR_INVALID_LENGTH;
+	}
+
+	struct pldm_header_info header = {0};
+	header.instance = instance_id;
+	header.msg_type = PLDM_RESPONSE;
+	header.pldm_type = PLDM_FRU;
+	header.command = PLDM_GET_FRU_RECORD_BY_OPTION;
+	int rc = pack_pldm_header(&header, &(msg->hdr));
+	if (rc != PLDM_SUCCESS) {
+		return rc;
+	}
+
+	struct pldm_get_fru_record_by_option_resp *resp =
+	    (struct pldm_get_fru_record_by_option_resp *)msg->payload;
+	resp->next_data_transfer_handle = 0;
+	resp->transfer_flag = 0;
+
+	/* Where to resume from */
+	uint32_t record_idx = FRU_INDEX_NONE;
+	uint32_t field = 0;
+	if (transfer_op_flag == PLDM_GET_FIRSTPART) {
+		if (rsi == 0) {
+			record_idx = index->num_records ? 0 : FRU_INDEX_NONE;
+		} else if (index->num_rsis) {
+			record_idx = fru_index_find_rsi(index->rsis,
+							index->rsis_capacity,
+							rsi)
+					 ->first;
+		}
+	} else if (transfer_op_flag == PLDM_GET_NEXTPART) {
+		record_idx = FRU_BY_OPTION_HANDLE_RECORD(data_transfer_handle);
+		field = FRU_BY_OPTION_HANDLE_FIELD(data_transfer_handle);
+		/* The cursor is to a record the options select */
+		const struct fru_index_record *record =
+		    record_idx < index->num_records ? &index->records[record_idx]
+						    : NULL;
+		if (record == NULL ||
+		    (rsi != 0 && record->record_set_id != rsi) ||
+		    (rt != 0 && record->record_type != rt) ||
+		    field > record->num_fru_fields) {
+			resp->completion_code =
+			    PLDM_FRU_INVALID_DATA_TRANSFER_HANDLE;
+			*payload_length = 1;
+			return PLDM_SUCCESS;
+		}
+	} else {
+		resp->completion_code = PLDM_FRU_INVALID_TRANSFER_OPERATION_FLAG;
+		*payload_length = 1;
+		return PLDM_SUCCESS;
+	}
+	resp->completion_code = PLDM_SUCCESS;
+
+	uint8_t *pos = resp->fru_structure_data;
+	size_t space =
+	    *payload_length - PLDM_GET_FRU_RECORD_BY_OPTION_MIN_RESP_BYTES;
+	for (; record_idx != FRU_INDEX_NONE;
+	     record_idx = fru_index_next_record(index, record_idx, rsi),
+	     field = 0) {
+		const struct fru_index_record *record =
+		    &index->records[record_idx];
+		if (record->record_type != rt && rt != 0) {
+			continue;
+		}
+
+		if (field == 0) {
+			if (space < fru_record_hdr_size) {
+				break;
+			}
+			memcpy(pos, table + record->offset,
+			       fru_record_hdr_size);
+			((struct pldm_fru_record_data_format *)pos)
+			    ->num_fru_fields =
+			    fru_index_count_fields(index, table, record, ft);
+			pos += fru_record_hdr_size;
+			space -= fru_record_hdr_size;
+			field = 1;
+		}
+
+		for (; field <= record->num_fru_fields; ++field) {
+			const uint8_t *tlv =
+			    table +
+			    index->tlv_offsets[record->first_tlv + field - 1];
+			size_t len = fru_tlv_hdr_size + tlv[1];
+			if (tlv[0] != ft && ft != 0) {
+				continue;
+			}
+			if (space < len) {
+				break;
+			}
+			memcpy(pos, tlv, len);
+			pos += len;
+			space -= len;
+		}
+		if (field <= record->num_fru_fields) {
+			break;
+		}
+	}
+
+	bool first = transfer_op_flag == PLDM_GET_FIRSTPART;
+	if (record_idx == FRU_INDEX_NONE) {
+		resp->transfer_flag = first ? PLDM_START_AND_END : PLDM_END;
+	} else {
+		if (pos == resp->fru_structure_data) {
+			return PLDM_ERROR_INVALID_LENGTH;
+		}
+		resp->transfer_flag = first ? PLDM_START : PLDM_MIDDLE;
+		resp->next_data_transfer_handle =
+		    htole32(FRU_BY_OPTION_HANDLE(record_idx, field));
+	}
+	*payload_length = pos - msg->payload;
+
+	return PLDM_SUCCESS;
+}
+
+static const uint8_t fru_table_pad[FRU_TABLE_MAX_PAD_SIZE];
+
+/* Pad bytes after records of the given size */
+static size_t fru_table_pad_size(size_t size)
+{
+	return (4 - size % 4) % 4;
+}
+
+/* Checksum of records of the given checksum and size, followed by their pad
+ * bytes
+ */
+static uint32_t fru_table_padded_checksum(uint32_t checksum, size_t size)
+{
+	return crc32_update(checksum, fru_table_pad, fru_table_pad_size(size));
+}
+
+/* Whether records of the given checksum and size match the checksum and
+ * length reported for them, counting the pad bytes or not
+ */
+static bool fru_table_matches(uint32_t checksum, size_t size,
+			      uint32_t reported_checksum,
+			      uint32_t reported_length)
+{
+	if (reported_length == size) {
+		return reported_checksum == checksum;
+	}
+
+	return reported_length == size + fru_table_pad_size(size) &&
+	       reported_checksum == fru_table_padded_checksum(checksum, size);
+}
+
+/* Records are indexed, and folded into the checksum, once they are
+ * complete: when the next record is added. The last record can still get
+ * fields, so it is accounted for separately.
+ */
+typedef struct pldm_fru_table {
+	uint8_t *data;
+	size_t size;
+	size_t capacity;
+	size_t last_record; /* offset of the last record, if any */
+	bool has_last_record;
+	uint32_t checksum; /* of the records before the last one */
+	uint32_t *record_checksums; /* of each record before the last one */
+	uint32_t record_checksums_capacity;
+	uint32_t maximum_size; /* accepted with SetFRURecordTable, 0 for none */
+	pldm_fru_table_index *index;
+} pldm_fru_table;
+
+pldm_fru_table *pldm_fru_table_init()
+{
+	pldm_fru_table *table = calloc(1, sizeof(pldm_fru_table));
+	assert(table != NULL);
+	table->index = pldm_fru_table_index_init();
+
+	return table;
+}
+
+void pldm_fru_table_destroy(pldm_fru_table *table)
+{
+	assert(table != NULL);
+
+	pldm_fru_table_index_destroy(table->index);
+	free(table->record_checksums);
+	free(table->data);
+	free(table);
+}
+
+static uint8_t *fru_table_append(pldm_fru_table *table, size_t size)
+{
+	if (table->capacity - table->size < size) {
+		size_t capacity = table->capacity ? table->capacity : 256;
+		while (capacity - table->size < size) {
+			capacity *= 2;
+		}
+		table->data = realloc(table->data, capacity);
+		assert(table->data != NULL);
+		table->capacity = capacity;
+	}
+
+	uint8_t *pos = table->data + table->size;
+	table->size += size;
+	return pos;
+}
+
+/* Fold the checksum of the num_records'th record into the table's */
+static void fru_table_push_record_checksum(pldm_fru_table *table,
+					   uint32_t num_records,
+					   uint32_t record_checksum,
+					   size_t record_size)
+{
+	if (num_records == table->record_checksums_capacity) {
+		table->record_checksums_capacity =
+		    num_records ? num_records * 2 : 16;
+		table->record_checksums =
+		    realloc(table->record_checksums,
+			    table->record_checksums_capacity * sizeof(uint32_t));
+		assert(table->record_checksums != NULL);
+	}
+
+	table->record_checksums[num_records] = record_checksum;
+	table->checksum =
+	    crc32_combine(table->checksum, record_checksum, record_size);
+}
+
+static void fru_table_complete_last_record(pldm_fru_table *table)
+{
+	if (!table->has_last_record) {
+		return;
+	}
+
+	uint32_t num_records = table->index->num_records;
+	size_t record_size = table->size - table->last_record;
+	fru_table_push_record_checksum(
+	    table, num_records,
+	    crc32(table->data + table->last_record, record_size), record_size);
+	int rc =
+	    pldm_fru_table_index_update(table->index, table->data, table->size);
+	assert(rc == PLDM_SUCCESS);
+	assert(table->index->num_records == num_records + 1);
+	(void)rc;
+	table->has_last_record = false;
+}
+
+int pldm_fru_table_add_record(pldm_fru_table *table, uint16_t record_set_id,
+			      uint8_t record_type, uint8_t encoding)
+{
+	if (table == NULL) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	fru_table_complete_last_record(table);
+
+	table->last_record = table->size;
+	table->has_last_record = true;
+	struct pldm_fru_record_data_format *record =
+	    (struct pldm_fru_record_data_format *)fru_table_append(
+		table, fru_record_hdr_size);
+	record->record_set_id = htole16(record_set_id);
+	record->record_type = record_type;
+	record->num_fru_fields = 0;
+	record->encoding_type = encoding;
+
+	return PLDM_SUCCESS;
+}
+
+int pldm_fru_table_add_field(pldm_fru_table *table, uint8_t type,
+			     const uint8_t *value, uint8_t length)
+{
+	if (table == NULL || !table->has_last_record ||
+	    (value == NULL && length)) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	struct pldm_fru_record_data_format *record =
+	    (struct pldm_fru_record_data_format *)(table->data +
+						   table->last_record);
+	if (record->num_fru_fields == UINT8_MAX) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+	++record->num_fru_fields;
+
+	/* record may move */
+	uint8_t *tlv = fru_table_append(table, fru_tlv_hdr_size + length);
+	tlv[0] = type;
+	tlv[1] = length;
+	if (length) {
+		memcpy(tlv + fru_tlv_hdr_size, value, length);
+	}
+
+	return PLDM_SUCCESS;
+}
+
+/* End of the records that are indexed */
+static size_t fru_table_indexed_end(const pldm_fru_table *table)
+{
+	return table->has_last_record ? table->last_record : table->size;
+}
+
+static size_t fru_table_record_size(const pldm_fru_table *table,
+				    uint32_t record_idx)
+{
+	const pldm_fru_table_index *index = table->index;
+	size_t end = record_idx + 1 < index->num_records
+			 ? index->records[record_idx + 1].offset
+			 : fru_table_indexed_end(table);
+
+	return end - index->records[record_idx].offset;
+}
+
+/* Offset of the first field of the given type in the record set, if any.
+ * record_idx is the record in the index, or FRU_INDEX_NONE for the last
+ * record, and tlv_idx the field in the index.
+ */
+static bool fru_table_find_field(const pldm_fru_table *table,
+				 uint16_t record_set_id, uint8_t field_type,
+				 uint32_t *record_idx, uint32_t *tlv_idx,
+				 size_t *offset)
+{
+	const pldm_fru_table_index *index = table->index;
+	if (index->num_rsis) {
+		const struct fru_index_rsi *rsi = fru_index_find_rsi(
+		    index->rsis, index->rsis_capacity, record_set_id);
+		for (uint32_t i = rsi->first; i != FRU_INDEX_NONE;
+		     i = index->records[i].next) {
+			const struct fru_index_record *record =
+			    &index->records[i];
+			for (uint32_t j = record->first_tlv;
+			     j < record->first_tlv + record->num_fru_fields;
+			     ++j) {
+				if (table->data[index->tlv_offsets[j]] ==
+				    field_type) {
+					*record_idx = i;
+					*tlv_idx = j;
+					*offset = index->tlv_offsets[j];
+					return true;
+				}
+			}
+		}
+	}
+
+	if (!table->has_last_record) {
+		return false;
+	}
+	const struct pldm_fru_record_data_format *record =
+	    (const struct pldm_fru_record_data_format *)(table->data +
+							 table->last_record);
+	if (le16toh(record->record_set_id) != record_set_id) {
+		return false;
+	}
+	size_t tlv_offset = table->last_record + fru_record_hdr_size;
+	for (uint8_t i = 0; i < record->num_fru_fields; ++i) {
+		if (table->data[tlv_offset] == field_type) {
+			*record_idx = FRU_INDEX_NONE;
+			*tlv_idx = FRU_INDEX_NONE;
+			*offset = tlv_offset;
+			return true;
+		}
+		tlv_offset += fru_tlv_hdr_size + table->data[tlv_offset + 1];
+	}
+
+	return false;
+}
+
+/* Shift the records after a field whose length changed, and recompute the
+ * checksum of its record
+ */
+static void fru_table_resize_field(pldm_fru_table *table, uint32_t record_idx,
+				   uint32_t tlv_idx, size_t offset,
+				   uint8_t length)
+{
+	uint8_t old_length = table->data[offset + 1];
+	size_t old_end = offset + fru_tlv_hdr_size + old_length;
+	size_t tail = table->size - old_end;
+	if (length > old_length) {
+		fru_table_append(table, length - old_length);
+	} else {
+		table->size -= old_length - length;
+	}
+	memmove(table->data + offset + fru_tlv_hdr_size + length,
+		table->data + old_end, tail);
+	table->data[offset + 1] = length;
+
+	if (record_idx == FRU_INDEX_NONE) {
+		return;
+	}
+
+	pldm_fru_table_index *index = table->index;
+	int shift = (int)length - old_length;
+	for (uint32_t i = record_idx + 1; i < index->num_records; ++i) {
+		index->records[i].offset += shift;
+	}
+	for (uint32_t i = tlv_idx + 1; i < index->num_tlvs; ++i) {
+		index->tlv_offsets[i] += shift;
+	}
+	index->indexed_size += shift;
+	if (table->has_last_record) {
+		table->last_record += shift;
+	}
+}
+
+static void fru_table_update_record_checksum(pldm_fru_table *table,
+					     uint32_t record_idx)
+{
+	pldm_fru_table_index *index = table->index;
+	size_t record_size = fru_table_record_size(table, record_idx);
+	table->record_checksums[record_idx] =
+	    crc32(table->data + index->records[record_idx].offset, record_size);
+
+	table->checksum = 0;
+	for (uint32_t i = 0; i < index->num_records; ++i) {
+		table->checksum =
+		    crc32_combine(table->checksum, table->record_checksums[i],
+				  fru_table_record_size(table, i));
+	}
+}
+
+int pldm_fru_table_set_field(pldm_fru_table *table, uint16_t record_set_id,
+			     uint8_t field_type, const uint8_t *value,
+			     uint8_t length)
+{
+	if (table == NULL || (value == NULL && length)) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	uint32_t record_idx;
+	uint32_t tlv_idx;
+	size_t offset;
+	if (!fru_table_find_field(table, record_set_id, field_type,
+				  &record_idx, &tlv_idx, &offset)) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	if (length == 0 || table->data[offset + 1] != length) {
+		fru_table_resize_field(table, record_idx, tlv_idx, offset,
+				       length);
+		if (length) {
+			memcpy(table->data + offset + fru_tlv_hdr_size, value,
+			       length);
+		}
+		if (record_idx != FRU_INDEX_NONE) {
+			fru_table_update_record_checksum(table, record_idx);
+		}
+		return PLDM_SUCCESS;
+	}
+
+	uint8_t *field = table->data + offset + fru_tlv_hdr_size;
+	if (record_idx == FRU_INDEX_NONE) {
+		memcpy(field, value, length);
+		return PLDM_SUCCESS;
+	}
+
+	/* The CRC of the new data is the CRC of the old data xor the CRC of
+	 * old ^ new, shifted by the bytes that follow. Only the changed bytes
+	 * are read.
+	 */
+	uint8_t delta[UINT8_MAX];
+	for (uint8_t i = 0; i < length; ++i) {
+		delta[i] = field[i] ^ value[i];
+	}
+	uint32_t delta_checksum = ~crc32_update(~0U, delta, length);
+	size_t end = offset + fru_tlv_hdr_size + length;
+	const struct fru_index_record *record =
+	    &table->index->records[record_idx];
+	table->record_checksums[record_idx] ^= crc32_combine(
+	    delta_checksum, 0,
+	    record->offset + fru_table_record_size(table, record_idx) - end);
+	table->checksum ^= crc32_combine(delta_checksum, 0,
+					 fru_table_indexed_end(table) - end);
+	memcpy(field, value, length);
+
+	return PLDM_SUCCESS;
+}
+
+const uint8_t *pldm_fru_table_get_data(const pldm_fru_table *table,
+				       size_t *size)
+{
+	assert(table != NULL);
+	assert(size != NULL);
+
+	*size = table->size;
+	return table->data;
+}
+
+void pldm_fru_table_set_maximum_size(pldm_fru_table *table,
+				     uint32_t maximum_size)
+{
+	assert(table != NULL);
+
+	table->maximum_size = maximum_size;
+}
+
+void pldm_fru_table_get_metadata(const pldm_fru_table *table,
+				 uint32_t *fru_table_maximum_size,
+				 uint32_t *fru_table_length,
+				 uint16_t *total_record_set_identifiers,
+				 uint16_t *total_table_records,
+				 uint32_t *checksum)
+{
+	assert(table != NULL);
+	assert(fru_table_maximum_size != NULL);
+	assert(fru_table_length != NULL);
+	assert(total_record_set_identifiers != NULL);
+	assert(total_table_records != NULL);
+	assert(checksum != NULL);
+
+	const pldm_fru_table_index *index = table->index;
+	*fru_table_maximum_size = table->maximum_size;
+	*fru_table_length = table->size + fru_table_pad_size(table->size);
+	*total_record_set_identifiers = index->num_rsis;
+	*total_table_records = index->num_records;
+	*checksum = fru_table_padded_checksum(table->checksum, table->size);
+	if (!table->has_last_record) {
+		return;
+	}
+
+	size_t record_size = table->size - table->last_record;
+	const struct pldm_fru_record_data_format *record =
+	    (const struct pldm_fru_record_data_format *)(table->data +
+							 table->last_record);
+	if (index->num_rsis == 0 ||
+	    fru_index_find_rsi(index->rsis, index->rsis_capacity,
+			       le16toh(record->record_set_id))
+		    ->first == FRU_INDEX_NONE) {
+		++*total_record_set_identifiers;
+	}
+	++*total_table_records;
+	*checksum = fru_table_padded_checksum(
+	    crc32_update(table->checksum, record, record_size), table->size);
+}
+
+int pldm_fru_table_transfer_init(struct pldm_fru_table_transfer *transfer,
+				 const uint8_t *table, size_t table_size,
+				 uint32_t checksum, uint32_t transfer_size)
+{
+	if (transfer == NULL || (table == NULL && table_size)) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+	if (table_size > UINT32_MAX ||
+	    transfer_size <= FRU_TABLE_MAX_PAD_SIZE + FRU_TABLE_CHECKSUM_SIZE) {
+		return PLDM_ERROR_INVALID_LENGTH;
+	}
+
+	transfer->table = table;
+	transfer->table_size = table_size;
+	transfer->transfer_size = transfer_size;
+	transfer->next_offset = 0;
+	transfer->in_progress = false;
 
-		len = sizeof(struct pldm_fru_record_data_format) -
-		      sizeof(struct pldm_fru_record_tlv);
+	/* The table is padded to a multiple of 4 bytes */
+	uint8_t pad_size = fru_table_pad_size(table_size);
+	memset(transfer->trailer, 0, pad_size);
+	checksum = htole32(checksum);
+	memcpy(transfer->trailer + pad_size, &checksum, sizeof(checksum));
+	transfer->trailer_size = pad_size + FRU_TABLE_CHECKSUM_SIZE;
 
-		assert(pos - record_table + len < *record_size);
-		memcpy(pos, record_data_src, len);
+	return PLDM_SUCCESS;
+}
 
-		record_data_dest = (struct pldm_fru_record_data_format *)pos;
-		pos += len;
+int pldm_fru_table_transfer_encode_resp(
+    struct pldm_fru_table_transfer *transfer, uint8_t instance_id,
+    const struct pldm_msg *request, size_t payload_length,
+    struct pldm_msg *msg, struct variable_field *data,
+    struct variable_field *trailer)
+{
+	if (transfer == NULL || msg == NULL || data == NULL ||
+	    trailer == NULL) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
 
-		tlv = record_data_src->tlvs;
-		count = 0;
-		for (int i = 0; i < record_data_src->num_fru_fields; i++) {
-			len = sizeof(*tlv) - 1 + tlv->length;
-			if (tlv->type == ft || ft == 0) {
-				assert(pos - record_table + len < *record_size);
-				memcpy(pos, tlv, len);
-				pos += len;
-				count++;
-			}
-			tlv = (const struct pldm_fru_record_tlv *)((char *)tlv +
-								   len);
+	data->ptr = NULL;
+	data->length = 0;
+	trailer->ptr = NULL;
+	trailer->length = 0;
+
+	uint32_t data_transfer_handle;
+	uint8_t transfer_operation_flag;
+	uint8_t completion_code =
+	    decode_get_fru_record_table_req(request, payload_length,
+					    &data_transfer_handle,
+					    &transfer_operation_flag);
+	if (completion_code == PLDM_SUCCESS) {
+		if (transfer_operation_flag == PLDM_GET_FIRSTPART) {
+			data_transfer_handle = 0;
+		} else if (transfer_operation_flag != PLDM_GET_NEXTPART) {
+			completion_code =
+			    PLDM_FRU_INVALID_TRANSFER_OPERATION_FLAG;
+		} else if (!transfer->in_progress ||
+			   data_transfer_handle != transfer->next_offset) {
+			completion_code = PLDM_FRU_INVALID_DATA_TRANSFER_HANDLE;
 		}
-		record_data_dest->num_fru_fields = count;
-		record_data_src =
-		    (const struct pldm_fru_record_data_format *)(tlv);
+	}
+	if (completion_code != PLDM_SUCCESS) {
+		return encode_get_fru_record_table_resp(
+		    instance_id, completion_code, 0, 0, msg);
 	}
 
-	*record_size = pos - record_table;
+	uint32_t offset = data_transfer_handle;
+	uint32_t remaining = transfer->table_size - offset;
+	uint32_t budget = transfer->transfer_size;
+	uint8_t transfer_flag;
+	uint32_t next_offset = 0;
+	data->ptr = transfer->table + offset;
+	if (remaining + transfer->trailer_size <= budget) {
+		transfer_flag = offset == 0 ? PLDM_START_AND_END : PLDM_END;
+		data->length = remaining;
+		trailer->ptr = transfer->trailer;
+		trailer->length = transfer->trailer_size;
+		transfer->in_progress = false;
+	} else {
+		transfer_flag = offset == 0 ? PLDM_START : PLDM_MIDDLE;
+		/* Leave at least a byte so that the last part has data */
+		data->length = remaining <= budget ? remaining - 1 : budget;
+		next_offset = offset + data->length;
+		transfer->next_offset = next_offset;
+		transfer->in_progress = true;
+	}
+
+	return encode_get_fru_record_table_resp(instance_id, PLDM_SUCCESS,
+						next_offset, transfer_flag, msg);
 }
 
 int encode_get_fru_record_by_option_req(
@@ -546,4 +1549,706 @@ int decode_set_fru_record_table_resp(const struct pldm_msg *msg,
 	*next_data_transfer_handle = le32toh(resp->next_data_transfer_handle);
 
 	return PLDM_SUCCESS;
-}
\ No newline at end of file
+}
+
+int decode_set_fru_record_table_req(const struct pldm_msg *msg,
+				    size_t payload_length,
+				    uint32_t *data_transfer_handle,
+				    uint8_t *transfer_flag,
+				    struct variable_field *fru_table_data)
+{
+	if (msg == NULL || data_transfer_handle == NULL ||
+	    transfer_flag == NULL || fru_table_data == NULL) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	if (payload_length <= sizeof(struct pldm_set_fru_record_table_req)) {
+		return PLDM_ERROR_INVALID_LENGTH;
+	}
+
+	struct pldm_set_fru_record_table_req *req =
+	    (struct pldm_set_fru_record_table_req *)msg->payload;
+
+	*data_transfer_handle = le32toh(req->data_transfer_handle);
+	*transfer_flag = req->transfer_flag;
+	fru_table_data->ptr =
+	    msg->payload + sizeof(struct pldm_set_fru_record_table_req);
+	fru_table_data->length =
+	    payload_length - sizeof(struct pldm_set_fru_record_table_req);
+
+	return PLDM_SUCCESS;
+}
+
+int encode_set_fru_record_table_resp(uint8_t instance_id,
+				     uint8_t completion_code,
+				     uint32_t next_data_transfer_handle,
+				     size_t payload_length, struct pldm_msg *msg)
+{
+	if (msg == NULL) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+	if (payload_length != sizeof(struct pldm_set_fru_record_table_resp)) {
+		return PLDM_ERROR_INVALID_LENGTH;
+	}
+
+	struct pldm_header_info header = {0};
+	header.instance = instance_id;
+	header.msg_type = PLDM_RESPONSE;
+	header.pldm_type = PLDM_FRU;
+	header.command = PLDM_SET_FRU_RECORD_TABLE;
+	int rc = pack_pldm_header(&header, &(msg->hdr));
+	if (rc != PLDM_SUCCESS) {
+		return rc;
+	}
+
+	struct pldm_set_fru_record_table_resp *resp =
+	    (struct pldm_set_fru_record_table_resp *)msg->payload;
+	resp->completion_code = completion_code;
+	resp->next_data_transfer_handle = htole32(next_data_transfer_handle);
+
+	return PLDM_SUCCESS;
+}
+
+typedef struct pldm_fru_table_receiver {
+	pldm_fru_table *table;
+	pldm_fru_table *staged; /* the table being received, if any */
+	size_t validated;	/* end of the record headers and fields seen */
+	size_t record;		/* offset of the record being validated */
+	uint32_t num_records;	/* completely validated */
+	uint32_t record_checksum; /* of the record's validated part */
+	uint8_t fields_left;	  /* in the record being validated */
+	bool in_record;
+} pldm_fru_table_receiver;
+
+pldm_fru_table_receiver *pldm_fru_table_receiver_init(pldm_fru_table *table)
+{
+	assert(table != NULL);
+
+	pldm_fru_table_receiver *receiver =
+	    calloc(1, sizeof(pldm_fru_table_receiver));
+	assert(receiver != NULL);
+	receiver->table = table;
+
+	return receiver;
+}
+
+static void fru_receiver_discard(pldm_fru_table_receiver *receiver)
+{
+	if (receiver->staged != NULL) {
+		pldm_fru_table_destroy(receiver->staged);
+		receiver->staged = NULL;
+	}
+}
+
+void pldm_fru_table_receiver_destroy(pldm_fru_table_receiver *receiver)
+{
+	assert(receiver != NULL);
+
+	fru_receiver_discard(receiver);
+	free(receiver);
+}
+
+/* Validate the record headers and fields that end before limit, folding
+ * each completed record into the staged table's checksum
+ */
+static void fru_receiver_validate(pldm_fru_table_receiver *receiver,
+				  size_t limit)
+{
+	pldm_fru_table *staged = receiver->staged;
+	const uint8_t *data = staged->data;
+	size_t pos = receiver->validated;
+
+	while (pos < limit) {
+		size_t len;
+		if (!receiver->in_record) {
+			if (limit - pos < fru_record_hdr_size) {
+				break;
+			}
+			len = fru_record_hdr_size;
+			receiver->record = pos;
+			receiver->record_checksum = 0;
+			receiver->fields_left =
+			    ((const struct pldm_fru_record_data_format *)(data +
+									  pos))
+				->num_fru_fields;
+			receiver->in_record = true;
+		} else {
+			if (limit - pos < fru_tlv_hdr_size ||
+			    limit - pos - fru_tlv_hdr_size < data[pos + 1]) {
+				break;
+			}
+			len = fru_tlv_hdr_size + data[pos + 1];
+			--receiver->fields_left;
+		}
+
+		receiver->record_checksum =
+		    crc32_update(receiver->record_checksum, data + pos, len);
+		pos += len;
+
+		if (receiver->fields_left == 0) {
+			fru_table_push_record_checksum(
+			    staged, receiver->num_records++,
+			    receiver->record_checksum, pos - receiver->record);
+			receiver->in_record = false;
+		}
+	}
+
+	receiver->validated = pos;
+}
+
+/* Strip the pad bytes and checksum off a completely received table, and
+ * check that it ends on a record boundary with the expected checksum
+ */
+static uint8_t fru_receiver_complete(pldm_fru_table_receiver *receiver)
+{
+	pldm_fru_table *staged = receiver->staged;
+	if (staged->size < FRU_TABLE_CHECKSUM_SIZE) {
+		return PLDM_ERROR_INVALID_LENGTH;
+	}
+	size_t end = staged->size - FRU_TABLE_CHECKSUM_SIZE;
+
+	/* Pad bytes are too short to be taken for a record header */
+	fru_receiver_validate(receiver, end);
+	size_t pad_size = fru_table_pad_size(receiver->validated);
+	if (receiver->in_record || receiver->validated + pad_size != end ||
+	    memcmp(staged->data + receiver->validated, fru_table_pad,
+		   pad_size) != 0) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	/* The checksum may or may not cover the pad bytes */
+	uint32_t checksum;
+	memcpy(&checksum, staged->data + end, sizeof(checksum));
+	checksum = le32toh(checksum);
+	if (checksum != staged->checksum &&
+	    checksum != crc32_update(staged->checksum,
+				     staged->data + receiver->validated,
+				     pad_size)) {
+		return PLDM_FRU_INVALID_DATA_INTEGRITY_CHECK;
+	}
+	if (receiver->validated > receiver->table->maximum_size) {
+		return PLDM_ERROR_INVALID_LENGTH;
+	}
+
+	staged->size = receiver->validated;
+	int rc =
+	    pldm_fru_table_index_update(staged->index, staged->data, staged->size);
+	assert(rc == PLDM_SUCCESS);
+	assert(staged->index->num_records == receiver->num_records);
+	(void)rc;
+
+	return PLDM_SUCCESS;
+}
+
+int pldm_fru_table_receiver_recv(pldm_fru_table_receiver *receiver,
+				 uint8_t instance_id,
+				 const struct pldm_msg *request,
+				 size_t payload_length, struct pldm_msg *msg)
+{
+	if (receiver == NULL || msg == NULL) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	uint32_t data_transfer_handle;
+	uint8_t transfer_flag;
+	struct variable_field data;
+	uint8_t completion_code = decode_set_fru_record_table_req(
+	    request, payload_length, &data_transfer_handle, &transfer_flag,
+	    &data);
+	if (completion_code == PLDM_SUCCESS) {
+		if (receiver->table->maximum_size == 0) {
+			completion_code = PLDM_ERROR_UNSUPPORTED_PLDM_CMD;
+		} else if (transfer_flag == PLDM_START ||
+			   transfer_flag == PLDM_START_AND_END) {
+			fru_receiver_discard(receiver);
+			receiver->staged = pldm_fru_table_init();
+			receiver->staged->maximum_size =
+			    receiver->table->maximum_size;
+			receiver->validated = 0;
+			receiver->num_records = 0;
+			receiver->in_record = false;
+		} else if (transfer_flag != PLDM_MIDDLE &&
+			   transfer_flag != PLDM_END) {
+			completion_code = PLDM_FRU_INVALID_TRANSFER_FLAG;
+		} else if (receiver->staged == NULL) {
+			completion_code = PLDM_FRU_INVALID_TRANSFER_FLAG;
+		} else if (data_transfer_handle != receiver->staged->size) {
+			completion_code = PLDM_FRU_INVALID_DATA_TRANSFER_HANDLE;
+		}
+	}
+	if (completion_code != PLDM_SUCCESS) {
+		fru_receiver_discard(receiver);
+		return encode_set_fru_record_table_resp(
+		    instance_id, completion_code, 0,
+		    sizeof(struct pldm_set_fru_record_table_resp), msg);
+	}
+
+	pldm_fru_table *staged = receiver->staged;
+	size_t trailer_size = FRU_TABLE_MAX_PAD_SIZE + FRU_TABLE_CHECKSUM_SIZE;
+	if (staged->size + data.length >
+	    (size_t)staged->maximum_size + trailer_size) {
+		fru_receiver_discard(receiver);
+		return encode_set_fru_record_table_resp(
+		    instance_id, PLDM_ERROR_INVALID_LENGTH, 0,
+		    sizeof(struct pldm_set_fru_record_table_resp), msg);
+	}
+	memcpy(fru_table_append(staged, data.length), data.ptr, data.length);
+
+	uint32_t next_data_transfer_handle = 0;
+	if (transfer_flag == PLDM_START || transfer_flag == PLDM_MIDDLE) {
+		/* The pad bytes and checksum may be in the last part already */
+		if (staged->size > trailer_size) {
+			fru_receiver_validate(receiver,
+					      staged->size - trailer_size);
+		}
+		next_data_transfer_handle = staged->size;
+	} else {
+		completion_code = fru_receiver_complete(receiver);
+		if (completion_code == PLDM_SUCCESS) {
+			pldm_fru_table swap = *receiver->table;
+			*receiver->table = *staged;
+			*staged = swap;
+		}
+		fru_receiver_discard(receiver);
+	}
+
+	return encode_set_fru_record_table_resp(
+	    instance_id, completion_code, next_data_transfer_handle,
+	    sizeof(struct pldm_set_fru_record_table_resp), msg);
+}
+
+/* Metadata as reported by GetFRURecordTableMetadata */
+struct fru_cache_metadata {
+	uint8_t fru_data_major_version;
+	uint8_t fru_data_minor_version;
+	uint32_t fru_table_maximum_size;
+	uint32_t fru_table_length;
+	uint16_t total_record_set_identifiers;
+	uint16_t total_table_records;
+	uint32_t checksum;
+};
+
+struct fru_cache_entry {
+	struct fru_cache_metadata metadata; /* last reported */
+	uint8_t *table;
+	size_t table_size;
+	uint32_t table_checksum;
+	pldm_fru_table_index *index;
+	bool has_metadata;
+	bool has_table;
+};
+
+typedef struct pldm_fru_cache {
+	struct fru_cache_entry entries[UINT8_MAX + 1]; /* by TID */
+} pldm_fru_cache;
+
+pldm_fru_cache *pldm_fru_cache_init()
+{
+	pldm_fru_cache *cache = calloc(1, sizeof(pldm_fru_cache));
+	assert(cache != NULL);
+
+	return cache;
+}
+
+void pldm_fru_cache_destroy(pldm_fru_cache *cache)
+{
+	assert(cache != NULL);
+
+	for (size_t i = 0; i <= UINT8_MAX; ++i) {
+		struct fru_cache_entry *entry = &cache->entries[i];
+		if (entry->index != NULL) {
+			pldm_fru_table_index_destroy(entry->index);
+		}
+		free(entry->table);
+	}
+	free(cache);
+}
+
+static bool fru_cache_is_current(const struct fru_cache_entry *entry)
+{
+	return entry->has_table && entry->has_metadata &&
+	       fru_table_matches(entry->table_checksum, entry->table_size,
+				 entry->metadata.checksum,
+				 entry->metadata.fru_table_length);
+}
+
+int pldm_fru_cache_update_metadata(pldm_fru_cache *cache, uint8_t tid,
+				   const struct pldm_msg *msg,
+				   size_t payload_length,
+				   uint8_t *completion_code, bool *needs_fetch)
+{
+	if (cache == NULL || needs_fetch == NULL) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	struct fru_cache_metadata metadata;
+	int rc = decode_get_fru_record_table_metadata_resp(
+	    msg, payload_length, completion_code,
+	    &metadata.fru_data_major_version, &metadata.fru_data_minor_version,
+	    &metadata.fru_table_maximum_size, &metadata.fru_table_length,
+	    &metadata.total_record_set_identifiers,
+	    &metadata.total_table_records, &metadata.checksum);
+	if (rc != PLDM_SUCCESS) {
+		return rc;
+	}
+
+	struct fru_cache_entry *entry = &cache->entries[tid];
+	if (*completion_code == PLDM_SUCCESS) {
+		entry->metadata = metadata;
+		entry->has_metadata = true;
+	}
+	*needs_fetch = entry->has_metadata && !fru_cache_is_current(entry);
+
+	return PLDM_SUCCESS;
+}
+
+int pldm_fru_cache_set_table(pldm_fru_cache *cache, uint8_t tid,
+			     const uint8_t *table, size_t table_size)
+{
+	if (cache == NULL || (table == NULL && table_size)) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	struct fru_cache_entry *entry = &cache->entries[tid];
+	uint32_t checksum = crc32(table, table_size);
+	if (entry->has_metadata &&
+	    !fru_table_matches(checksum, table_size, entry->metadata.checksum,
+			       entry->metadata.fru_table_length)) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	/* The whole table changed, so index it from scratch */
+	pldm_fru_table_index *index = pldm_fru_table_index_init();
+	int rc = pldm_fru_table_index_update(index, table, table_size);
+	if (rc != PLDM_SUCCESS) {
+		pldm_fru_table_index_destroy(index);
+		return rc;
+	}
+	if (entry->index != NULL) {
+		pldm_fru_table_index_destroy(entry->index);
+	}
+	entry->index = index;
+
+	uint8_t *copy = realloc(entry->table, table_size ? table_size : 1);
+	assert(copy != NULL);
+	if (table_size) {
+		memcpy(copy, table, table_size);
+	}
+	entry->table = copy;
+	entry->table_size = table_size;
+	entry->table_checksum = checksum;
+	entry->has_table = true;
+
+	return PLDM_SUCCESS;
+}
+
+const uint8_t *pldm_fru_cache_get_table(const pldm_fru_cache *cache,
+					uint8_t tid, size_t *table_size,
+					const pldm_fru_table_index **index)
+{
+	assert(cache != NULL);
+	assert(table_size != NULL);
+
+	const struct fru_cache_entry *entry = &cache->entries[tid];
+	if (!entry->has_table) {
+		return NULL;
+	}
+
+	*table_size = entry->table_size;
+	if (index != NULL) {
+		*index = entry->index;
+	}
+
+	return entry->table;
+}
+
+void pldm_fru_cache_invalidate(pldm_fru_cache *cache, uint8_t tid)
+{
+	assert(cache != NULL);
+
+	struct fru_cache_entry *entry = &cache->entries[tid];
+	free(entry->table);
+	entry->table = NULL;
+	entry->table_size = 0;
+	entry->has_table = false;
+	entry->has_metadata = false;
+	if (entry->index != NULL) {
+		fru_index_reset(entry->index);
+	}
+}
+
+struct fru_posting {
+	const uint8_t *tlv;
+	const uint8_t *record;
+	uint8_t tid;
+};
+
+struct fru_posting_list {
+	struct fru_posting *postings;
+	uint32_t num_postings;
+	uint32_t capacity;
+};
+
+typedef struct pldm_fru_query {
+	struct fru_posting_list lists[UINT8_MAX + 1]; /* by field type */
+} pldm_fru_query;
+
+pldm_fru_query *pldm_fru_query_init()
+{
+	pldm_fru_query *query = calloc(1, sizeof(pldm_fru_query));
+	assert(query != NULL);
+
+	return query;
+}
+
+void pldm_fru_query_destroy(pldm_fru_query *query)
+{
+	assert(query != NULL);
+
+	for (size_t i = 0; i <= UINT8_MAX; ++i) {
+		free(query->lists[i].postings);
+	}
+	free(query);
+}
+
+void pldm_fru_query_remove_table(pldm_fru_query *query, uint8_t tid)
+{
+	assert(query != NULL);
+
+	/* Compact each list in place, keeping the order of the rest */
+	for (size_t i = 0; i <= UINT8_MAX; ++i) {
+		struct fru_posting_list *list = &query->lists[i];
+		uint32_t kept = 0;
+		for (uint32_t j = 0; j < list->num_postings; ++j) {
+			if (list->postings[j].tid != tid) {
+				list->postings[kept++] = list->postings[j];
+			}
+		}
+		list->num_postings = kept;
+	}
+}
+
+int pldm_fru_query_add_table(pldm_fru_query *query, uint8_t tid,
+			     const uint8_t *table,
+			     const pldm_fru_table_index *index)
+{
+	if (query == NULL || index == NULL ||
+	    (table == NULL && index->num_records)) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	pldm_fru_query_remove_table(query, tid);
+
+	for (uint32_t i = 0; i < index->num_records; ++i) {
+		const struct fru_index_record *record = &index->records[i];
+		for (uint8_t j = 0; j < record->num_fru_fields; ++j) {
+			const uint8_t *tlv =
+			    table + index->tlv_offsets[record->first_tlv + j];
+			struct fru_posting_list *list = &query->lists[tlv[0]];
+			if (list->num_postings == list->capacity) {
+				list->capacity =
+				    list->capacity ? list->capacity * 2 : 16;
+				list->postings = realloc(
+				    list->postings,
+				    list->capacity * sizeof(struct fru_posting));
+				assert(list->postings != NULL);
+			}
+			struct fru_posting *posting =
+			    &list->postings[list->num_postings++];
+			posting->tlv = tlv;
+			posting->record = table + record->offset;
+			posting->tid = tid;
+		}
+	}
+
+	return PLDM_SUCCESS;
+}
+
+int pldm_fru_query_run(const pldm_fru_query *query, uint16_t rsi, uint8_t rt,
+		       uint8_t ft, struct pldm_fru_query_result *results,
+		       size_t max_results, size_t *num_results)
+{
+	if (query == NULL || num_results == NULL ||
+	    (results == NULL && max_results)) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	/* A field type of 0 matches the fields in all the lists */
+	size_t first_list = ft;
+	size_t last_list = ft ? ft : UINT8_MAX;
+	size_t count = 0;
+	for (size_t i = first_list; i <= last_list; ++i) {
+		const struct fru_posting_list *list = &query->lists[i];
+		for (uint32_t j = 0; j < list->num_postings; ++j) {
+			const struct fru_posting *posting = &list->postings[j];
+			const struct pldm_fru_record_data_format *record =
+			    (const struct pldm_fru_record_data_format *)
+				posting->record;
+			uint16_t record_set_id = le16toh(record->record_set_id);
+			if ((record_set_id != rsi && rsi != 0) ||
+			    (record->record_type != rt && rt != 0)) {
+				continue;
+			}
+
+			if (count < max_results) {
+				struct pldm_fru_query_result *result =
+				    &results[count];
+				result->tid = posting->tid;
+				result->record_set_id = record_set_id;
+				result->record_type = record->record_type;
+				result->field.type = posting->tlv[0];
+				result->field.length = posting->tlv[1];
+				result->field.value =
+				    posting->tlv + fru_tlv_hdr_size;
+			}
+			++count;
+		}
+	}
+	*num_results = count;
+
+	return PLDM_SUCCESS;
+}
+
+struct fru_diff_field {
+	uint64_t key; /* record set id, record type, field type, position */
+	uint32_t occurrence; /* among the fields of the same type in the set */
+	const uint8_t *tlv;
+};
+
+static int fru_diff_field_cmp(const void *a, const void *b)
+{
+	uint64_t key_a = ((const struct fru_diff_field *)a)->key;
+	uint64_t key_b = ((const struct fru_diff_field *)b)->key;
+
+	return (key_a > key_b) - (key_a < key_b);
+}
+
+/* The fields of a table sorted by record set id, record type and field
+ * type, then numbered by occurrence in table order
+ */
+static struct fru_diff_field *fru_diff_fields(const uint8_t *table,
+					      const pldm_fru_table_index *index)
+{
+	struct fru_diff_field *fields =
+	    malloc((index->num_tlvs ? index->num_tlvs : 1) * sizeof(*fields));
+	assert(fields != NULL);
+
+	uint32_t n = 0;
+	for (uint32_t i = 0; i < index->num_records; ++i) {
+		const struct fru_index_record *record = &index->records[i];
+		for (uint8_t j = 0; j < record->num_fru_fields; ++j, ++n) {
+			const uint8_t *tlv =
+			    table + index->tlv_offsets[record->first_tlv + j];
+			fields[n].key = (uint64_t)record->record_set_id << 48 |
+					(uint64_t)record->record_type << 40 |
+					(uint64_t)tlv[0] << 32 | n;
+			fields[n].tlv = tlv;
+		}
+	}
+	qsort(fields, n, sizeof(*fields), fru_diff_field_cmp);
+
+	for (uint32_t i = 0; i < n; ++i) {
+		fields[i].occurrence =
+		    i && fields[i - 1].key >> 32 == fields[i].key >> 32
+			? fields[i - 1].occurrence + 1
+			: 0;
+	}
+
+	return fields;
+}
+
+static void fru_diff_add_change(struct pldm_fru_field_change *change,
+				uint8_t kind, const struct fru_diff_field *field,
+				const uint8_t *old_tlv, const uint8_t *new_tlv)
+{
+	change->kind = kind;
+	change->record_set_id = field->key >> 48;
+	change->record_type = field->key >> 40;
+	change->field_type = field->key >> 32;
+	change->occurrence = field->occurrence;
+	memset(&change->old_field, 0, sizeof(change->old_field));
+	memset(&change->new_field, 0, sizeof(change->new_field));
+	if (old_tlv != NULL) {
+		change->old_field.type = old_tlv[0];
+		change->old_field.length = old_tlv[1];
+		change->old_field.value = old_tlv + fru_tlv_hdr_size;
+	}
+	if (new_tlv != NULL) {
+		change->new_field.type = new_tlv[0];
+		change->new_field.length = new_tlv[1];
+		change->new_field.value = new_tlv + fru_tlv_hdr_size;
+	}
+}
+
+int pldm_fru_table_diff(const uint8_t *old_table,
+			const pldm_fru_table_index *old_index,
+			const uint8_t *new_table,
+			const pldm_fru_table_index *new_index,
+			struct pldm_fru_field_change **changes,
+			size_t *num_changes)
+{
+	if (old_index == NULL || new_index == NULL || changes == NULL ||
+	    num_changes == NULL || (old_table == NULL && old_index->num_tlvs) ||
+	    (new_table == NULL && new_index->num_tlvs)) {
+		return PLDM_ERROR_INVALID_DATA;
+	}
+
+	struct fru_diff_field *old_fields =
+	    fru_diff_fields(old_table, old_index);
+	struct fru_diff_field *new_fields =
+	    fru_diff_fields(new_table, new_index);
+	size_t max_changes = old_index->num_tlvs + new_index->num_tlvs;
+	*changes = malloc((max_changes ? max_changes : 1) * sizeof(**changes));
+	assert(*changes != NULL);
+
+	/* Merge the sorted fields on their type and occurrence */
+	size_t n = 0;
+	uint32_t i = 0;
+	uint32_t j = 0;
+	while (i < old_index->num_tlvs || j < new_index->num_tlvs) {
+		const struct fru_diff_field *old_field =
+		    i < old_index->num_tlvs ? &old_fields[i] : NULL;
+		const struct fru_diff_field *new_field =
+		    j < new_index->num_tlvs ? &new_fields[j] : NULL;
+		int cmp = 0;
+		if (old_field == NULL) {
+			cmp = 1;
+		} else if (new_field == NULL) {
+			cmp = -1;
+		} else if (old_field->key >> 32 != new_field->key >> 32) {
+			cmp = old_field->key >> 32 < new_field->key >> 32 ? -1
+									  : 1;
+		} else if (old_field->occurrence != new_field->occurrence) {
+			cmp = old_field->occurrence < new_field->occurrence
+				  ? -1
+				  : 1;
+		}
+
+		if (cmp < 0) {
+			fru_diff_add_change(&(*changes)[n++],
+					    PLDM_FRU_FIELD_REMOVED, old_field,
+					    old_field->tlv, NULL);
+			++i;
+		} else if (cmp > 0) {
+			fru_diff_add_change(&(*changes)[n++],
+					    PLDM_FRU_FIELD_ADDED, new_field,
+					    NULL, new_field->tlv);
+			++j;
+		} else {
+			if (memcmp(old_field->tlv, new_field->tlv,
+				   fru_tlv_hdr_size + old_field->tlv[1])) {
+				fru_diff_add_change(
+				    &(*changes)[n++], PLDM_FRU_FIELD_MODIFIED,
+				    new_field, old_field->tlv, new_field->tlv);
+			}
+			++i;
+			++j;
+		}
+	}
+	*num_changes = n;
+
+	free(old_fields);
+	free(new_fields);
+
+	return PLDM_SUCCESS;
+}
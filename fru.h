@@ -18,9 +18,21 @@ extern "C" {
 #define PLDM_GET_FRU_RECORD_TABLE_MIN_RESP_BYTES 6
 #define PLDM_GET_FRU_RECORD_BY_OPTION_MIN_RESP_BYTES 6
 
+/* A FRU record table is sent as its records, 0 to 3 pad bytes of 0 up to a
+ * multiple of 4 bytes, and a CRC32 checksum. The checksum covers the records
+ * and the pad bytes, and FRUTableLength counts both, as OpenBMC's responder
+ * reports them. Tables whose checksum and length cover the records alone are
+ * accepted too.
+ */
 #define FRU_TABLE_CHECKSUM_SIZE 4
+#define FRU_TABLE_MAX_PAD_SIZE 3
 
 enum pldm_fru_completion_codes {
+	PLDM_FRU_INVALID_DATA_TRANSFER_HANDLE = 0x80,
+	PLDM_FRU_INVALID_TRANSFER_OPERATION_FLAG = 0x81,
+	PLDM_FRU_INVALID_TRANSFER_FLAG = 0x82,
+	PLDM_FRU_NO_FRU_DATA_STRUCTURE_TABLE_METADATA = 0x83,
+	PLDM_FRU_INVALID_DATA_INTEGRITY_CHECK = 0x84,
 	PLDM_FRU_DATA_STRUCTURE_TABLE_UNAVAILABLE = 0x85,
 };
 
@@ -79,8 +91,10 @@ struct pldm_get_fru_record_table_metadata_resp {
 	uint8_t completion_code;	//!< completion code
 	uint8_t fru_data_major_version; //!< The major version of the FRU Record
 	uint8_t fru_data_minor_version; //!< The minor version of the FRU Record
-	uint32_t
-	    fru_table_maximum_size; //!< The size of the largest FRU Record data
+	uint32_t fru_table_maximum_size; //!< The size of the largest FRU Record
+					 //!< Table accepted with
+					 //!< SetFRURecordTable, 0 if not
+					 //!< supported
 	uint32_t fru_table_length; //!< The total length of the FRU Record Table
 	uint16_t total_record_set_identifiers; //!< The total number of FRU
 					       //!< Record Data structures
@@ -188,7 +202,8 @@ int encode_get_fru_record_table_metadata_req(uint8_t instance_id,
  *  @param[out] completion_code - Pointer to response msg's PLDM completion code
  *  @param[out] fru_data_major_version - Major version of the FRU Record
  *  @param[out] fru_data_minor_version - Minor version of the FRU Record
- *  @param[out] fru_table_maximum_size - Size of the largest FRU Record data
+ *  @param[out] fru_table_maximum_size - Size of the largest FRU Record Table
+ * accepted with SetFRURecordTable, 0 if not supported
  *  @param[out] fru_table_length - Total length of the FRU Record Table
  *  @param[out] total_Record_Set_Identifiers - Total number of FRU Record Data
  * structures
@@ -213,7 +228,8 @@ int decode_get_fru_record_table_metadata_resp(
  *  @param[in] completion_code - PLDM completion code
  *  @param[in] fru_data_major_version - Major version of the FRU Record
  *  @param[in] fru_data_minor_version - Minor version of the FRU Record
- *  @param[in] fru_table_maximum_size - Size of the largest FRU Record data
+ *  @param[in] fru_table_maximum_size - Size of the largest FRU Record Table
+ * accepted with SetFRURecordTable, 0 if not supported
  *  @param[in] fru_table_length - Total length of the FRU Record Table
  *  @param[in] total_Record_Set_Identifiers - Total number of FRU Record Data
  * structures
@@ -429,10 +445,98 @@ int decode_get_fru_record_by_option_resp(
  *  @param[in] rsi - FRU record set identifier
  *  @param[in] rt - FRU record type
  *  @param[in] ft - FRU field type
+ *  @return PLDM_SUCCESS, or PLDM_ERROR_INVALID_LENGTH with *record_size set
+ *          to 0 if a record of the source table runs past table_size
+ */
+int get_fru_record_by_option(const uint8_t *table, size_t table_size,
+			     uint8_t *record_table, size_t *record_size,
+			     uint16_t rsi, uint8_t rt, uint8_t ft);
+
+/** @struct pldm_fru_record_view
+ *
+ *  A FRU record of a table, with its header decoded and its fields left in
+ *  place
+ */
+struct pldm_fru_record_view {
+	uint16_t record_set_id;
+	uint8_t record_type;
+	uint8_t num_fru_fields;
+	uint8_t encoding_type;
+	const uint8_t *tlvs; //!< first field of the record
+};
+
+/** @struct pldm_fru_field_view
+ *
+ *  A FRU field of a record, pointing into the table
+ */
+struct pldm_fru_field_view {
+	uint8_t type;
+	uint8_t length;
+	const uint8_t *value;
+};
+
+/** @struct pldm_fru_record_iter
+ *
+ *  Iterator over the records of a FRU record table. The table must outlive
+ *  the iterator.
+ */
+struct pldm_fru_record_iter {
+	const uint8_t *pos;
+	const uint8_t *end;
+};
+
+/** @struct pldm_fru_field_iter
+ *
+ *  Iterator over the fields of a FRU record
+ */
+struct pldm_fru_field_iter {
+	const uint8_t *pos;
+	uint8_t remaining;
+};
+
+/** @brief Start iterating over the records of a FRU record table
+ *
+ *  The whole table is validated here, so that neither
+ *  pldm_fru_record_iter_next() nor pldm_fru_field_iter_next() needs further
+ *  bounds checks.
+ *
+ *  @param[out] iter - iterator to initialize
+ *  @param[in] table - FRU record table, without pad bytes or checksum
+ *  @param[in] table_size - size of the table in bytes
+ *
+ *  @return true if every record header and field of the table lies within
+ *          it, false otherwise
  */
-void get_fru_record_by_option(const uint8_t *table, size_t table_size,
-			      uint8_t *record_table, size_t *record_size,
-			      uint16_t rsi, uint8_t rt, uint8_t ft);
+bool pldm_fru_record_iter_init(struct pldm_fru_record_iter *iter,
+			       const uint8_t *table, size_t table_size);
+
+/** @brief Get the next record of a FRU record table
+ *
+ *  @param[in/out] iter - iterator set up by pldm_fru_record_iter_init()
+ *  @param[out] record - the next record
+ *
+ *  @return true if a record was found, false at the end of the table
+ */
+bool pldm_fru_record_iter_next(struct pldm_fru_record_iter *iter,
+			       struct pldm_fru_record_view *record);
+
+/** @brief Start iterating over the fields of a FRU record
+ *
+ *  @param[out] iter - iterator to initialize
+ *  @param[in] record - record from pldm_fru_record_iter_next()
+ */
+void pldm_fru_field_iter_init(struct pldm_fru_field_iter *iter,
+			      const struct pldm_fru_record_view *record);
+
+/** @brief Get the next field of a FRU record
+ *
+ *  @param[in/out] iter - iterator set up by pldm_fru_field_iter_init()
+ *  @param[out] field - the next field
+ *
+ *  @return true if a field was found, false after the last field
+ */
+bool pldm_fru_field_iter_next(struct pldm_fru_field_iter *iter,
+			      struct pldm_fru_field_view *field);
 
 /** Requester
  *
@@ -474,6 +578,556 @@ int decode_set_fru_record_table_resp(const struct pldm_msg *msg,
 				     uint8_t *completion_code,
 				     uint32_t *next_data_transfer_handle);
 
+/** @struct pldm_fru_table_index
+ *
+ *  opaque structure indexing the records and fields of a FRU record table by
+ *  offset, so that queries need not walk the whole table
+ */
+typedef struct pldm_fru_table_index pldm_fru_table_index;
+
+/** @brief Make a new, empty, FRU record table index
+ *
+ *  @return opaque pointer that acts as a handle to the index
+ */
+pldm_fru_table_index *pldm_fru_table_index_init();
+
+/** @brief Destroy a FRU record table index
+ *
+ *  @param[in] index - opaque pointer acting as a handle to the index
+ */
+void pldm_fru_table_index_destroy(pldm_fru_table_index *index);
+
+/** @brief Index the records of a FRU record table
+ *
+ *  Only the records past the end of the previous update are parsed, so this
+ *  is meant to be called each time records are appended to the table, e.g.
+ *  with encode_fru_record(). If the table got smaller than what was already
+ *  indexed, the whole table is indexed again. Any other change to already
+ *  indexed bytes requires a new index.
+ *
+ *  @param[in/out] index - opaque pointer acting as a handle to the index
+ *  @param[in] table - FRU record table
+ *  @param[in] table_size - Size of the FRU record table
+ *  @return PLDM_SUCCESS, or PLDM_ERROR_INVALID_LENGTH if the table ends with
+ *          a truncated record, which is left out of the index
+ */
+int pldm_fru_table_index_update(pldm_fru_table_index *index,
+				const uint8_t *table, size_t table_size);
+
+/** @brief Get the number of records indexed
+ *
+ *  @param[in] index - opaque pointer acting as a handle to the index
+ *  @return number of records indexed
+ */
+size_t pldm_fru_table_index_get_num_records(const pldm_fru_table_index *index);
+
+/** @brief Get the number of distinct FRU record set identifiers indexed
+ *
+ *  @param[in] index - opaque pointer acting as a handle to the index
+ *  @return number of record set identifiers
+ */
+size_t pldm_fru_table_index_get_num_rsis(const pldm_fru_table_index *index);
+
+/** @brief Get FRU Record Table By Option, using an index of the table
+ *
+ *  Equivalent to get_fru_record_by_option(), but only the records of the
+ *  requested record set are visited.
+ *
+ *  @param[in] index - index of the source fru record table
+ *  @param[in] table - The source fru record table, as indexed
+ *  @param[out] record_table - Fru table fetched based on the input option
+ *  @param[in/out] record_size - Size of record_table on input, size of the
+ *                 table fetched by fru record option on output
+ *  @param[in] rsi - FRU record set identifier
+ *  @param[in] rt - FRU record type
+ *  @param[in] ft - FRU field type
+ *  @return PLDM_SUCCESS, PLDM_ERROR_INVALID_DATA for NULL arguments or
+ *          PLDM_ERROR_INVALID_LENGTH if record_table is too small
+ */
+int pldm_fru_table_index_get_record_by_option(
+    const pldm_fru_table_index *index, const uint8_t *table,
+    uint8_t *record_table, size_t *record_size, uint16_t rsi, uint8_t rt,
+    uint8_t ft);
+
+/** @brief Encode a GetFRURecordByOption response straight from an indexed
+ *         FRU record table
+ *
+ *  The records and fields that match the options are written directly into
+ *  the response. When they do not all fit, the response is a part of a
+ *  multipart transfer that ends on a field boundary, and its next data
+ *  transfer handle is a cursor to the record and field to resume from. A
+ *  record header counts all the matching fields of the record, including
+ *  those sent in later parts.
+ *
+ *  @param[in] index - index of the FRU record table
+ *  @param[in] table - The FRU record table, as indexed
+ *  @param[in] instance_id - Message's instance id
+ *  @param[in] data_transfer_handle - Data transfer handle of the request
+ *  @param[in] transfer_op_flag - Transfer operation flag of the request
+ *  @param[in] rsi - FRU record set identifier, 0 for any
+ *  @param[in] rt - FRU record type, 0 for any
+ *  @param[in] ft - FRU field type, 0 for any
+ *  @param[in,out] msg - Message will be written to this
+ *  @param[in,out] payload_length - Space for the response payload on input,
+ *                 length of the response payload on output
+ *  @return PLDM_SUCCESS, with an error completion code in msg for an invalid
+ *          transfer operation flag or data transfer handle;
+ *          PLDM_ERROR_INVALID_DATA for NULL arguments, or
+ *          PLDM_ERROR_INVALID_LENGTH if not even a record header or a field
+ *          fits in the payload
+ */
+int pldm_fru_table_index_encode_record_by_option_resp(
+    const pldm_fru_table_index *index, const uint8_t *table,
+    uint8_t instance_id, uint32_t data_transfer_handle,
+    uint8_t transfer_op_flag, uint16_t rsi, uint8_t rt, uint8_t ft,
+    struct pldm_msg *msg, size_t *payload_length);
+
+/** @struct pldm_fru_table
+ *
+ *  opaque structure holding a FRU record table that grows as records and
+ *  fields are added, and that keeps the table metadata up to date
+ */
+typedef struct pldm_fru_table pldm_fru_table;
+
+/** @brief Make a new, empty, FRU record table
+ *
+ *  @return opaque pointer that acts as a handle to the table
+ */
+pldm_fru_table *pldm_fru_table_init();
+
+/** @brief Destroy a FRU record table
+ *
+ *  @param[in] table - opaque pointer acting as a handle to the table
+ */
+void pldm_fru_table_destroy(pldm_fru_table *table);
+
+/** @brief Append a record, without any fields yet, to a FRU record table
+ *
+ *  @param[in/out] table - opaque pointer acting as a handle to the table
+ *  @param[in] record_set_id - FRU record set identifier
+ *  @param[in] record_type - FRU record type
+ *  @param[in] encoding - Encoding type for FRU fields
+ *  @return pldm_completion_codes
+ */
+int pldm_fru_table_add_record(pldm_fru_table *table, uint16_t record_set_id,
+			      uint8_t record_type, uint8_t encoding);
+
+/** @brief Append a field to the last record of a FRU record table
+ *
+ *  @param[in/out] table - opaque pointer acting as a handle to the table
+ *  @param[in] type - FRU field type
+ *  @param[in] value - FRU field value
+ *  @param[in] length - Length of the FRU field value
+ *  @return PLDM_SUCCESS, or PLDM_ERROR_INVALID_DATA if there is no record yet,
+ *          the record already has 255 fields, or value is NULL
+ */
+int pldm_fru_table_add_field(pldm_fru_table *table, uint8_t type,
+			     const uint8_t *value, uint8_t length);
+
+/** @brief Set the value of a field of a FRU record table
+ *
+ *  The first field of the given type in the record set is changed. The
+ *  table checksum is updated from the changed bytes when the length of the
+ *  field stays the same, or else from the checksum of the changed record and
+ *  those kept for the other records.
+ *
+ *  @param[in/out] table - opaque pointer acting as a handle to the table
+ *  @param[in] record_set_id - FRU record set identifier
+ *  @param[in] field_type - FRU field type
+ *  @param[in] value - New FRU field value
+ *  @param[in] length - Length of the new FRU field value
+ *  @return PLDM_SUCCESS, or PLDM_ERROR_INVALID_DATA if there is no such
+ *          field or value is NULL
+ */
+int pldm_fru_table_set_field(pldm_fru_table *table, uint16_t record_set_id,
+			     uint8_t field_type, const uint8_t *value,
+			     uint8_t length);
+
+/** @brief Get the FRU record table data
+ *
+ *  @param[in] table - opaque pointer acting as a handle to the table
+ *  @param[out] size - Size of the FRU record table, without pad bytes or
+ *                     checksum
+ *  @return The FRU record table data, valid until the table is next changed
+ */
+const uint8_t *pldm_fru_table_get_data(const pldm_fru_table *table,
+				       size_t *size);
+
+/** @brief Set the size of the largest FRU record table accepted with
+ *         SetFRURecordTable, which is reported as the table's maximum size
+ *
+ *  @param[in/out] table - opaque pointer acting as a handle to the table
+ *  @param[in] maximum_size - Size of the largest FRU record table, without
+ *             pad bytes or checksum, or 0, the default, if SetFRURecordTable
+ *             is not supported
+ */
+void pldm_fru_table_set_maximum_size(pldm_fru_table *table,
+				     uint32_t maximum_size);
+
+/** @brief Get the metadata of a FRU record table, as reported by
+ *         GetFRURecordTableMetadata
+ *
+ *  The metadata is maintained as the table is built, so this does not walk
+ *  the table.
+ *
+ *  @param[in] table - opaque pointer acting as a handle to the table
+ *  @param[out] fru_table_maximum_size - Size of the largest FRU Record Table
+ *              accepted with SetFRURecordTable, 0 if not supported
+ *  @param[out] fru_table_length - Total length of the FRU Record Table, pad
+ *              bytes included
+ *  @param[out] total_record_set_identifiers - Total number of FRU Record Data
+ *              structures
+ *  @param[out] total_table_records - Total number of records in the table
+ *  @param[out] checksum - CRC32 of the FRU Record Table data and pad bytes
+ */
+void pldm_fru_table_get_metadata(const pldm_fru_table *table,
+				 uint32_t *fru_table_maximum_size,
+				 uint32_t *fru_table_length,
+				 uint16_t *total_record_set_identifiers,
+				 uint16_t *total_table_records,
+				 uint32_t *checksum);
+
+/** @struct pldm_fru_table_transfer
+ *
+ *  State of a multipart GetFRURecordTable transfer of a FRU record table.
+ *  The data transfer handle of a part is the offset of its first byte in the
+ *  table.
+ */
+struct pldm_fru_table_transfer {
+	const uint8_t *table;
+	uint32_t table_size;
+	uint32_t transfer_size; //!< FRU record table data bytes per part
+	uint32_t next_offset;	//!< of the next part, if one was sent
+	bool in_progress;
+	uint8_t trailer_size;
+	uint8_t trailer[FRU_TABLE_MAX_PAD_SIZE + FRU_TABLE_CHECKSUM_SIZE];
+};
+
+/** @brief Start serving a FRU record table with GetFRURecordTable
+ *
+ *  @param[out] transfer - transfer state to initialize
+ *  @param[in] table - FRU record table, not copied, which must outlive the
+ *             transfer and not change during it
+ *  @param[in] table_size - Size of the FRU record table
+ *  @param[in] checksum - CRC32 of the FRU record table and pad bytes, as
+ *             reported by GetFRURecordTableMetadata
+ *  @param[in] transfer_size - Maximum number of FRU record table data bytes,
+ *             pad bytes and checksum included, in a response. Must be larger
+ *             than FRU_TABLE_MAX_PAD_SIZE + FRU_TABLE_CHECKSUM_SIZE.
+ *  @return pldm_completion_codes
+ */
+int pldm_fru_table_transfer_init(struct pldm_fru_table_transfer *transfer,
+				 const uint8_t *table, size_t table_size,
+				 uint32_t checksum, uint32_t transfer_size);
+
+/** @brief Respond to a GetFRURecordTable request with the next part of a
+ *         transfer
+ *
+ *  The response is returned in up to three pieces to be sent one after the
+ *  other, so that the table is never copied: msg holds the PLDM header and
+ *  the fixed response fields, data points into the table, and trailer holds
+ *  the pad bytes and checksum of the last part. A request that is invalid,
+ *  or that asks for a part other than the first one or the next one, gets an
+ *  error completion code and empty data and trailer.
+ *
+ *  @param[in/out] transfer - transfer state
+ *  @param[in] instance_id - Message's instance id
+ *  @param[in] request - GetFRURecordTable request message
+ *  @param[in] payload_length - Length of the request payload
+ *  @param[out] msg - Message header and fixed response fields, of
+ *              PLDM_GET_FRU_RECORD_TABLE_MIN_RESP_BYTES payload bytes, or
+ *              only the completion code if it is not PLDM_SUCCESS
+ *  @param[out] data - Portion of the FRU record table in the response
+ *  @param[out] trailer - Pad bytes and checksum in the response
+ *  @return pldm_completion_codes
+ */
+int pldm_fru_table_transfer_encode_resp(
+    struct pldm_fru_table_transfer *transfer, uint8_t instance_id,
+    const struct pldm_msg *request, size_t payload_length,
+    struct pldm_msg *msg, struct variable_field *data,
+    struct variable_field *trailer);
+
+/** @brief Decode a SetFRURecordTable request
+ *
+ *  @param[in] msg - Request message
+ *  @param[in] payload_length - Length of request message payload
+ *  @param[out] data_transfer_handle - A handle, used to identify a FRU Record
+ *              Table data transfer
+ *  @param[out] transfer_flag - The transfer flag that indicates what part of
+ *              the transfer this request represents
+ *  @param[out] fru_table_data - Portion of the FRU record table, pointing
+ *              into msg
+ *  @return pldm_completion_codes
+ */
+int decode_set_fru_record_table_req(const struct pldm_msg *msg,
+				    size_t payload_length,
+				    uint32_t *data_transfer_handle,
+				    uint8_t *transfer_flag,
+				    struct variable_field *fru_table_data);
+
+/** @brief Create a PLDM response message for SetFRURecordTable
+ *
+ *  @param[in] instance_id - Message's instance id
+ *  @param[in] completion_code - PLDM completion code
+ *  @param[in] next_data_transfer_handle - A handle used to identify the next
+ *             portion of the transfer
+ *  @param[in] payload_length - Length of response message payload
+ *  @param[out] msg - Message will be written to this
+ *  @return pldm_completion_codes
+ */
+int encode_set_fru_record_table_resp(uint8_t instance_id,
+				     uint8_t completion_code,
+				     uint32_t next_data_transfer_handle,
+				     size_t payload_length,
+				     struct pldm_msg *msg);
+
+/** @struct pldm_fru_table_receiver
+ *
+ *  opaque structure reassembling a FRU record table sent with SetFRURecordTable
+ */
+typedef struct pldm_fru_table_receiver pldm_fru_table_receiver;
+
+/** @brief Make a new receiver of FRU record tables
+ *
+ *  @param[in] table - Table to replace with each table received, whose
+ *             maximum size bounds the tables accepted
+ *  @return opaque pointer that acts as a handle to the receiver
+ */
+pldm_fru_table_receiver *pldm_fru_table_receiver_init(pldm_fru_table *table);
+
+/** @brief Destroy a receiver, discarding any partly received table
+ *
+ *  @param[in] receiver - opaque pointer acting as a handle to the receiver
+ */
+void pldm_fru_table_receiver_destroy(pldm_fru_table_receiver *receiver);
+
+/** @brief Receive a part of a FRU record table and respond to it
+ *
+ *  Parts are appended to a staged table whose records and fields are
+ *  validated, and checksummed, as they arrive. Once the last part is in, the
+ *  pad bytes and checksum are checked and the staged table, indexed, takes
+ *  the place of the receiver's table in one step. A table that fails
+ *  validation leaves the receiver's table untouched. The next data transfer
+ *  handle is the number of bytes received so far.
+ *
+ *  @param[in/out] receiver - opaque pointer acting as a handle to the
+ *                 receiver
+ *  @param[in] instance_id - Message's instance id
+ *  @param[in] request - SetFRURecordTable request message
+ *  @param[in] payload_length - Length of the request payload
+ *  @param[out] msg - Response message, of
+ *              sizeof(struct pldm_set_fru_record_table_resp) payload bytes.
+ *              Its completion code is PLDM_FRU_INVALID_TRANSFER_FLAG or
+ *              PLDM_FRU_INVALID_DATA_TRANSFER_HANDLE for a part out of
+ *              sequence, PLDM_ERROR_INVALID_DATA for a table that does not
+ *              end on a record boundary or has nonzero pad bytes,
+ *              PLDM_FRU_INVALID_DATA_INTEGRITY_CHECK for a checksum mismatch,
+ *              PLDM_ERROR_INVALID_LENGTH for a table larger than the maximum
+ *              size of the receiver's table, and
+ *              PLDM_ERROR_UNSUPPORTED_PLDM_CMD if that maximum size is 0.
+ *  @return pldm_completion_codes
+ */
+int pldm_fru_table_receiver_recv(pldm_fru_table_receiver *receiver,
+				 uint8_t instance_id,
+				 const struct pldm_msg *request,
+				 size_t payload_length, struct pldm_msg *msg);
+
+/** @struct pldm_fru_cache
+ *
+ *  opaque structure caching the FRU record table of each remote terminus,
+ *  with the metadata it last reported, so that a table is fetched again only
+ *  when its metadata says it changed
+ */
+typedef struct pldm_fru_cache pldm_fru_cache;
+
+/** @brief Make a new, empty, FRU record table cache
+ *
+ *  @return opaque pointer that acts as a handle to the cache
+ */
+pldm_fru_cache *pldm_fru_cache_init();
+
+/** @brief Destroy a FRU record table cache, and free the tables it holds
+ *
+ *  @param[in] cache - opaque pointer acting as a handle to the cache
+ */
+void pldm_fru_cache_destroy(pldm_fru_cache *cache);
+
+/** @brief Record the GetFRURecordTableMetadata response of a terminus
+ *
+ *  @param[in/out] cache - opaque pointer acting as a handle to the cache
+ *  @param[in] tid - Terminus ID
+ *  @param[in] msg - GetFRURecordTableMetadata response message
+ *  @param[in] payload_length - Length of response message payload
+ *  @param[out] completion_code - PLDM completion code of the response. The
+ *              metadata is only recorded if it is PLDM_SUCCESS.
+ *  @param[out] needs_fetch - true if the cached table, if any, does not
+ *              match the checksum and length of the last reported metadata
+ *  @return pldm_completion_codes
+ */
+int pldm_fru_cache_update_metadata(pldm_fru_cache *cache, uint8_t tid,
+				   const struct pldm_msg *msg,
+				   size_t payload_length,
+				   uint8_t *completion_code, bool *needs_fetch);
+
+/** @brief Store the FRU record table fetched from a terminus
+ *
+ *  The table is copied and indexed.
+ *
+ *  @param[in/out] cache - opaque pointer acting as a handle to the cache
+ *  @param[in] tid - Terminus ID
+ *  @param[in] table - FRU record table, without pad bytes or checksum
+ *  @param[in] table_size - Size of the FRU record table
+ *  @return PLDM_SUCCESS, PLDM_ERROR_INVALID_DATA if the table does not match
+ *          the checksum and length of the last reported metadata, or
+ *          PLDM_ERROR_INVALID_LENGTH if it ends with a truncated record. The
+ *          cached table is kept on error.
+ */
+int pldm_fru_cache_set_table(pldm_fru_cache *cache, uint8_t tid,
+			     const uint8_t *table, size_t table_size);
+
+/** @brief Get the cached FRU record table of a terminus
+ *
+ *  @param[in] cache - opaque pointer acting as a handle to the cache
+ *  @param[in] tid - Terminus ID
+ *  @param[out] table_size - Size of the FRU record table
+ *  @param[out] index - If not NULL, index of the FRU record table
+ *  @return the FRU record table, or NULL if none is cached for the terminus.
+ *          It is valid until the next change to the terminus's entry.
+ */
+const uint8_t *pldm_fru_cache_get_table(const pldm_fru_cache *cache,
+					uint8_t tid, size_t *table_size,
+					const pldm_fru_table_index **index);
+
+/** @brief Forget the FRU record table and metadata of a terminus, e.g. when
+ *         it goes away
+ *
+ *  @param[in/out] cache - opaque pointer acting as a handle to the cache
+ *  @param[in] tid - Terminus ID
+ */
+void pldm_fru_cache_invalidate(pldm_fru_cache *cache, uint8_t tid);
+
+/** @struct pldm_fru_query
+ *
+ *  opaque structure answering field queries over many indexed FRU record
+ *  tables, with a posting list of the fields of each field type so that a
+ *  query for one field type only visits the fields of that type
+ */
+typedef struct pldm_fru_query pldm_fru_query;
+
+/** @struct pldm_fru_query_result
+ *
+ *  A field matching a query, pointing into its table
+ */
+struct pldm_fru_query_result {
+	uint8_t tid;
+	uint16_t record_set_id;
+	uint8_t record_type;
+	struct pldm_fru_field_view field;
+};
+
+/** @brief Make a new query engine, over no tables
+ *
+ *  @return opaque pointer that acts as a handle to the query engine
+ */
+pldm_fru_query *pldm_fru_query_init();
+
+/** @brief Destroy a query engine
+ *
+ *  @param[in] query - opaque pointer acting as a handle to the query engine
+ */
+void pldm_fru_query_destroy(pldm_fru_query *query);
+
+/** @brief Add the fields of an indexed FRU record table to a query engine,
+ *         replacing those of any table added before for the terminus
+ *
+ *  The query engine points into the table, which must not change until it is
+ *  replaced or removed. A table from pldm_fru_cache_get_table() has to be
+ *  added again after each pldm_fru_cache_set_table() for the terminus, and
+ *  removed before pldm_fru_cache_invalidate().
+ *
+ *  @param[in/out] query - opaque pointer acting as a handle to the query
+ *                 engine
+ *  @param[in] tid - Terminus ID reported for the fields of the table
+ *  @param[in] table - FRU record table
+ *  @param[in] index - Index of the FRU record table
+ *  @return pldm_completion_codes
+ */
+int pldm_fru_query_add_table(pldm_fru_query *query, uint8_t tid,
+			     const uint8_t *table,
+			     const pldm_fru_table_index *index);
+
+/** @brief Remove the fields of the table of a terminus from a query engine,
+ *         e.g. before the table is freed
+ *
+ *  @param[in/out] query - opaque pointer acting as a handle to the query
+ *                 engine
+ *  @param[in] tid - Terminus ID the table was added for
+ */
+void pldm_fru_query_remove_table(pldm_fru_query *query, uint8_t tid);
+
+/** @brief Find the fields matching a query
+ *
+ *  Fields are returned by field type, then in the order their tables were
+ *  added, then in table order.
+ *
+ *  @param[in] query - opaque pointer acting as a handle to the query engine
+ *  @param[in] rsi - FRU record set identifier, 0 for any
+ *  @param[in] rt - FRU record type, 0 for any
+ *  @param[in] ft - FRU field type, 0 for any
+ *  @param[out] results - Matching fields, up to max_results of them
+ *  @param[in] max_results - Size of results
+ *  @param[out] num_results - Number of matching fields, which may be more
+ *              than max_results
+ *  @return pldm_completion_codes
+ */
+int pldm_fru_query_run(const pldm_fru_query *query, uint16_t rsi, uint8_t rt,
+		       uint8_t ft, struct pldm_fru_query_result *results,
+		       size_t max_results, size_t *num_results);
+
+enum pldm_fru_field_change_kind {
+	PLDM_FRU_FIELD_ADDED,
+	PLDM_FRU_FIELD_REMOVED,
+	PLDM_FRU_FIELD_MODIFIED,
+};
+
+/** @struct pldm_fru_field_change
+ *
+ *  A field that differs between two FRU record tables. Fields are matched on
+ *  their record set identifier, record type and field type, and the
+ *  occurrence of that field type in the record set in table order.
+ */
+struct pldm_fru_field_change {
+	uint8_t kind; //!< enum pldm_fru_field_change_kind
+	uint16_t record_set_id;
+	uint8_t record_type;
+	uint8_t field_type;
+	uint32_t occurrence;
+	struct pldm_fru_field_view old_field; //!< zeroed if added
+	struct pldm_fru_field_view new_field; //!< zeroed if removed
+};
+
+/** @brief Find the fields that were added, removed or modified between two
+ *         indexed FRU record tables
+ *
+ *  Changes are ordered by record set identifier, record type, field type
+ *  and occurrence. Records without fields are not reported.
+ *
+ *  @param[in] old_table - FRU record table before the change
+ *  @param[in] old_index - Index of old_table
+ *  @param[in] new_table - FRU record table after the change
+ *  @param[in] new_index - Index of new_table
+ *  @param[out] changes - Changed fields, pointing into both tables. Caller
+ *              must free *changes
+ *  @param[out] num_changes - Number of changed fields
+ *  @return pldm_completion_codes
+ */
+int pldm_fru_table_diff(const uint8_t *old_table,
+			const pldm_fru_table_index *old_index,
+			const uint8_t *new_table,
+			const pldm_fru_table_index *new_index,
+			struct pldm_fru_field_change **changes,
+			size_t *num_changes);
+
 #ifdef __cplusplus
 }
 #endif
@@ -10,8 +10,18 @@ typedef struct pldm_pdr_record {
 	uint8_t *data;
 	struct pldm_pdr_record *next;
 	bool is_remote;
+	bool owns_data; /* false if data lives in the block */
+	struct pldm_pdr_block *block; /* NULL if the record was malloc'd alone */
 } pldm_pdr_record;
 
+/* A single allocation holding several records followed by their data, which
+ * is freed once the last of its records is removed.
+ */
+struct pldm_pdr_block {
+	uint32_t refcount;
+	pldm_pdr_record records[];
+};
+
 typedef struct pldm_pdr {
 	uint32_t record_count;
 	uint32_t size;
@@ -71,9 +81,11 @@ static pldm_pdr_record *make_new_record(const pldm_pdr *repo,
 	    record_handle == 0 ? get_new_record_handle(repo) : record_handle;
 	record->size = size;
 	record->is_remote = is_remote;
+	record->owns_data = true;
+	record->block = NULL;
+	record->data = malloc(size);
+	assert(record->data != NULL);
 	if (data != NULL) {
-		record->data = malloc(size);
-		assert(record->data != NULL);
 		memcpy(record->data, data, size);
 		/* If record handle is 0, that is an indication for this API to
 		 * compute a new handle. For that reason, the computed handle
@@ -105,6 +117,92 @@ uint32_t pldm_pdr_add(pldm_pdr *repo, const uint8_t *data, uint32_t size,
 	return record->record_handle;
 }
 
+static void free_record(pldm_pdr_record *record)
+{
+	if (record->owns_data) {
+		free(record->data);
+	}
+	record->data = NULL;
+	if (record->block == NULL) {
+		free(record);
+	} else if (--record->block->refcount == 0) {
+		free(record->block);
+	}
+}
+
+static pldm_pdr_record *find_record_by_handle(const pldm_pdr *repo,
+					      uint32_t record_handle,
+					      pldm_pdr_record **prev)
+{
+	pldm_pdr_record *before = NULL;
+	pldm_pdr_record *record = repo->first;
+	while (record != NULL) {
+		if (record->record_handle == record_handle) {
+			if (prev != NULL) {
+				*prev = before;
+			}
+			return record;
+		}
+		before = record;
+		record = record->next;
+	}
+
+	return NULL;
+}
+
+static void remove_record(pldm_pdr *repo, pldm_pdr_record *record,
+			  pldm_pdr_record *prev)
+{
+	if (repo->first == record) {
+		repo->first = record->next;
+	} else {
+		prev->next = record->next;
+	}
+	if (repo->last == record) {
+		repo->last = prev;
+	}
+	--repo->record_count;
+	repo->size -= record->size;
+	free_record(record);
+}
+
+/* Resize the data of an existing record for a new version of the PDR. The
+ * caller writes the new PDR into record->data, and then calls
+ * finish_record_update() to restore the record handle and bump the change
+ * number in the PDR header.
+ */
+static uint16_t start_record_update(pldm_pdr *repo, pldm_pdr_record *record,
+				    uint32_t size)
+{
+	assert(size >= sizeof(struct pldm_pdr_hdr));
+	struct pldm_pdr_hdr *hdr = (struct pldm_pdr_hdr *)record->data;
+	uint16_t record_change_num = le16toh(hdr->record_change_num);
+
+	if (record->owns_data) {
+		record->data = realloc(record->data, size);
+		assert(record->data != NULL);
+	} else {
+		uint8_t *data = malloc(size);
+		assert(data != NULL);
+		memcpy(data, record->data,
+		       record->size < size ? record->size : size);
+		record->data = data;
+		record->owns_data = true;
+	}
+	repo->size = repo->size - record->size + size;
+	record->size = size;
+
+	return record_change_num + 1;
+}
+
+static void finish_record_update(pldm_pdr_record *record,
+				 uint16_t record_change_num)
+{
+	struct pldm_pdr_hdr *hdr = (struct pldm_pdr_hdr *)record->data;
+	hdr->record_handle = htole32(record->record_handle);
+	hdr->record_change_num = htole16(record_change_num);
+}
+
 pldm_pdr *pldm_pdr_init()
 {
 	pldm_pdr *repo = malloc(sizeof(pldm_pdr));
@@ -124,11 +222,7 @@ void pldm_pdr_destroy(pldm_pdr *repo)
 	pldm_pdr_record *record = repo->first;
 	while (record != NULL) {
 		pldm_pdr_record *next = record->next;
-		if (record->data) {
-			free(record->data);
-			record->data = NULL;
-		}
-		free(record);
+		free_record(record);
 		record = next;
 	}
 	free(repo);
@@ -316,13 +410,32 @@ const pldm_pdr_record *pldm_pdr_fru_record_set_find_by_rsi(
 typedef struct pldm_entity_association_tree {
 	pldm_entity_node *root;
 	uint16_t last_used_container_id;
+	/* Parents whose association PDRs are out of date */
+	pldm_entity_node **dirty;
+	size_t num_dirty;
+	size_t dirty_capacity;
+	/* Association PDRs of deleted parents, yet to be removed */
+	uint32_t *stale_handles;
+	size_t num_stale_handles;
+	size_t stale_handles_capacity;
+	/* Repo the record handles of the nodes refer to, NULL if none yet */
+	const pldm_pdr *repo;
 } pldm_entity_association_tree;
 
 typedef struct pldm_entity_node {
 	pldm_entity entity;
+	pldm_entity_node *parent;
 	pldm_entity_node *first_child;
 	pldm_entity_node *next_sibling;
 	uint8_t association_type;
+	/* Bit (1 << association type) is set when the association PDR of that
+	 * type is out of date */
+	uint8_t dirty;
+	size_t dirty_index; /* in the tree's dirty parents, while dirty */
+	/* Handles of the association PDRs made by
+	 * pldm_entity_association_pdr_sync(), 0 if there is no such PDR */
+	uint32_t logical_pdr_handle;
+	uint32_t physical_pdr_handle;
 } pldm_entity_node;
 
 static inline uint16_t next_container_id(pldm_entity_association_tree *tree)
@@ -340,10 +453,61 @@ pldm_entity_association_tree *pldm_entity_association_tree_init()
 	assert(tree != NULL);
 	tree->root = NULL;
 	tree->last_used_container_id = 0;
+	tree->dirty = NULL;
+	tree->num_dirty = 0;
+	tree->dirty_capacity = 0;
+	tree->stale_handles = NULL;
+	tree->num_stale_handles = 0;
+	tree->stale_handles_capacity = 0;
+	tree->repo = NULL;
 
 	return tree;
 }
 
+static void init_node(pldm_entity_node *node, pldm_entity_node *parent,
+		      uint8_t association_type)
+{
+	node->parent = parent;
+	node->first_child = NULL;
+	node->next_sibling = NULL;
+	node->association_type = association_type;
+	node->dirty = 0;
+	node->logical_pdr_handle = 0;
+	node->physical_pdr_handle = 0;
+}
+
+static void mark_dirty(pldm_entity_association_tree *tree,
+		       pldm_entity_node *node, uint8_t association_type)
+{
+	if (node == NULL) {
+		return;
+	}
+	if (node->dirty) {
+		node->dirty |= 1 << association_type;
+		return;
+	}
+
+	if (tree->num_dirty == tree->dirty_capacity) {
+		tree->dirty_capacity =
+		    tree->dirty_capacity ? tree->dirty_capacity * 2 : 8;
+		tree->dirty = realloc(tree->dirty, tree->dirty_capacity *
+						       sizeof(pldm_entity_node *));
+		assert(tree->dirty != NULL);
+	}
+	node->dirty_index = tree->num_dirty;
+	tree->dirty[tree->num_dirty++] = node;
+	node->dirty = 1 << association_type;
+}
+
+static void unmark_dirty(pldm_entity_association_tree *tree,
+			 pldm_entity_node *node)
+{
+	pldm_entity_node *last = tree->dirty[--tree->num_dirty];
+	tree->dirty[node->dirty_index] = last;
+	last->dirty_index = node->dirty_index;
+	node->dirty = 0;
+}
+
 static pldm_entity_node *find_insertion_at(pldm_entity_node *start,
 					   uint16_t entity_type)
 {
@@ -375,11 +539,9 @@ pldm_entity_association_tree_add(pldm_entity_association_tree *tree,
 	       association_type == PLDM_ENTITY_ASSOCIAION_LOGICAL);
 	pldm_entity_node *node = malloc(sizeof(pldm_entity_node));
 	assert(node != NULL);
-	node->first_child = NULL;
-	node->next_sibling = NULL;
+	init_node(node, parent, association_type);
 	node->entity.entity_type = entity->entity_type;
 	node->entity.entity_instance_num = 1;
-	node->association_type = association_type;
 
 	if (tree->root == NULL) {
 		assert(parent == NULL);
@@ -408,6 +570,7 @@ pldm_entity_association_tree_add(pldm_entity_association_tree *tree,
 	}
 	entity->entity_instance_num = node->entity.entity_instance_num;
 	entity->entity_container_id = node->entity.entity_container_id;
+	mark_dirty(tree, parent, association_type);
 
 	return node;
 }
@@ -475,9 +638,157 @@ void pldm_entity_association_tree_destroy(pldm_entity_association_tree *tree)
 	assert(tree != NULL);
 
 	entity_association_tree_destroy(tree->root);
+	free(tree->dirty);
+	free(tree->stale_handles);
 	free(tree);
 }
 
+static void entity_association_tree_flatten(pldm_entity_node *node,
+					    uint16_t parent_index,
+					    pldm_entity_flat_node *nodes,
+					    size_t *index)
+{
+	while (node != NULL) {
+		uint16_t this_index = *index;
+		pldm_entity_flat_node *flat = &nodes[*index];
+		++(*index);
+		flat->entity.entity_type = htole16(node->entity.entity_type);
+		flat->entity.entity_instance_num =
+		    htole16(node->entity.entity_instance_num);
+		flat->entity.entity_container_id =
+		    htole16(node->entity.entity_container_id);
+		flat->parent_index = htole16(parent_index);
+		flat->association_type = node->association_type;
+
+		uint16_t num_children = 0;
+		pldm_entity_node *child = node->first_child;
+		while (child != NULL) {
+			++num_children;
+			child = child->next_sibling;
+		}
+		flat->num_children = htole16(num_children);
+
+		entity_association_tree_flatten(node->first_child, this_index,
+						nodes, index);
+		node = node->next_sibling;
+	}
+}
+
+bool pldm_entity_association_tree_flatten(pldm_entity_association_tree *tree,
+					  pldm_entity_flat_node **nodes,
+					  size_t *size)
+{
+	assert(tree != NULL);
+	assert(nodes != NULL);
+	assert(size != NULL);
+
+	*size = 0;
+	*nodes = NULL;
+	if (tree->root == NULL) {
+		return true;
+	}
+
+	get_num_nodes(tree->root, size);
+	if (*size >= PLDM_ENTITY_FLAT_NO_PARENT) {
+		*size = 0;
+		return false;
+	}
+
+	*nodes = malloc(*size * sizeof(pldm_entity_flat_node));
+	assert(*nodes != NULL);
+	size_t index = 0;
+	entity_association_tree_flatten(tree->root, PLDM_ENTITY_FLAT_NO_PARENT,
+					*nodes, &index);
+	assert(index == *size);
+
+	return true;
+}
+
+/* Read the next count subtrees of the preorder array into the child list of
+ * parent. At the top level count is the array size, and reading stops at the
+ * end of the array.
+ */
+static bool entity_association_tree_unflatten(
+    pldm_entity_association_tree *tree, const pldm_entity_flat_node *nodes,
+    size_t size, size_t *index, pldm_entity_node *parent,
+    uint16_t parent_index, size_t count)
+{
+	pldm_entity_node *prev = NULL;
+
+	for (size_t i = 0; i < count; ++i) {
+		if (*index >= size) {
+			return parent == NULL;
+		}
+
+		const pldm_entity_flat_node *flat = &nodes[*index];
+		if (le16toh(flat->parent_index) != parent_index ||
+		    (flat->association_type != PLDM_ENTITY_ASSOCIAION_PHYSICAL &&
+		     flat->association_type != PLDM_ENTITY_ASSOCIAION_LOGICAL)) {
+			return false;
+		}
+
+		pldm_entity_node *node = malloc(sizeof(pldm_entity_node));
+		assert(node != NULL);
+		init_node(node, parent, flat->association_type);
+		node->entity.entity_type = le16toh(flat->entity.entity_type);
+		node->entity.entity_instance_num =
+		    le16toh(flat->entity.entity_instance_num);
+		node->entity.entity_container_id =
+		    le16toh(flat->entity.entity_container_id);
+
+		if (prev != NULL) {
+			prev->next_sibling = node;
+		} else if (parent != NULL) {
+			parent->first_child = node;
+		} else {
+			tree->root = node;
+		}
+		prev = node;
+		mark_dirty(tree, parent, node->association_type);
+
+		if (node->entity.entity_container_id >
+		    tree->last_used_container_id) {
+			tree->last_used_container_id =
+			    node->entity.entity_container_id;
+		}
+
+		uint16_t this_index = *index;
+		++(*index);
+		if (!entity_association_tree_unflatten(
+			tree, nodes, size, index, node, this_index,
+			le16toh(flat->num_children))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+pldm_entity_association_tree *
+pldm_entity_association_tree_unflatten(const pldm_entity_flat_node *nodes,
+				       size_t size)
+{
+	if (size != 0 && nodes == NULL) {
+		return NULL;
+	}
+	if (size >= PLDM_ENTITY_FLAT_NO_PARENT) {
+		return NULL;
+	}
+
+	pldm_entity_association_tree *tree =
+	    pldm_entity_association_tree_init();
+	size_t index = 0;
+	if (!entity_association_tree_unflatten(tree, nodes, size, &index, NULL,
+					       PLDM_ENTITY_FLAT_NO_PARENT,
+					       size) ||
+	    index != size) {
+		pldm_entity_association_tree_destroy(tree);
+		return NULL;
+	}
+
+	return tree;
+}
+
 inline bool pldm_entity_is_node_parent(pldm_entity_node *node)
 {
 	assert(node != NULL);
@@ -505,13 +816,17 @@ uint8_t pldm_entity_get_num_children(pldm_entity_node *node,
 	return count;
 }
 
-static void _entity_association_pdr_add_entry(pldm_entity_node *curr,
-					      pldm_pdr *repo, uint16_t size,
-					      uint8_t contained_count,
-					      uint8_t association_type,
-					      bool is_remote)
+static inline uint16_t entity_association_pdr_size(uint8_t contained_count)
+{
+	return sizeof(struct pldm_pdr_hdr) + sizeof(uint16_t) +
+	       sizeof(uint8_t) + sizeof(pldm_entity) + sizeof(uint8_t) +
+	       (contained_count * sizeof(pldm_entity));
+}
+
+static void entity_association_pdr_fill(pldm_entity_node *curr, uint8_t *pdr,
+					uint16_t size, uint8_t contained_count,
+					uint8_t association_type)
 {
-	uint8_t pdr[size];
 	uint8_t *start = pdr;
 
 	struct pldm_pdr_hdr *hdr = (struct pldm_pdr_hdr *)start;
@@ -550,48 +865,115 @@ static void _entity_association_pdr_add_entry(pldm_entity_node *curr,
 		}
 		node = node->next_sibling;
 	}
+}
+
+static uint32_t _entity_association_pdr_add_entry(pldm_entity_node *curr,
+						  pldm_pdr *repo, uint16_t size,
+						  uint8_t contained_count,
+						  uint8_t association_type,
+						  bool is_remote)
+{
+	pldm_pdr_record *record =
+	    make_new_record(repo, NULL, size, 0, is_remote);
+	entity_association_pdr_fill(curr, record->data, size, contained_count,
+				    association_type);
+	struct pldm_pdr_hdr *hdr = (struct pldm_pdr_hdr *)record->data;
+	hdr->record_handle = htole32(record->record_handle);
+	add_record(repo, record);
 
-	pldm_pdr_add(repo, pdr, size, 0, is_remote);
+	return record->record_handle;
 }
 
-static void entity_association_pdr_add_entry(pldm_entity_node *curr,
-					     pldm_pdr *repo, bool is_remote)
+/* Count the entity association PDRs of a tree and their total size */
+static void entity_association_pdr_count(pldm_entity_node *curr,
+					 uint32_t *num_records, size_t *size)
 {
+	if (curr == NULL) {
+		return;
+	}
+
 	uint8_t num_logical_children =
 	    pldm_entity_get_num_children(curr, PLDM_ENTITY_ASSOCIAION_LOGICAL);
 	uint8_t num_physical_children =
 	    pldm_entity_get_num_children(curr, PLDM_ENTITY_ASSOCIAION_PHYSICAL);
-
 	if (num_logical_children) {
-		uint16_t logical_pdr_size =
-		    sizeof(struct pldm_pdr_hdr) + sizeof(uint16_t) +
-		    sizeof(uint8_t) + sizeof(pldm_entity) + sizeof(uint8_t) +
-		    (num_logical_children * sizeof(pldm_entity));
-		_entity_association_pdr_add_entry(
-		    curr, repo, logical_pdr_size, num_logical_children,
-		    PLDM_ENTITY_ASSOCIAION_LOGICAL, is_remote);
+		++*num_records;
+		*size += entity_association_pdr_size(num_logical_children);
 	}
-
 	if (num_physical_children) {
-		uint16_t physical_pdr_size =
-		    sizeof(struct pldm_pdr_hdr) + sizeof(uint16_t) +
-		    sizeof(uint8_t) + sizeof(pldm_entity) + sizeof(uint8_t) +
-		    (num_physical_children * sizeof(pldm_entity));
-		_entity_association_pdr_add_entry(
-		    curr, repo, physical_pdr_size, num_physical_children,
-		    PLDM_ENTITY_ASSOCIAION_PHYSICAL, is_remote);
+		++*num_records;
+		*size += entity_association_pdr_size(num_physical_children);
+	}
+	entity_association_pdr_count(curr->next_sibling, num_records, size);
+	entity_association_pdr_count(curr->first_child, num_records, size);
+}
+
+static void entity_association_pdr_add_block_entry(
+    pldm_entity_association_tree *tree, pldm_entity_node *curr,
+    pldm_pdr *repo, pldm_pdr_record **record, uint8_t **data,
+    uint8_t contained_count, uint8_t association_type, bool is_remote)
+{
+	uint16_t size = entity_association_pdr_size(contained_count);
+	entity_association_pdr_fill(curr, *data, size, contained_count,
+				    association_type);
+
+	pldm_pdr_record *new_record = *record;
+	new_record->record_handle = get_new_record_handle(repo);
+	new_record->size = size;
+	new_record->data = *data;
+	new_record->next = NULL;
+	new_record->is_remote = is_remote;
+	new_record->owns_data = false;
+	struct pldm_pdr_hdr *hdr = (struct pldm_pdr_hdr *)new_record->data;
+	hdr->record_handle = htole32(new_record->record_handle);
+	add_record(repo, new_record);
+
+	/* The PDR is up to date, and is the one the next sync updates */
+	if (association_type == PLDM_ENTITY_ASSOCIAION_LOGICAL) {
+		curr->logical_pdr_handle = new_record->record_handle;
+	} else {
+		curr->physical_pdr_handle = new_record->record_handle;
 	}
+	if (curr->dirty & (1 << association_type)) {
+		curr->dirty &= ~(1 << association_type);
+		if (!curr->dirty) {
+			unmark_dirty(tree, curr);
+		}
+	}
+
+	++*record;
+	*data += size;
 }
 
-static void entity_association_pdr_add(pldm_entity_node *curr, pldm_pdr *repo,
-				       bool is_remote)
+/* Same traversal as entity_association_pdr_count(), so that the records are
+ * written in the order they were counted
+ */
+static void entity_association_pdr_add_block(
+    pldm_entity_association_tree *tree, pldm_entity_node *curr,
+    pldm_pdr *repo, pldm_pdr_record **record, uint8_t **data, bool is_remote)
 {
 	if (curr == NULL) {
 		return;
 	}
-	entity_association_pdr_add_entry(curr, repo, is_remote);
-	entity_association_pdr_add(curr->next_sibling, repo, is_remote);
-	entity_association_pdr_add(curr->first_child, repo, is_remote);
+
+	uint8_t num_logical_children =
+	    pldm_entity_get_num_children(curr, PLDM_ENTITY_ASSOCIAION_LOGICAL);
+	uint8_t num_physical_children =
+	    pldm_entity_get_num_children(curr, PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+	if (num_logical_children) {
+		entity_association_pdr_add_block_entry(
+		    tree, curr, repo, record, data, num_logical_children,
+		    PLDM_ENTITY_ASSOCIAION_LOGICAL, is_remote);
+	}
+	if (num_physical_children) {
+		entity_association_pdr_add_block_entry(
+		    tree, curr, repo, record, data, num_physical_children,
+		    PLDM_ENTITY_ASSOCIAION_PHYSICAL, is_remote);
+	}
+	entity_association_pdr_add_block(tree, curr->next_sibling, repo,
+					 record, data, is_remote);
+	entity_association_pdr_add_block(tree, curr->first_child, repo, record,
+					 data, is_remote);
 }
 
 void pldm_entity_association_pdr_add(pldm_entity_association_tree *tree,
@@ -600,7 +982,199 @@ void pldm_entity_association_pdr_add(pldm_entity_association_tree *tree,
 	assert(tree != NULL);
 	assert(repo != NULL);
 
-	entity_association_pdr_add(tree->root, repo, is_remote);
+	uint32_t num_records = 0;
+	size_t size = 0;
+	entity_association_pdr_count(tree->root, &num_records, &size);
+	if (num_records == 0) {
+		return;
+	}
+
+	struct pldm_pdr_block *block =
+	    malloc(sizeof(struct pldm_pdr_block) +
+		   num_records * sizeof(pldm_pdr_record) + size);
+	assert(block != NULL);
+	block->refcount = num_records;
+	for (uint32_t i = 0; i < num_records; ++i) {
+		block->records[i].block = block;
+	}
+
+	pldm_pdr_record *record = block->records;
+	uint8_t *data = (uint8_t *)(block->records + num_records);
+	entity_association_pdr_add_block(tree, tree->root, repo, &record,
+					 &data, is_remote);
+	tree->repo = repo;
+	assert(record == block->records + num_records);
+}
+
+static void add_stale_handle(pldm_entity_association_tree *tree,
+			     uint32_t record_handle)
+{
+	if (tree->num_stale_handles == tree->stale_handles_capacity) {
+		tree->stale_handles_capacity =
+		    tree->stale_handles_capacity
+			? tree->stale_handles_capacity * 2
+			: 8;
+		tree->stale_handles =
+		    realloc(tree->stale_handles,
+			    tree->stale_handles_capacity * sizeof(uint32_t));
+		assert(tree->stale_handles != NULL);
+	}
+	tree->stale_handles[tree->num_stale_handles++] = record_handle;
+}
+
+static void entity_association_tree_delete_subtree(
+    pldm_entity_association_tree *tree, pldm_entity_node *node)
+{
+	pldm_entity_node *child = node->first_child;
+	while (child != NULL) {
+		pldm_entity_node *next = child->next_sibling;
+		entity_association_tree_delete_subtree(tree, child);
+		child = next;
+	}
+
+	if (node->logical_pdr_handle) {
+		add_stale_handle(tree, node->logical_pdr_handle);
+	}
+	if (node->physical_pdr_handle) {
+		add_stale_handle(tree, node->physical_pdr_handle);
+	}
+	if (node->dirty) {
+		unmark_dirty(tree, node);
+	}
+	free(node);
+}
+
+void pldm_entity_association_tree_delete_node(
+    pldm_entity_association_tree *tree, pldm_entity_node *node)
+{
+	assert(tree != NULL);
+	assert(node != NULL);
+
+	pldm_entity_node **link =
+	    node->parent != NULL ? &node->parent->first_child : &tree->root;
+	while (*link != node) {
+		assert(*link != NULL);
+		link = &(*link)->next_sibling;
+	}
+	*link = node->next_sibling;
+
+	mark_dirty(tree, node->parent, node->association_type);
+	entity_association_tree_delete_subtree(tree, node);
+}
+
+static void append_change(uint32_t **handles, size_t *num,
+			  uint32_t record_handle)
+{
+	/* Grow to the next power of two when the array is full */
+	if ((*num & (*num - 1)) == 0) {
+		*handles = realloc(*handles,
+				   (*num ? *num * 2 : 1) * sizeof(uint32_t));
+		assert(*handles != NULL);
+	}
+	(*handles)[(*num)++] = record_handle;
+}
+
+static void entity_association_pdr_sync_entry(
+    pldm_entity_association_tree *tree, pldm_entity_node *node,
+    uint8_t association_type, pldm_pdr *repo, bool is_remote,
+    struct pldm_entity_association_pdr_changes *changes)
+{
+	uint32_t *record_handle =
+	    association_type == PLDM_ENTITY_ASSOCIAION_LOGICAL
+		? &node->logical_pdr_handle
+		: &node->physical_pdr_handle;
+	uint8_t num_children =
+	    pldm_entity_get_num_children(node, association_type);
+
+	if (!num_children) {
+		if (*record_handle) {
+			add_stale_handle(tree, *record_handle);
+			*record_handle = 0;
+		}
+		return;
+	}
+
+	uint16_t size = entity_association_pdr_size(num_children);
+	pldm_pdr_record *record =
+	    *record_handle ? find_record_by_handle(repo, *record_handle, NULL)
+			   : NULL;
+	if (record != NULL) {
+		uint16_t record_change_num =
+		    start_record_update(repo, record, size);
+		entity_association_pdr_fill(node, record->data, size,
+					    num_children, association_type);
+		finish_record_update(record, record_change_num);
+		if (changes != NULL) {
+			append_change(&changes->modified, &changes->num_modified,
+				      *record_handle);
+		}
+		return;
+	}
+
+	*record_handle = _entity_association_pdr_add_entry(
+	    node, repo, size, num_children, association_type, is_remote);
+	if (changes != NULL) {
+		append_change(&changes->added, &changes->num_added,
+			      *record_handle);
+	}
+}
+
+void pldm_entity_association_pdr_sync(
+    pldm_entity_association_tree *tree, pldm_pdr *repo, bool is_remote,
+    struct pldm_entity_association_pdr_changes *changes)
+{
+	assert(tree != NULL);
+	assert(repo != NULL);
+
+	if (changes != NULL) {
+		memset(changes, 0, sizeof(*changes));
+	}
+	tree->repo = repo;
+
+	for (size_t i = 0; i < tree->num_dirty; ++i) {
+		pldm_entity_node *node = tree->dirty[i];
+		if (node->dirty & (1 << PLDM_ENTITY_ASSOCIAION_LOGICAL)) {
+			entity_association_pdr_sync_entry(
+			    tree, node, PLDM_ENTITY_ASSOCIAION_LOGICAL, repo,
+			    is_remote, changes);
+		}
+		if (node->dirty & (1 << PLDM_ENTITY_ASSOCIAION_PHYSICAL)) {
+			entity_association_pdr_sync_entry(
+			    tree, node, PLDM_ENTITY_ASSOCIAION_PHYSICAL, repo,
+			    is_remote, changes);
+		}
+		node->dirty = 0;
+	}
+	tree->num_dirty = 0;
+
+	/* Removals go last, so that new PDRs added above can't be given the
+	 * handle of a PDR removed in the same sync
+	 */
+	for (size_t i = 0; i < tree->num_stale_handles; ++i) {
+		pldm_pdr_record *prev = NULL;
+		pldm_pdr_record *record =
+		    find_record_by_handle(repo, tree->stale_handles[i], &prev);
+		if (record == NULL) {
+			continue;
+		}
+		remove_record(repo, record, prev);
+		if (changes != NULL) {
+			append_change(&changes->deleted, &changes->num_deleted,
+				      tree->stale_handles[i]);
+		}
+	}
+	tree->num_stale_handles = 0;
+}
+
+void pldm_entity_association_pdr_changes_free(
+    struct pldm_entity_association_pdr_changes *changes)
+{
+	assert(changes != NULL);
+
+	free(changes->added);
+	free(changes->modified);
+	free(changes->deleted);
+	memset(changes, 0, sizeof(*changes));
 }
 
 void pldm_pdr_remove_remote_pdrs(pldm_pdr *repo)
@@ -621,12 +1195,9 @@ void pldm_pdr_remove_remote_pdrs(pldm_pdr *repo)
 			if (repo->last == record) {
 				repo->last = prev;
 			}
-			if (record->data) {
-				free(record->data);
-			}
 			--repo->record_count;
 			repo->size -= record->size;
-			free(record);
+			free_record(record);
 			removed = true;
 		} else {
 			prev = record;
@@ -679,47 +1250,312 @@ pldm_entity_association_tree_find(pldm_entity_association_tree *tree,
 	return node;
 }
 
+/* Map of (entity type, instance number, container id) to tree node, with the
+ * bookkeeping needed to link nodes found in entity association PDRs. The map
+ * is sized up front and never rehashed, so entry pointers stay valid.
+ */
+struct entity_map_entry {
+	uint64_t key;
+	pldm_entity_node *node; /* NULL for a free slot */
+	pldm_entity_node *last_child;
+	bool linked;
+	bool existing; /* in the tree before the PDRs were added */
+};
+
+struct entity_map {
+	struct entity_map_entry *entries;
+	size_t mask;
+};
+
+static inline uint64_t entity_map_key(const pldm_entity *entity)
+{
+	return (uint64_t)entity->entity_type << 32 |
+	       (uint64_t)entity->entity_instance_num << 16 |
+	       entity->entity_container_id;
+}
+
+static struct entity_map_entry *entity_map_lookup(struct entity_map *map,
+						  const pldm_entity *entity)
+{
+	uint64_t key = entity_map_key(entity);
+	size_t i = (size_t)((key * 0x9e3779b97f4a7c15ULL) >> 32) & map->mask;
+	while (map->entries[i].node != NULL && map->entries[i].key != key) {
+		i = (i + 1) & map->mask;
+	}
+	map->entries[i].key = key;
+
+	return &map->entries[i];
+}
+
+static void entity_map_add_tree(struct entity_map *map, pldm_entity_node *node)
+{
+	while (node != NULL) {
+		struct entity_map_entry *entry =
+		    entity_map_lookup(map, &node->entity);
+		if (entry->node == NULL) {
+			entry->node = node;
+			entry->last_child = NULL;
+			entry->linked = true;
+			entry->existing = true;
+		}
+		entity_map_add_tree(map, node->first_child);
+		node = node->next_sibling;
+	}
+}
+
+static struct entity_map_entry *
+entity_map_get_node(struct entity_map *map, const pldm_entity *entity)
+{
+	struct entity_map_entry *entry = entity_map_lookup(map, entity);
+	if (entry->node == NULL) {
+		entry->node = malloc(sizeof(pldm_entity_node));
+		assert(entry->node != NULL);
+		init_node(entry->node, NULL, PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+		entry->node->entity = *entity;
+		entry->last_child = NULL;
+		entry->linked = false;
+		entry->existing = false;
+	}
+
+	return entry;
+}
+
+static void entity_map_append_child(struct entity_map_entry *parent,
+				    pldm_entity_node *child)
+{
+	pldm_entity_node *node = parent->node;
+	if (parent->last_child == NULL) {
+		parent->last_child = node->first_child;
+		while (parent->last_child != NULL &&
+		       parent->last_child->next_sibling != NULL) {
+			parent->last_child = parent->last_child->next_sibling;
+		}
+	}
+
+	if (parent->last_child == NULL) {
+		node->first_child = child;
+	} else {
+		parent->last_child->next_sibling = child;
+	}
+	parent->last_child = child;
+	child->parent = node;
+}
+
+static bool is_ancestor(const pldm_entity_node *node,
+			const pldm_entity_node *of)
+{
+	for (; of != NULL; of = of->parent) {
+		if (of == node) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool pldm_entity_association_pdr_iter_init(
+    struct pldm_entity_association_pdr_iter *iter, const uint8_t *pdr,
+    uint32_t pdr_len)
+{
+	assert(iter != NULL);
+	assert(pdr != NULL);
+
+	const struct pldm_pdr_hdr *hdr = (const struct pldm_pdr_hdr *)pdr;
+	if (pdr_len < sizeof(struct pldm_pdr_hdr) +
+			  sizeof(struct pldm_pdr_entity_association) ||
+	    hdr->type != PLDM_PDR_ENTITY_ASSOCIATION ||
+	    pdr_len < sizeof(struct pldm_pdr_hdr) + le16toh(hdr->length)) {
+		return false;
+	}
+
+	const struct pldm_pdr_entity_association *entity_association_pdr =
+	    (const struct pldm_pdr_entity_association
+		 *)(pdr + sizeof(struct pldm_pdr_hdr));
+	uint8_t num_children = entity_association_pdr->num_children;
+	if (num_children == 0 ||
+	    le16toh(hdr->length) !=
+		sizeof(struct pldm_pdr_entity_association) +
+		    sizeof(pldm_entity) * (num_children - 1)) {
+		return false;
+	}
+
+	iter->children = entity_association_pdr->children;
+	iter->num_children = num_children;
+	iter->next_child = 0;
+	iter->association_type = entity_association_pdr->association_type;
+	iter->container_id = le16toh(entity_association_pdr->container_id);
+	iter->container.entity_type =
+	    le16toh(entity_association_pdr->container.entity_type);
+	iter->container.entity_instance_num =
+	    le16toh(entity_association_pdr->container.entity_instance_num);
+	iter->container.entity_container_id =
+	    le16toh(entity_association_pdr->container.entity_container_id);
+	return true;
+}
+
+bool pldm_entity_association_pdr_iter_next(
+    struct pldm_entity_association_pdr_iter *iter, pldm_entity *entity)
+{
+	assert(iter != NULL);
+	assert(entity != NULL);
+
+	if (iter->next_child == iter->num_children) {
+		return false;
+	}
+
+	const pldm_entity *child = &iter->children[iter->next_child++];
+	entity->entity_type = le16toh(child->entity_type);
+	entity->entity_instance_num = le16toh(child->entity_instance_num);
+	entity->entity_container_id = le16toh(child->entity_container_id);
+	return true;
+}
+
+static bool entity_association_pdr_iter_init(
+    struct pldm_entity_association_pdr_iter *iter, const uint8_t *pdr,
+    uint32_t pdr_len)
+{
+	return pldm_entity_association_pdr_iter_init(iter, pdr, pdr_len) &&
+	       (iter->association_type == PLDM_ENTITY_ASSOCIAION_PHYSICAL ||
+		iter->association_type == PLDM_ENTITY_ASSOCIAION_LOGICAL);
+}
+
+bool pldm_entity_association_tree_add_pdrs(pldm_entity_association_tree *tree,
+					   const pldm_pdr *repo)
+{
+	assert(tree != NULL);
+	assert(repo != NULL);
+
+	bool valid = true;
+	uint8_t *data = NULL;
+	uint32_t size = 0;
+	struct pldm_entity_association_pdr_iter iter;
+
+	size_t num_entities = 0;
+	get_num_nodes(tree->root, &num_entities);
+	const pldm_pdr_record *record = NULL;
+	while ((record = pldm_pdr_find_record_by_type(
+		    repo, PLDM_PDR_ENTITY_ASSOCIATION, record, &data, &size)) !=
+	       NULL) {
+		if (entity_association_pdr_iter_init(&iter, data, size)) {
+			num_entities += iter.num_children + 1;
+		}
+	}
+
+	struct entity_map map;
+	size_t capacity = 16;
+	while (capacity < num_entities * 2) {
+		capacity *= 2;
+	}
+	map.entries = calloc(capacity, sizeof(struct entity_map_entry));
+	assert(map.entries != NULL);
+	map.mask = capacity - 1;
+	entity_map_add_tree(&map, tree->root);
+
+	/* The handles of another repo's PDRs mean nothing to the repo the tree
+	 * is synced with, and an existing container keeps its own handle: the
+	 * next sync then replaces its PDR, or adds one if it has none
+	 */
+	bool adopt_handles = tree->repo == NULL || tree->repo == repo;
+	if (adopt_handles) {
+		tree->repo = repo;
+	}
+
+	/* Link each child to its container */
+	record = NULL;
+	while ((record = pldm_pdr_find_record_by_type(
+		    repo, PLDM_PDR_ENTITY_ASSOCIATION, record, &data, &size)) !=
+	       NULL) {
+		if (!entity_association_pdr_iter_init(&iter, data, size)) {
+			valid = false;
+			continue;
+		}
+
+		struct entity_map_entry *parent =
+		    entity_map_get_node(&map, &iter.container);
+		if (iter.container_id > tree->last_used_container_id) {
+			tree->last_used_container_id = iter.container_id;
+		}
+
+		uint32_t *record_handle =
+		    iter.association_type == PLDM_ENTITY_ASSOCIAION_LOGICAL
+			? &parent->node->logical_pdr_handle
+			: &parent->node->physical_pdr_handle;
+		if (adopt_handles && !parent->existing && !*record_handle) {
+			*record_handle = pldm_pdr_get_record_handle(repo, record);
+		}
+
+		pldm_entity entity;
+		while (pldm_entity_association_pdr_iter_next(&iter, &entity)) {
+			struct entity_map_entry *child =
+			    entity_map_get_node(&map, &entity);
+			if (child->linked || child == parent ||
+			    (child->node->first_child != NULL &&
+			     is_ancestor(child->node, parent->node))) {
+				continue;
+			}
+			child->node->association_type = iter.association_type;
+			entity_map_append_child(parent, child->node);
+			child->linked = true;
+			if (parent->existing) {
+				mark_dirty(tree, parent->node,
+					   iter.association_type);
+			}
+		}
+	}
+
+	/* Containers that are nobody's children are at the top of the tree */
+	pldm_entity_node *last_root = tree->root;
+	while (last_root != NULL && last_root->next_sibling != NULL) {
+		last_root = last_root->next_sibling;
+	}
+	record = NULL;
+	while ((record = pldm_pdr_find_record_by_type(
+		    repo, PLDM_PDR_ENTITY_ASSOCIATION, record, &data, &size)) !=
+	       NULL) {
+		if (!entity_association_pdr_iter_init(&iter, data, size)) {
+			continue;
+		}
+
+		struct entity_map_entry *parent =
+		    entity_map_get_node(&map, &iter.container);
+		if (parent->linked) {
+			continue;
+		}
+		if (last_root == NULL) {
+			tree->root = parent->node;
+		} else {
+			last_root->next_sibling = parent->node;
+		}
+		last_root = parent->node;
+		parent->linked = true;
+	}
+
+	free(map.entries);
+	return valid;
+}
+
 void pldm_entity_association_pdr_extract(const uint8_t *pdr, uint16_t pdr_len,
 					 size_t *num_entities,
 					 pldm_entity **entities)
 {
 	assert(pdr != NULL);
-	assert(pdr_len >= sizeof(struct pldm_pdr_hdr) +
-			      sizeof(struct pldm_pdr_entity_association));
+	assert(num_entities != NULL);
+	assert(entities != NULL);
 
-	struct pldm_pdr_hdr *hdr = (struct pldm_pdr_hdr *)pdr;
-	assert(hdr->type == PLDM_PDR_ENTITY_ASSOCIATION);
+	struct pldm_entity_association_pdr_iter iter;
+	if (!pldm_entity_association_pdr_iter_init(&iter, pdr, pdr_len)) {
+		*num_entities = 0;
+		*entities = NULL;
+		return;
+	}
 
-	const uint8_t *start = (uint8_t *)pdr;
-	const uint8_t *end =
-	    start + sizeof(struct pldm_pdr_hdr) + le16toh(hdr->length);
-	start += sizeof(struct pldm_pdr_hdr);
-	struct pldm_pdr_entity_association *entity_association_pdr =
-	    (struct pldm_pdr_entity_association *)start;
-	*num_entities = entity_association_pdr->num_children + 1;
-	assert(*num_entities >= 2);
+	*num_entities = iter.num_children + 1;
 	*entities = malloc(sizeof(pldm_entity) * *num_entities);
 	assert(*entities != NULL);
-	assert(start + sizeof(struct pldm_pdr_entity_association) +
-		   sizeof(pldm_entity) * (*num_entities - 2) ==
-	       end);
-	(*entities)->entity_type =
-	    le16toh(entity_association_pdr->container.entity_type);
-	(*entities)->entity_instance_num =
-	    le16toh(entity_association_pdr->container.entity_instance_num);
-	(*entities)->entity_container_id =
-	    le16toh(entity_association_pdr->container.entity_container_id);
-	pldm_entity *curr_entity = entity_association_pdr->children;
-	size_t i = 1;
-	while (i < *num_entities) {
-		(*entities + i)->entity_type =
-		    le16toh(curr_entity->entity_type);
-		(*entities + i)->entity_instance_num =
-		    le16toh(curr_entity->entity_instance_num);
-		(*entities + i)->entity_container_id =
-		    le16toh(curr_entity->entity_container_id);
+	(*entities)[0] = iter.container;
+	pldm_entity *curr_entity = *entities + 1;
+	while (pldm_entity_association_pdr_iter_next(&iter, curr_entity)) {
 		++curr_entity;
-		++i;
 	}
 }
 
@@ -200,6 +200,23 @@ enum entity_association_containment_type {
 	PLDM_ENTITY_ASSOCIAION_LOGICAL = 0x1,
 };
 
+/** @brief parent_index of a flattened node that is at the top of the tree */
+#define PLDM_ENTITY_FLAT_NO_PARENT 0xFFFF
+
+/** @struct pldm_entity_flat_node
+ *
+ *  One node of a flattened entity association tree. A flattened tree is an
+ *  array of these in preorder (a node is followed by its subtrees). All fields
+ *  are little-endian, so the array can be persisted or mmap'd as is.
+ */
+typedef struct pldm_entity_flat_node {
+	pldm_entity entity;
+	uint16_t parent_index; //!< index of the parent in the array, or
+			       //!< PLDM_ENTITY_FLAT_NO_PARENT
+	uint8_t association_type;
+	uint16_t num_children; //!< number of logical and physical children
+} __attribute__((packed)) pldm_entity_flat_node;
+
 /** @struct pldm_entity_association_tree
  *  opaque structure that represents the entity association hierarchy
  */
@@ -250,6 +267,36 @@ void pldm_entity_association_tree_visit(pldm_entity_association_tree *tree,
  */
 void pldm_entity_association_tree_destroy(pldm_entity_association_tree *tree);
 
+/** @brief Flatten the entity association tree into a preorder array
+ *
+ *  @param[in] tree - opaque pointer acting as a handle to the tree
+ *  @param[out] nodes - pointer to list of pldm_entity_flat_node's. To be
+ *                      free()'d by the caller
+ *  @param[out] size - number of pldm_entity_flat_node's
+ *
+ *  @return bool true on success, false if the tree has too many nodes to be
+ *  addressed by parent_index
+ */
+bool pldm_entity_association_tree_flatten(pldm_entity_association_tree *tree,
+					  pldm_entity_flat_node **nodes,
+					  size_t *size);
+
+/** @brief Make an entity association tree from a flattened tree
+ *
+ *  Entities keep the instance numbers and container ids they were flattened
+ *  with.
+ *
+ *  @param[in] nodes - preorder array made by
+ *                     pldm_entity_association_tree_flatten()
+ *  @param[in] size - number of pldm_entity_flat_node's
+ *
+ *  @return opaque pointer that acts as a handle to the tree; NULL if the array
+ *  is not a valid flattened tree
+ */
+pldm_entity_association_tree *
+pldm_entity_association_tree_unflatten(const pldm_entity_flat_node *nodes,
+				       size_t size);
+
 /** @brief Check if input enity node is a parent
  *
  *  @param[in] node - opaque pointer acting as a handle to an entity node
@@ -260,13 +307,102 @@ bool pldm_entity_is_node_parent(pldm_entity_node *node);
 
 /** @brief Convert entity association tree to PDR
  *
- *  @param[in] tree - opaque pointer to entity association tree
+ *  The tree remembers the record handles of the PDRs, as
+ *  pldm_entity_association_pdr_sync() does, so that a later sync with the
+ *  same repo only touches the PDRs of the parents changed since.
+ *
+ *  @param[in/out] tree - opaque pointer to entity association tree
  *  @param[in] repo - PDR repo where entity association records should be added
  *  @param[in] is_remote - if true, then the PDR is not from this terminus
  */
 void pldm_entity_association_pdr_add(pldm_entity_association_tree *tree,
 				     pldm_pdr *repo, bool is_remote);
 
+/** @struct pldm_entity_association_pdr_changes
+ *
+ *  Record handles of the entity association PDRs changed by
+ *  pldm_entity_association_pdr_sync(), grouped the way pldmPDRRepositoryChgEvent
+ *  change records are (see encode_pldm_pdr_repository_chg_event_data())
+ */
+struct pldm_entity_association_pdr_changes {
+	uint32_t *added;
+	size_t num_added;
+	uint32_t *modified;
+	size_t num_modified;
+	uint32_t *deleted;
+	size_t num_deleted;
+};
+
+/** @brief Remove an entity, and all entities it contains, from the entity
+ *  association tree
+ *
+ *  @param[in] tree - opaque pointer acting as a handle to the tree
+ *  @param[in] node - node to be removed. node, and all nodes under it, are
+ *                    freed
+ */
+void pldm_entity_association_tree_delete_node(
+    pldm_entity_association_tree *tree, pldm_entity_node *node);
+
+/** @brief Bring the entity association PDRs in a repo up to date with the tree
+ *
+ *  Only the PDRs of parents whose children were added or deleted since the
+ *  previous sync are touched: a PDR is added for a new parent (or a new
+ *  association type under a parent), replaced in place - keeping its record
+ *  handle and bumping its record change number - when the children of a
+ *  parent change, and removed when a parent has no more children of that
+ *  association type.
+ *
+ *  @param[in/out] tree - opaque pointer to entity association tree
+ *  @param[in/out] repo - PDR repo holding the entity association records
+ *  @param[in] is_remote - if true, then the PDR is not from this terminus
+ *  @param[out] changes - if not NULL, the record handles that were added,
+ *                        modified and deleted. To be freed by the caller with
+ *                        pldm_entity_association_pdr_changes_free()
+ *
+ *  @note The tree remembers the record handles it synced or added with
+ *  pldm_entity_association_pdr_add(), so a tree should be synced with a single
+ *  repo. pldm_pdr_remove_remote_pdrs() renumbers the records of a repo, which
+ *  invalidates the remembered handles.
+ */
+void pldm_entity_association_pdr_sync(
+    pldm_entity_association_tree *tree, pldm_pdr *repo, bool is_remote,
+    struct pldm_entity_association_pdr_changes *changes);
+
+/** @brief Free the record handles reported by pldm_entity_association_pdr_sync()
+ *
+ *  @param[in/out] changes - changes to be freed, zeroed on return
+ */
+void pldm_entity_association_pdr_changes_free(
+    struct pldm_entity_association_pdr_changes *changes);
+
+/** @brief Add the entities described by the entity association PDRs in a repo
+ *         to a tree
+ *
+ *  The tree is built in a single pass over the PDRs, looking entities up by
+ *  type, instance number and container id, so the instance numbers and
+ *  container ids from the PDRs are kept as is. Entities that are not the
+ *  child of any other entity end up at the top of the tree. Entities already
+ *  in the tree are matched too, so PDRs from several termini can be merged
+ *  into one tree; an existing entity that gains children is synced by the
+ *  next pldm_entity_association_pdr_sync().
+ *
+ *  The record handles of the PDRs are remembered for the entities new to the
+ *  tree, unless the tree was synced with or built from another repo. PDRs
+ *  merged from another terminus's repo are thus never taken for PDRs of the
+ *  tree's own repo: a merged container gets a PDR of its own from the first
+ *  sync that touches it.
+ *
+ *  @param[in/out] tree - opaque pointer to entity association tree
+ *  @param[in] repo - PDR repo holding the entity association records
+ *
+ *  @return true if all the entity association PDRs were well formed, false if
+ *          some were skipped. An entity is linked to the first container it
+ *          was found in, later associations that would duplicate it or form a
+ *          cycle are skipped as well.
+ */
+bool pldm_entity_association_tree_add_pdrs(pldm_entity_association_tree *tree,
+					   const pldm_pdr *repo);
+
 /** @brief Get number of children of entity
  *
  *  @param[in] node - opaque pointer acting as a handle to an entity node
@@ -289,13 +425,59 @@ pldm_entity_node *
 pldm_entity_association_tree_find(pldm_entity_association_tree *tree,
 				  pldm_entity *entity);
 
+/** @struct pldm_entity_association_pdr_iter
+ *
+ *  Iterator over the children of an entity association PDR, decoding each
+ *  child from the PDR bytes as it is visited. The PDR must outlive the
+ *  iterator.
+ */
+struct pldm_entity_association_pdr_iter {
+	const pldm_entity *children; //!< children in the PDR, little-endian
+	uint8_t num_children;
+	uint8_t next_child;
+	uint8_t association_type;
+	uint16_t container_id; //!< container id of the children
+	pldm_entity container; //!< container entity, decoded
+};
+
+/** @brief Start iterating over the children of an entity association PDR
+ *
+ *  The PDR is validated here, so that
+ *  pldm_entity_association_pdr_iter_next() needs no further bounds checks.
+ *
+ *  @param[out] iter - iterator to initialize
+ *  @param[in] pdr - entity association PDR
+ *  @param[in] pdr_len - size of entity association PDR in bytes
+ *
+ *  @return true if the PDR is a well formed entity association PDR, false
+ *          otherwise
+ */
+bool pldm_entity_association_pdr_iter_init(
+    struct pldm_entity_association_pdr_iter *iter, const uint8_t *pdr,
+    uint32_t pdr_len);
+
+/** @brief Decode the next child of an entity association PDR
+ *
+ *  @param[in/out] iter - iterator set up by
+ *                        pldm_entity_association_pdr_iter_init()
+ *  @param[out] entity - the next child
+ *
+ *  @return true if a child was decoded, false once all children were visited
+ */
+bool pldm_entity_association_pdr_iter_next(
+    struct pldm_entity_association_pdr_iter *iter, pldm_entity *entity);
+
 /** @brief Extract entities from entity association PDR
  *
  *  @param[in] pdr - entity association PDR
  *  @param[in] pdr_len - size of entity association PDR in bytes
- *  @param[out] num_entities - number of entities found, including the container
- *  @param[out] entities - extracted entities, container is *entities[0]. Caller
- *              must free *entities
+ *  @param[out] num_entities - number of entities found, including the
+ *              container, 0 if the PDR is malformed
+ *  @param[out] entities - extracted entities, container is *entities[0], NULL
+ *              if the PDR is malformed. Caller must free *entities
+ *
+ *  @note pldm_entity_association_pdr_iter_init() visits the same entities
+ *  without allocating
  */
 void pldm_entity_association_pdr_extract(const uint8_t *pdr, uint16_t pdr_len,
 					 size_t *num_entities,
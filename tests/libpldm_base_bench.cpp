@@ -0,0 +1,261 @@
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "../base.h"
+
+#include <benchmark/benchmark.h>
+
+// Instance IDs of one terminus shared by all threads, as a daemon polling
+// sensors of one device would
+
+static pldm_instance_id_alloc* alloc;
+
+static void BM_InstanceIdAlloc(benchmark::State& state)
+{
+    if (state.thread_index() == 0)
+    {
+        alloc = pldm_instance_id_alloc_init(PLDM_INSTANCE_ID_EXPIRY_MS);
+    }
+    for (auto _ : state)
+    {
+        uint8_t id;
+        uint64_t token;
+        if (pldm_instance_id_acquire(alloc, 1, 1000, &id, &token) !=
+            PLDM_SUCCESS)
+        {
+            state.SkipWithError("instance ID not acquired");
+            break;
+        }
+        benchmark::DoNotOptimize(id);
+        pldm_instance_id_release(alloc, 1, id, token);
+    }
+    if (state.thread_index() == 0)
+    {
+        pldm_instance_id_alloc_destroy(alloc);
+    }
+}
+BENCHMARK(BM_InstanceIdAlloc)->ThreadRange(1, 16)->UseRealTime();
+
+// A mutex protected bitmap, for comparison
+
+static std::mutex mutex;
+static uint32_t bitmap;
+
+static void BM_InstanceIdMutex(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        uint8_t id;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            id = __builtin_ctz(~bitmap);
+            bitmap |= 1u << id;
+        }
+        benchmark::DoNotOptimize(id);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            bitmap &= ~(1u << id);
+        }
+    }
+}
+BENCHMARK(BM_InstanceIdMutex)->ThreadRange(1, 16)->UseRealTime();
+
+// Header codecs, through pldm_header_info and in one go
+
+static void BM_PackHeader(benchmark::State& state)
+{
+    pldm_msg_hdr hdr{};
+    uint8_t command = 0;
+    for (auto _ : state)
+    {
+        pldm_header_info info{};
+        info.msg_type = PLDM_REQUEST;
+        info.instance = command & PLDM_INSTANCE_ID_MASK;
+        info.pldm_type = PLDM_PLATFORM;
+        info.command = command++;
+        pack_pldm_header(&info, &hdr);
+        benchmark::DoNotOptimize(hdr);
+    }
+}
+BENCHMARK(BM_PackHeader);
+
+static void BM_PackHeaderFast(benchmark::State& state)
+{
+    pldm_msg_hdr hdr{};
+    uint8_t command = 0;
+    for (auto _ : state)
+    {
+        pack_pldm_header_fast(PLDM_REQUEST, command & PLDM_INSTANCE_ID_MASK,
+                              PLDM_PLATFORM, command, &hdr);
+        ++command;
+        benchmark::DoNotOptimize(hdr);
+    }
+}
+BENCHMARK(BM_PackHeaderFast);
+
+static void BM_UnpackHeader(benchmark::State& state)
+{
+    pldm_msg_hdr hdr{};
+    pack_pldm_header_fast(PLDM_RESPONSE, 3, PLDM_PLATFORM, 0x11, &hdr);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(hdr);
+        pldm_header_info info;
+        unpack_pldm_header(&hdr, &info);
+        benchmark::DoNotOptimize(info);
+    }
+}
+BENCHMARK(BM_UnpackHeader);
+
+static void BM_UnpackHeaderFast(benchmark::State& state)
+{
+    pldm_msg_hdr hdr{};
+    pack_pldm_header_fast(PLDM_RESPONSE, 3, PLDM_PLATFORM, 0x11, &hdr);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(hdr);
+        uint8_t msgType, instanceId, type, command;
+        unpack_pldm_header_fast(&hdr, &msgType, &instanceId, &type, &command);
+        benchmark::DoNotOptimize(msgType);
+        benchmark::DoNotOptimize(instanceId);
+        benchmark::DoNotOptimize(type);
+        benchmark::DoNotOptimize(command);
+    }
+}
+BENCHMARK(BM_UnpackHeaderFast);
+
+// Checking a batch of received event headers one by one, and at once
+
+static std::vector<pldm_msg_hdr> eventHeaders(size_t count)
+{
+    std::vector<pldm_msg_hdr> hdrs(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        pack_pldm_header_fast(PLDM_REQUEST, i & PLDM_INSTANCE_ID_MASK,
+                              PLDM_PLATFORM, 0x0a, &hdrs[i]);
+    }
+    return hdrs;
+}
+
+static void BM_ValidateHeaders(benchmark::State& state)
+{
+    auto hdrs = eventHeaders(state.range(0));
+    std::vector<uint8_t> valid(hdrs.size());
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < hdrs.size(); ++i)
+        {
+            pldm_header_info info;
+            unpack_pldm_header(&hdrs[i], &info);
+            valid[i] = !hdrs[i].reserved &&
+                       hdrs[i].header_ver == PLDM_CURRENT_VERSION &&
+                       !(info.msg_type == PLDM_RESPONSE && hdrs[i].datagram);
+        }
+        benchmark::DoNotOptimize(valid.data());
+    }
+    state.SetItemsProcessed(state.iterations() * hdrs.size());
+}
+BENCHMARK(BM_ValidateHeaders)->Arg(1024);
+
+static void BM_ValidateHeadersBatch(benchmark::State& state)
+{
+    auto hdrs = eventHeaders(state.range(0));
+    std::unique_ptr<bool[]> valid(new bool[hdrs.size()]);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(
+            validate_pldm_headers(hdrs.data(), hdrs.size(), valid.get()));
+    }
+    state.SetItemsProcessed(state.iterations() * hdrs.size());
+}
+BENCHMARK(BM_ValidateHeadersBatch)->Arg(1024);
+
+// GetPLDMCommands responses, encoded each time and copied from a template
+
+static void BM_EncodeGetCommandsResp(benchmark::State& state)
+{
+    std::array<bitfield8_t, PLDM_MAX_CMDS_PER_TYPE / 8> commands{};
+    commands[0].byte = 0x3e;
+    std::array<uint8_t, sizeof(pldm_msg_hdr) + PLDM_GET_COMMANDS_RESP_BYTES>
+        responseMsg{};
+    auto response = reinterpret_cast<pldm_msg*>(responseMsg.data());
+    uint8_t instanceId = 0;
+    for (auto _ : state)
+    {
+        encode_get_commands_resp(instanceId++ & PLDM_INSTANCE_ID_MASK,
+                                 PLDM_SUCCESS, commands.data(), response);
+        benchmark::DoNotOptimize(responseMsg);
+    }
+}
+BENCHMARK(BM_EncodeGetCommandsResp);
+
+static void BM_TemplateGetCommandsResp(benchmark::State& state)
+{
+    std::array<bitfield8_t, PLDM_MAX_CMDS_PER_TYPE / 8> commands{};
+    commands[0].byte = 0x3e;
+    std::array<uint8_t, sizeof(pldm_msg_hdr) + PLDM_GET_COMMANDS_RESP_BYTES>
+        responseMsg{};
+    auto response = reinterpret_cast<pldm_msg*>(responseMsg.data());
+    encode_get_commands_resp(0, PLDM_SUCCESS, commands.data(), response);
+    auto tmpl =
+        pldm_response_template_init(response, PLDM_GET_COMMANDS_RESP_BYTES);
+    uint8_t instanceId = 0;
+    for (auto _ : state)
+    {
+        size_t length = PLDM_GET_COMMANDS_RESP_BYTES;
+        pldm_response_template_encode(
+            tmpl, instanceId++ & PLDM_INSTANCE_ID_MASK, response, &length);
+        benchmark::DoNotOptimize(responseMsg);
+    }
+    pldm_response_template_destroy(tmpl);
+}
+BENCHMARK(BM_TemplateGetCommandsResp);
+
+// GetPLDMVersion responses, which compute the CRC32 of the versions each time
+// unless copied from a template
+
+static const std::array<ver32_t, 4> versions{
+    ver32_t{0xf1, 0xf0, 0xf0, 0x00}, ver32_t{0xf1, 0xf1, 0xf0, 0x00},
+    ver32_t{0xf1, 0xf2, 0xf0, 0x00}, ver32_t{0xf1, 0xf3, 0xf0, 0x00}};
+
+static void BM_EncodeGetVersionResp(benchmark::State& state)
+{
+    std::array<uint8_t, sizeof(pldm_msg_hdr) + 64> responseMsg{};
+    auto response = reinterpret_cast<pldm_msg*>(responseMsg.data());
+    uint8_t instanceId = 0;
+    for (auto _ : state)
+    {
+        size_t length = 0;
+        encode_get_version_resp_multipart(
+            instanceId++ & PLDM_INSTANCE_ID_MASK, versions.data(),
+            versions.size(), 0, PLDM_GET_FIRSTPART, 64, response, &length);
+        benchmark::DoNotOptimize(responseMsg);
+    }
+}
+BENCHMARK(BM_EncodeGetVersionResp);
+
+static void BM_TemplateGetVersionResp(benchmark::State& state)
+{
+    std::array<uint8_t, sizeof(pldm_msg_hdr) + 64> responseMsg{};
+    auto response = reinterpret_cast<pldm_msg*>(responseMsg.data());
+    size_t length = 0;
+    encode_get_version_resp_multipart(0, versions.data(), versions.size(), 0,
+                                      PLDM_GET_FIRSTPART, 64, response,
+                                      &length);
+    auto tmpl = pldm_response_template_init(response, length);
+    uint8_t instanceId = 0;
+    for (auto _ : state)
+    {
+        length = 64;
+        pldm_response_template_encode(
+            tmpl, instanceId++ & PLDM_INSTANCE_ID_MASK, response, &length);
+        benchmark::DoNotOptimize(responseMsg);
+    }
+    pldm_response_template_destroy(tmpl);
+}
+BENCHMARK(BM_TemplateGetVersionResp);
+
+BENCHMARK_MAIN();
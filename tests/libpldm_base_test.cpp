@@ -1,7 +1,11 @@
 #include <string.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <cstring>
+#include <thread>
 #include <vector>
 
 #include "../base.h"
@@ -858,6 +862,1361 @@ TEST(HeaderOnlyRequest, encodeHeaderOnlyRequestInvalid)
     EXPECT_EQ(rc, PLDM_ERROR_INVALID_DATA);
 }
 
+TEST(FastHeader, testMatchesPackUnpack)
+{
+    for (uint8_t msgType : {PLDM_RESPONSE, PLDM_REQUEST,
+                            PLDM_ASYNC_REQUEST_NOTIFY})
+    {
+        for (uint8_t instanceId = 0; instanceId < PLDM_INSTANCE_MAX;
+             instanceId += 7)
+        {
+            for (uint8_t type = 0; type < PLDM_MAX_TYPES; type += 9)
+            {
+                pldm_header_info info{};
+                info.msg_type = static_cast<MessageType>(msgType);
+                info.instance = instanceId;
+                info.pldm_type = type;
+                info.command = type + 0x80;
+                pldm_msg_hdr expected{};
+                ASSERT_EQ(pack_pldm_header(&info, &expected), PLDM_SUCCESS);
+
+                pldm_msg_hdr hdr{};
+                ASSERT_EQ(pack_pldm_header_fast(msgType, instanceId, type,
+                                                type + 0x80, &hdr),
+                          PLDM_SUCCESS);
+                EXPECT_EQ(0, memcmp(&hdr, &expected, sizeof(hdr)));
+
+                uint8_t unpackedMsgType, unpackedInstanceId, unpackedType,
+                    unpackedCommand;
+                ASSERT_EQ(unpack_pldm_header_fast(
+                              &hdr, &unpackedMsgType, &unpackedInstanceId,
+                              &unpackedType, &unpackedCommand),
+                          PLDM_SUCCESS);
+                EXPECT_EQ(unpackedMsgType, msgType);
+                EXPECT_EQ(unpackedInstanceId, instanceId);
+                EXPECT_EQ(unpackedType, type);
+                EXPECT_EQ(unpackedCommand, type + 0x80);
+            }
+        }
+    }
+
+    pldm_msg_hdr hdr{};
+    EXPECT_EQ(pack_pldm_header_fast(PLDM_RESERVED, 0, 0, 0, &hdr),
+              PLDM_ERROR_INVALID_DATA);
+    EXPECT_EQ(pack_pldm_header_fast(PLDM_REQUEST, PLDM_INSTANCE_MAX, 0, 0,
+                                    &hdr),
+              PLDM_ERROR_INVALID_DATA);
+    EXPECT_EQ(pack_pldm_header_fast(PLDM_REQUEST, 0, PLDM_MAX_TYPES, 0, &hdr),
+              PLDM_ERROR_INVALID_PLDM_TYPE);
+    EXPECT_EQ(pack_pldm_header_fast(PLDM_REQUEST, 0, 0, 0, nullptr),
+              PLDM_ERROR_INVALID_DATA);
+}
+
+TEST(FastHeader, testValidateBatch)
+{
+    std::array<pldm_msg_hdr, 5> hdrs{};
+    ASSERT_EQ(pack_pldm_header_fast(PLDM_REQUEST, 1, PLDM_BASE, PLDM_GET_TID,
+                                    &hdrs[0]),
+              PLDM_SUCCESS);
+    ASSERT_EQ(pack_pldm_header_fast(PLDM_RESPONSE, 2, PLDM_FRU, 1, &hdrs[1]),
+              PLDM_SUCCESS);
+    hdrs[2] = hdrs[0];
+    hdrs[2].reserved = 1;
+    hdrs[3] = hdrs[0];
+    hdrs[3].header_ver = 1;
+    hdrs[4] = hdrs[1];
+    hdrs[4].datagram = 1;
+
+    std::array<bool, 5> valid{};
+    EXPECT_EQ(validate_pldm_headers(hdrs.data(), hdrs.size(), valid.data()),
+              2u);
+    EXPECT_THAT(valid, ElementsAreArray({true, true, false, false, false}));
+}
+
+TEST(InstanceIdAlloc, testAcquireRelease)
+{
+    auto alloc = pldm_instance_id_alloc_init(PLDM_INSTANCE_ID_EXPIRY_MS);
+    uint8_t id;
+    uint64_t token;
+    std::array<uint64_t, PLDM_INSTANCE_MAX> tokens{};
+
+    // IDs go round rather than the last released one being reused
+    ASSERT_EQ(pldm_instance_id_try_acquire(alloc, 1, &id, &token),
+              PLDM_SUCCESS);
+    EXPECT_EQ(id, 0);
+    EXPECT_EQ(pldm_instance_id_release(alloc, 1, id, token), PLDM_SUCCESS);
+    EXPECT_EQ(pldm_instance_id_release(alloc, 1, id, token),
+              PLDM_ERROR_INVALID_DATA);
+    for (uint8_t i = 1; i < PLDM_INSTANCE_MAX; ++i)
+    {
+        ASSERT_EQ(pldm_instance_id_try_acquire(alloc, 1, &id, &tokens[i]),
+                  PLDM_SUCCESS);
+        EXPECT_EQ(id, i);
+    }
+    ASSERT_EQ(pldm_instance_id_try_acquire(alloc, 1, &id, &tokens[0]),
+              PLDM_SUCCESS);
+    EXPECT_EQ(id, 0);
+    EXPECT_NE(tokens[0], token);
+    EXPECT_EQ(pldm_instance_id_try_acquire(alloc, 1, &id, &token),
+              PLDM_ERROR_NOT_READY);
+    EXPECT_EQ(pldm_instance_id_acquire(alloc, 1, 10, &id, &token),
+              PLDM_ERROR_NOT_READY);
+
+    // Termini have their own IDs
+    ASSERT_EQ(pldm_instance_id_try_acquire(alloc, 2, &id, &token),
+              PLDM_SUCCESS);
+    EXPECT_EQ(id, 0);
+
+    // Only the token the ID is held with releases it
+    EXPECT_EQ(pldm_instance_id_release(alloc, 1, 5, 0),
+              PLDM_ERROR_INVALID_DATA);
+    EXPECT_EQ(pldm_instance_id_release(alloc, 1, 5, tokens[5]), PLDM_SUCCESS);
+    ASSERT_EQ(pldm_instance_id_try_acquire(alloc, 1, &id, &token),
+              PLDM_SUCCESS);
+    EXPECT_EQ(id, 5);
+
+    std::array<uint8_t, hdrSize> msg{};
+    auto request = reinterpret_cast<pldm_msg*>(msg.data());
+    ASSERT_EQ(pldm_instance_id_encode_request_header(
+                  alloc, 2, PLDM_BASE, PLDM_GET_TID, request, &token),
+              PLDM_SUCCESS);
+    EXPECT_EQ(request->hdr.instance_id, 1);
+    EXPECT_EQ(request->hdr.request, PLDM_REQUEST);
+    EXPECT_EQ(request->hdr.command, PLDM_GET_TID);
+    EXPECT_EQ(pldm_instance_id_release(alloc, 2, 1, token), PLDM_SUCCESS);
+
+    EXPECT_EQ(pldm_instance_id_release(alloc, 1, PLDM_INSTANCE_MAX, token),
+              PLDM_ERROR_INVALID_DATA);
+    pldm_instance_id_alloc_destroy(alloc);
+}
+
+TEST(InstanceIdAlloc, testExpiry)
+{
+    auto alloc = pldm_instance_id_alloc_init(50);
+    uint8_t id;
+    uint64_t token;
+    for (uint8_t i = 0; i < PLDM_INSTANCE_MAX; ++i)
+    {
+        ASSERT_EQ(pldm_instance_id_try_acquire(alloc, 1, &id, &token),
+                  PLDM_SUCCESS);
+    }
+    EXPECT_EQ(pldm_instance_id_try_acquire(alloc, 1, &id, &token),
+              PLDM_ERROR_NOT_READY);
+
+    // Waits for the oldest ID to expire
+    ASSERT_EQ(pldm_instance_id_acquire(alloc, 1, 1000, &id, &token),
+              PLDM_SUCCESS);
+    EXPECT_EQ(pldm_instance_id_release(alloc, 1, id, token), PLDM_SUCCESS);
+    pldm_instance_id_alloc_destroy(alloc);
+}
+
+static std::atomic<uint64_t> fakeNowMs;
+
+static uint64_t fakeClock()
+{
+    return fakeNowMs;
+}
+
+TEST(InstanceIdAlloc, testReclaim)
+{
+    auto alloc = pldm_instance_id_alloc_init(10);
+    pldm_instance_id_alloc_set_clock(alloc, fakeClock);
+    uint8_t id;
+    std::array<uint64_t, PLDM_INSTANCE_MAX> tokens{};
+
+    fakeNowMs = 1000;
+    for (uint8_t i = 0; i < PLDM_INSTANCE_MAX; ++i)
+    {
+        ASSERT_EQ(pldm_instance_id_try_acquire(alloc, 1, &id, &tokens[i]),
+                  PLDM_SUCCESS);
+        ASSERT_EQ(id, i);
+    }
+
+    // IDs acquired after the reclaiming thread read the clock are not taken
+    // over
+    fakeNowMs = 999;
+    uint64_t token;
+    EXPECT_EQ(pldm_instance_id_try_acquire(alloc, 1, &id, &token),
+              PLDM_ERROR_NOT_READY);
+    fakeNowMs = 1009;
+    EXPECT_EQ(pldm_instance_id_try_acquire(alloc, 1, &id, &token),
+              PLDM_ERROR_NOT_READY);
+
+    // Once expired, the late holder can no longer release the ID it lost,
+    // so it is not handed out twice
+    fakeNowMs = 1010;
+    ASSERT_EQ(pldm_instance_id_try_acquire(alloc, 1, &id, &token),
+              PLDM_SUCCESS);
+    EXPECT_EQ(id, 0);
+    EXPECT_EQ(pldm_instance_id_release(alloc, 1, 0, tokens[0]),
+              PLDM_ERROR_INVALID_DATA);
+    uint64_t other;
+    EXPECT_EQ(pldm_instance_id_try_acquire(alloc, 1, &id, &other),
+              PLDM_SUCCESS);
+    EXPECT_EQ(id, 1);
+    EXPECT_EQ(pldm_instance_id_release(alloc, 1, 0, token), PLDM_SUCCESS);
+    EXPECT_EQ(pldm_instance_id_release(alloc, 1, 1, tokens[1]),
+              PLDM_ERROR_INVALID_DATA);
+    EXPECT_EQ(pldm_instance_id_release(alloc, 1, 1, other), PLDM_SUCCESS);
+    pldm_instance_id_alloc_destroy(alloc);
+}
+
+TEST(InstanceIdAlloc, testTimeoutWithClock)
+{
+    auto alloc = pldm_instance_id_alloc_init(10000);
+    pldm_instance_id_alloc_set_clock(alloc, fakeClock);
+    uint8_t id;
+    uint64_t token;
+
+    fakeNowMs = 2000;
+    for (uint8_t i = 0; i < PLDM_INSTANCE_MAX; ++i)
+    {
+        ASSERT_EQ(pldm_instance_id_try_acquire(alloc, 1, &id, &token),
+                  PLDM_SUCCESS);
+    }
+
+    // The allocator's clock stands still, the timeout still runs out
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(pldm_instance_id_acquire(alloc, 1, 20, &id, &token),
+              PLDM_ERROR_NOT_READY);
+    EXPECT_GE(std::chrono::steady_clock::now() - start,
+              std::chrono::milliseconds(10));
+    pldm_instance_id_alloc_destroy(alloc);
+}
+
+TEST(InstanceIdAlloc, testConcurrent)
+{
+    auto alloc = pldm_instance_id_alloc_init(PLDM_INSTANCE_ID_EXPIRY_MS);
+    std::array<std::atomic<bool>, PLDM_INSTANCE_MAX> held{};
+    std::atomic<bool> failed{false};
+
+    // More threads than IDs, so that some wait for others to release
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 40; ++i)
+    {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < 1000; ++j)
+            {
+                uint8_t id;
+                uint64_t token;
+                if (pldm_instance_id_acquire(alloc, 1, 10000, &id, &token) !=
+                    PLDM_SUCCESS)
+                {
+                    failed = true;
+                    return;
+                }
+                if (held[id].exchange(true))
+                {
+                    failed = true;
+                }
+                std::this_thread::yield();
+                held[id] = false;
+                if (pldm_instance_id_release(alloc, 1, id, token) !=
+                    PLDM_SUCCESS)
+                {
+                    failed = true;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    EXPECT_FALSE(failed);
+
+    // All released
+    uint8_t id;
+    uint64_t token;
+    for (uint8_t i = 0; i < PLDM_INSTANCE_MAX; ++i)
+    {
+        EXPECT_EQ(pldm_instance_id_try_acquire(alloc, 1, &id, &token),
+                  PLDM_SUCCESS);
+    }
+    pldm_instance_id_alloc_destroy(alloc);
+}
+
+TEST(RequestTracker, testMatch)
+{
+    auto tracker = pldm_request_tracker_init(10, 1000);
+    int context1 = 0;
+    int context2 = 0;
+    ASSERT_EQ(pldm_request_tracker_register(tracker, 1, 3, PLDM_BASE,
+                                            PLDM_GET_TID, 2000, &context1),
+              PLDM_SUCCESS);
+    EXPECT_EQ(pldm_request_tracker_register(tracker, 1, 3, PLDM_BASE,
+                                            PLDM_GET_TID, 2000, &context1),
+              PLDM_ERROR_INVALID_DATA);
+    ASSERT_EQ(pldm_request_tracker_register(tracker, 2, 3, PLDM_BASE,
+                                            PLDM_GET_PLDM_TYPES, 2000,
+                                            &context2),
+              PLDM_SUCCESS);
+
+    std::array<uint8_t, hdrSize> msg{};
+    auto response = reinterpret_cast<pldm_msg*>(msg.data());
+    void* context = nullptr;
+    ASSERT_EQ(encode_pldm_header(3, PLDM_BASE, PLDM_GET_TID, PLDM_RESPONSE,
+                                 response),
+              PLDM_SUCCESS);
+    EXPECT_EQ(pldm_request_tracker_match(tracker, 1, &response->hdr, &context),
+              PLDM_SUCCESS);
+    EXPECT_EQ(context, &context1);
+    // Wrong TID, command, or not a response
+    EXPECT_EQ(pldm_request_tracker_match(tracker, 2, &response->hdr, nullptr),
+              PLDM_ERROR_INVALID_DATA);
+    ASSERT_EQ(encode_pldm_header(3, PLDM_BASE, PLDM_GET_TID, PLDM_REQUEST,
+                                 response),
+              PLDM_SUCCESS);
+    EXPECT_EQ(pldm_request_tracker_match(tracker, 1, &response->hdr, nullptr),
+              PLDM_ERROR_INVALID_DATA);
+
+    EXPECT_EQ(pldm_request_tracker_complete(tracker, 1, 3), PLDM_SUCCESS);
+    EXPECT_EQ(pldm_request_tracker_complete(tracker, 1, 3),
+              PLDM_ERROR_INVALID_DATA);
+    ASSERT_EQ(encode_pldm_header(3, PLDM_BASE, PLDM_GET_TID, PLDM_RESPONSE,
+                                 response),
+              PLDM_SUCCESS);
+    EXPECT_EQ(pldm_request_tracker_match(tracker, 1, &response->hdr, nullptr),
+              PLDM_ERROR_INVALID_DATA);
+
+    std::array<pldm_request_expiry, 4> expired{};
+    ASSERT_EQ(pldm_request_tracker_expire(tracker, 2000, expired.data(),
+                                          expired.size()),
+              1u);
+    EXPECT_EQ(expired[0].tid, 2);
+    EXPECT_EQ(expired[0].instance_id, 3);
+    EXPECT_EQ(expired[0].command, PLDM_GET_PLDM_TYPES);
+    EXPECT_EQ(expired[0].context, &context2);
+    pldm_request_tracker_destroy(tracker);
+}
+
+TEST(RequestTracker, testExpire)
+{
+    auto tracker = pldm_request_tracker_init(10, 0);
+    // Deadlines within a turn of the wheel, beyond it, and already past
+    ASSERT_EQ(pldm_request_tracker_register(tracker, 1, 0, PLDM_BASE,
+                                            PLDM_GET_TID, 50, nullptr),
+              PLDM_SUCCESS);
+    ASSERT_EQ(pldm_request_tracker_register(tracker, 1, 1, PLDM_BASE,
+                                            PLDM_GET_TID, 55, nullptr),
+              PLDM_SUCCESS);
+    ASSERT_EQ(pldm_request_tracker_register(tracker, 1, 2, PLDM_BASE,
+                                            PLDM_GET_TID, 50 + 10 * 256,
+                                            nullptr),
+              PLDM_SUCCESS);
+    ASSERT_EQ(pldm_request_tracker_register(tracker, 1, 3, PLDM_BASE,
+                                            PLDM_GET_TID, 10 * 1024, nullptr),
+              PLDM_SUCCESS);
+
+    std::array<pldm_request_expiry, 4> expired{};
+    EXPECT_EQ(pldm_request_tracker_expire(tracker, 49, expired.data(),
+                                          expired.size()),
+              0u);
+    ASSERT_EQ(pldm_request_tracker_expire(tracker, 52, expired.data(),
+                                          expired.size()),
+              1u);
+    EXPECT_EQ(expired[0].instance_id, 0);
+
+    ASSERT_EQ(pldm_request_tracker_register(tracker, 1, 0, PLDM_BASE,
+                                            PLDM_GET_TID, 20, nullptr),
+              PLDM_SUCCESS);
+    // Only one at a time, the other is returned next
+    ASSERT_EQ(pldm_request_tracker_expire(tracker, 60, expired.data(), 1),
+              1u);
+    uint8_t first = expired[0].instance_id;
+    ASSERT_EQ(pldm_request_tracker_expire(tracker, 60, expired.data(),
+                                          expired.size()),
+              1u);
+    EXPECT_EQ(first + expired[0].instance_id, 0 + 1);
+
+    // The same slot, a turn of the wheel later
+    ASSERT_EQ(pldm_request_tracker_expire(tracker, 50 + 10 * 256 - 1,
+                                          expired.data(), expired.size()),
+              0u);
+    ASSERT_EQ(pldm_request_tracker_expire(tracker, 50 + 10 * 256,
+                                          expired.data(), expired.size()),
+              1u);
+    EXPECT_EQ(expired[0].instance_id, 2);
+
+    // Jumping past several turns
+    ASSERT_EQ(pldm_request_tracker_expire(tracker, 100000, expired.data(),
+                                          expired.size()),
+              1u);
+    EXPECT_EQ(expired[0].instance_id, 3);
+    pldm_request_tracker_destroy(tracker);
+}
+
+static int getTidHandler(void* ctx, const pldm_header_info* hdr,
+                         const pldm_msg* /*request*/, size_t /*payloadLength*/,
+                         pldm_msg* response, size_t* responsePayloadLength)
+{
+    ++*static_cast<int*>(ctx);
+    *responsePayloadLength = PLDM_GET_TID_RESP_BYTES;
+    return encode_get_tid_resp(hdr->instance, PLDM_SUCCESS, 7, response);
+}
+
+TEST(Responder, testDispatch)
+{
+    auto responder = pldm_responder_init();
+    int calls = 0;
+    ASSERT_EQ(pldm_responder_register(responder, PLDM_BASE, PLDM_GET_TID,
+                                      getTidHandler, &calls),
+              PLDM_SUCCESS);
+    ASSERT_EQ(pldm_responder_register(responder, PLDM_FRU, 0x01,
+                                      getTidHandler, &calls),
+              PLDM_SUCCESS);
+    EXPECT_EQ(pldm_responder_register(responder, PLDM_MAX_TYPES, 0x01,
+                                      getTidHandler, &calls),
+              PLDM_ERROR_INVALID_DATA);
+
+    std::array<uint8_t, hdrSize + PLDM_GET_COMMANDS_REQ_BYTES> requestMsg{};
+    auto request = reinterpret_cast<pldm_msg*>(requestMsg.data());
+    std::array<uint8_t, hdrSize + PLDM_GET_COMMANDS_RESP_BYTES> responseMsg{};
+    auto response = reinterpret_cast<pldm_msg*>(responseMsg.data());
+    size_t responseLength = PLDM_GET_COMMANDS_RESP_BYTES;
+
+    ASSERT_EQ(encode_get_tid_req(1, request), PLDM_SUCCESS);
+    ASSERT_EQ(pldm_responder_dispatch(responder, request, 0, response,
+                                      &responseLength),
+              PLDM_SUCCESS);
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(responseLength, PLDM_GET_TID_RESP_BYTES);
+    EXPECT_EQ(response->hdr.instance_id, 1);
+    EXPECT_EQ(response->payload[1], 7);
+
+    // The types and commands registered are reported
+    ASSERT_EQ(encode_get_types_req(2, request), PLDM_SUCCESS);
+    responseLength = PLDM_GET_COMMANDS_RESP_BYTES;
+    ASSERT_EQ(pldm_responder_dispatch(responder, request, 0, response,
+                                      &responseLength),
+              PLDM_SUCCESS);
+    EXPECT_EQ(responseLength, PLDM_GET_TYPES_RESP_BYTES);
+    EXPECT_EQ(response->payload[0], PLDM_SUCCESS);
+    EXPECT_EQ(response->payload[1], 1 << PLDM_BASE | 1 << PLDM_FRU);
+    EXPECT_EQ(response->payload[2], 0);
+
+    ver32_t version{0xFF, 0xFF, 0xFF, 0xFF};
+    ASSERT_EQ(encode_get_commands_req(3, PLDM_BASE, version, request),
+              PLDM_SUCCESS);
+    responseLength = PLDM_GET_COMMANDS_RESP_BYTES;
+    ASSERT_EQ(pldm_responder_dispatch(responder, request,
+                                      PLDM_GET_COMMANDS_REQ_BYTES, response,
+                                      &responseLength),
+              PLDM_SUCCESS);
+    EXPECT_EQ(responseLength, PLDM_GET_COMMANDS_RESP_BYTES);
+    EXPECT_EQ(response->payload[1], 1 << PLDM_GET_TID |
+                                        1 << PLDM_GET_PLDM_TYPES |
+                                        1 << PLDM_GET_PLDM_COMMANDS);
+
+    ASSERT_EQ(encode_get_commands_req(3, PLDM_PLATFORM, version, request),
+              PLDM_SUCCESS);
+    responseLength = PLDM_GET_COMMANDS_RESP_BYTES;
+    ASSERT_EQ(pldm_responder_dispatch(responder, request,
+                                      PLDM_GET_COMMANDS_REQ_BYTES, response,
+                                      &responseLength),
+              PLDM_SUCCESS);
+    EXPECT_EQ(responseLength, 1u);
+    EXPECT_EQ(response->payload[0], PLDM_ERROR_INVALID_PLDM_TYPE);
+
+    // An unknown command of a supported type
+    ASSERT_EQ(encode_header_only_request(4, PLDM_BASE, PLDM_SET_TID, request),
+              PLDM_SUCCESS);
+    responseLength = PLDM_GET_COMMANDS_RESP_BYTES;
+    ASSERT_EQ(pldm_responder_dispatch(responder, request, 0, response,
+                                      &responseLength),
+              PLDM_SUCCESS);
+    EXPECT_EQ(responseLength, 1u);
+    EXPECT_EQ(response->payload[0], PLDM_ERROR_UNSUPPORTED_PLDM_CMD);
+    EXPECT_EQ(response->hdr.command, PLDM_SET_TID);
+
+    // A type without any command
+    ASSERT_EQ(encode_header_only_request(4, PLDM_PLATFORM, 0x51, request),
+              PLDM_SUCCESS);
+    responseLength = PLDM_GET_COMMANDS_RESP_BYTES;
+    ASSERT_EQ(pldm_responder_dispatch(responder, request, 0, response,
+                                      &responseLength),
+              PLDM_SUCCESS);
+    EXPECT_EQ(responseLength, 1u);
+    EXPECT_EQ(response->payload[0], PLDM_ERROR_INVALID_PLDM_TYPE);
+    EXPECT_EQ(response->hdr.type, PLDM_PLATFORM);
+
+    // Unregistered, and no longer reported; the type goes with its last
+    // command
+    ASSERT_EQ(pldm_responder_register(responder, PLDM_FRU, 0x01, nullptr,
+                                      nullptr),
+              PLDM_SUCCESS);
+    ASSERT_EQ(encode_header_only_request(4, PLDM_FRU, 0x01, request),
+              PLDM_SUCCESS);
+    responseLength = PLDM_GET_COMMANDS_RESP_BYTES;
+    ASSERT_EQ(pldm_responder_dispatch(responder, request, 0, response,
+                                      &responseLength),
+              PLDM_SUCCESS);
+    EXPECT_EQ(responseLength, 1u);
+    EXPECT_EQ(response->payload[0], PLDM_ERROR_INVALID_PLDM_TYPE);
+    EXPECT_EQ(response->hdr.type, PLDM_FRU);
+    EXPECT_EQ(calls, 1);
+
+    ASSERT_EQ(encode_get_types_req(2, request), PLDM_SUCCESS);
+    responseLength = PLDM_GET_COMMANDS_RESP_BYTES;
+    ASSERT_EQ(pldm_responder_dispatch(responder, request, 0, response,
+                                      &responseLength),
+              PLDM_SUCCESS);
+    EXPECT_EQ(response->payload[1], 1 << PLDM_BASE);
+
+    // Responses are not dispatched
+    ASSERT_EQ(encode_get_tid_resp(1, PLDM_SUCCESS, 7, request), PLDM_SUCCESS);
+    EXPECT_EQ(pldm_responder_dispatch(responder, request, 0, response,
+                                      &responseLength),
+              PLDM_ERROR_INVALID_DATA);
+
+    pldm_responder_destroy(responder);
+}
+
+// Count the heap calls of a thread while heapCounting is set, by wrapping
+// the glibc allocator. The sanitizers bring their own allocator, so the count
+// is not available under them.
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define HEAP_COUNTING 0
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer) ||   \
+    __has_feature(memory_sanitizer)
+#define HEAP_COUNTING 0
+#endif
+#endif
+#if !defined(HEAP_COUNTING) && defined(__GLIBC__)
+#define HEAP_COUNTING 1
+#endif
+
+#if HEAP_COUNTING
+static thread_local bool heapCounting = false;
+static thread_local size_t heapCalls = 0;
+
+extern "C"
+{
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* ptr, size_t size);
+    void __libc_free(void* ptr);
+
+    void* malloc(size_t size)
+    {
+        heapCalls += heapCounting;
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size)
+    {
+        heapCalls += heapCounting;
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* ptr, size_t size)
+    {
+        heapCalls += heapCounting;
+        return __libc_realloc(ptr, size);
+    }
+
+    void free(void* ptr)
+    {
+        heapCalls += heapCounting && ptr;
+        __libc_free(ptr);
+    }
+}
+#endif
+
+TEST(MsgPool, testSizeClasses)
+{
+    std::thread([] {
+        EXPECT_EQ(pldm_msg_pool_acquire(PLDM_MSG_POOL_MAX_SIZE), nullptr);
+        pldm_msg_pool_release(nullptr);
+
+        auto small = pldm_msg_pool_acquire(PLDM_MSG_POOL_SMALL_SIZE - hdrSize);
+        auto baseline = pldm_msg_pool_acquire(PLDM_MSG_POOL_SMALL_SIZE);
+        auto large =
+            pldm_msg_pool_acquire(PLDM_MSG_POOL_MAX_SIZE - hdrSize);
+        ASSERT_NE(small, nullptr);
+        ASSERT_NE(baseline, nullptr);
+        ASSERT_NE(large, nullptr);
+        memset(large, 0xff, PLDM_MSG_POOL_MAX_SIZE);
+        pldm_msg_pool_release(small);
+        pldm_msg_pool_release(baseline);
+        pldm_msg_pool_release(large);
+
+        // Each class hands back its own buffer
+        EXPECT_EQ(pldm_msg_pool_acquire(1), small);
+        EXPECT_EQ(pldm_msg_pool_acquire(PLDM_MSG_POOL_BASELINE_SIZE - hdrSize),
+                  baseline);
+        EXPECT_EQ(pldm_msg_pool_acquire(PLDM_MSG_POOL_BASELINE_SIZE), large);
+        pldm_msg_pool_release(small);
+        pldm_msg_pool_release(baseline);
+        pldm_msg_pool_release(large);
+
+        pldm_msg_pool_stats stats{};
+        pldm_msg_pool_get_stats(&stats);
+        EXPECT_EQ(stats.acquired, 6u);
+        EXPECT_EQ(stats.released, 6u);
+        EXPECT_EQ(stats.heap_allocations, 3u);
+        EXPECT_EQ(stats.cached, 3u);
+
+        pldm_msg_pool_drain();
+        pldm_msg_pool_get_stats(&stats);
+        EXPECT_EQ(stats.heap_frees, 3u);
+        EXPECT_EQ(stats.cached, 0u);
+    }).join();
+}
+
+TEST(MsgPool, testNoSteadyStateAllocations)
+{
+    std::thread([] {
+        auto roundTrip = [] {
+            auto request = pldm_msg_pool_acquire(PLDM_GET_COMMANDS_REQ_BYTES);
+            auto response =
+                pldm_msg_pool_acquire(PLDM_GET_COMMANDS_RESP_BYTES);
+            ver32_t version{0xff, 0xff, 0xff, 0xff};
+            EXPECT_EQ(encode_get_commands_req(0, PLDM_BASE, version, request),
+                      PLDM_SUCCESS);
+
+            uint8_t type = 0;
+            EXPECT_EQ(decode_get_commands_req(request,
+                                              PLDM_GET_COMMANDS_REQ_BYTES,
+                                              &type, &version),
+                      PLDM_SUCCESS);
+            std::array<bitfield8_t, PLDM_MAX_CMDS_PER_TYPE / 8> commands{};
+            commands[0].byte = 0x3f;
+            EXPECT_EQ(encode_get_commands_resp(0, PLDM_SUCCESS,
+                                               commands.data(), response),
+                      PLDM_SUCCESS);
+
+            uint8_t cc = 0;
+            std::array<bitfield8_t, PLDM_MAX_CMDS_PER_TYPE / 8> decoded{};
+            EXPECT_EQ(decode_get_commands_resp(response,
+                                               PLDM_GET_COMMANDS_RESP_BYTES,
+                                               &cc, decoded.data()),
+                      PLDM_SUCCESS);
+            EXPECT_EQ(decoded[0].byte, 0x3f);
+            pldm_msg_pool_release(request);
+            pldm_msg_pool_release(response);
+        };
+
+        roundTrip();
+        pldm_msg_pool_stats warm{};
+        pldm_msg_pool_get_stats(&warm);
+        EXPECT_EQ(warm.heap_allocations, 2u);
+
+#if HEAP_COUNTING
+        heapCalls = 0;
+        heapCounting = true;
+#endif
+        for (int i = 0; i < 1000; ++i)
+        {
+            roundTrip();
+        }
+#if HEAP_COUNTING
+        heapCounting = false;
+        EXPECT_EQ(heapCalls, 0u);
+#endif
+
+        pldm_msg_pool_stats stats{};
+        pldm_msg_pool_get_stats(&stats);
+        EXPECT_EQ(stats.acquired, 2002u);
+        EXPECT_EQ(stats.heap_allocations, warm.heap_allocations);
+        EXPECT_EQ(stats.heap_frees, 0u);
+        pldm_msg_pool_drain();
+    }).join();
+}
+
+TEST(MsgPool, testCacheLimit)
+{
+    std::thread([] {
+        std::vector<pldm_msg*> msgs;
+        for (int i = 0; i < PLDM_MSG_POOL_MAX_CACHED + 4; ++i)
+        {
+            msgs.push_back(pldm_msg_pool_acquire(1));
+        }
+        for (auto msg : msgs)
+        {
+            pldm_msg_pool_release(msg);
+        }
+
+        pldm_msg_pool_stats stats{};
+        pldm_msg_pool_get_stats(&stats);
+        EXPECT_EQ(stats.heap_allocations, PLDM_MSG_POOL_MAX_CACHED + 4u);
+        EXPECT_EQ(stats.heap_frees, 4u);
+        EXPECT_EQ(stats.cached, static_cast<size_t>(PLDM_MSG_POOL_MAX_CACHED));
+        pldm_msg_pool_drain();
+    }).join();
+}
+
+namespace
+{
+
+// Endpoint answering discovery with base (0), platform (2) and FRU (4) types.
+// Platform version data comes back in parts of partSize bytes.
+struct FakeEndpoint
+{
+    static constexpr uint8_t platform = 2;
+    static constexpr uint8_t fru = 4;
+    static constexpr size_t partSize = 5;
+
+    uint8_t tid;
+    bool corruptOnce = false;
+    bool rejectFruCommands = false;
+
+    // The alpha byte of the first version tells the types apart
+    std::array<ver32_t, 2> versions(uint8_t type) const
+    {
+        return {ver32_t{0xf1, 0xf0, 0xf0, type},
+                ver32_t{0xf2, 0xf0, 0xf0, 0x00}};
+    }
+
+    std::vector<uint8_t> respond(const std::vector<uint8_t>& requestMsg)
+    {
+        auto request = reinterpret_cast<const pldm_msg*>(requestMsg.data());
+        size_t requestLength = requestMsg.size() - hdrSize;
+        uint8_t iid = request->hdr.instance_id;
+        std::vector<uint8_t> responseMsg(hdrSize + 64);
+        auto response = reinterpret_cast<pldm_msg*>(responseMsg.data());
+        size_t length = 0;
+
+        switch (request->hdr.command)
+        {
+            case PLDM_GET_TID:
+                encode_get_tid_resp(iid, PLDM_SUCCESS, tid, response);
+                length = PLDM_GET_TID_RESP_BYTES;
+                break;
+            case PLDM_GET_PLDM_TYPES:
+            {
+                std::array<bitfield8_t, 8> types{};
+                types[0].byte = 1 | (1 << platform) | (1 << fru);
+                encode_get_types_resp(iid, PLDM_SUCCESS, types.data(),
+                                      response);
+                length = PLDM_GET_TYPES_RESP_BYTES;
+                break;
+            }
+            case PLDM_GET_PLDM_VERSION:
+            {
+                uint32_t handle = 0;
+                uint8_t opflag = 0;
+                uint8_t type = 0;
+                EXPECT_EQ(decode_get_version_req(request, requestLength,
+                                                 &handle, &opflag, &type),
+                          PLDM_SUCCESS);
+                auto list = versions(type);
+                size_t maxLength = PLDM_GET_VERSION_RESP_FIXED_BYTES +
+                                   (type == platform ? partSize : 64);
+                EXPECT_EQ(encode_get_version_resp_multipart(
+                              iid, list.data(), list.size(), handle, opflag,
+                              maxLength, response, &length),
+                          PLDM_SUCCESS);
+                if (corruptOnce)
+                {
+                    corruptOnce = false;
+                    response->payload[PLDM_GET_VERSION_RESP_FIXED_BYTES] ^= 1;
+                }
+                break;
+            }
+            default:
+            {
+                uint8_t type = 0;
+                ver32_t version{};
+                EXPECT_EQ(decode_get_commands_req(request, requestLength,
+                                                  &type, &version),
+                          PLDM_SUCCESS);
+                EXPECT_EQ(version.alpha, type);
+                EXPECT_EQ(version.major, 0xf1);
+                if (type == fru && rejectFruCommands)
+                {
+                    encode_get_commands_resp(iid, PLDM_ERROR, nullptr,
+                                             response);
+                    length = 1;
+                    break;
+                }
+                std::array<bitfield8_t, PLDM_MAX_CMDS_PER_TYPE / 8>
+                    commands{};
+                commands[0].byte = type + 1;
+                encode_get_commands_resp(iid, PLDM_SUCCESS, commands.data(),
+                                         response);
+                length = PLDM_GET_COMMANDS_RESP_BYTES;
+                break;
+            }
+        }
+
+        responseMsg.resize(hdrSize + length);
+        return responseMsg;
+    }
+};
+
+// Send every request the discovery makes, then answer them all, until no
+// endpoint is left. Returns the number of rounds.
+size_t runDiscovery(pldm_discovery* discovery,
+                    std::vector<FakeEndpoint>& endpoints, size_t window,
+                    size_t* numRequests)
+{
+    size_t rounds = 0;
+    *numRequests = 0;
+    while (pldm_discovery_in_progress(discovery) > 0)
+    {
+        std::vector<std::pair<uint8_t, std::vector<uint8_t>>> sent;
+        while (true)
+        {
+            std::vector<uint8_t> requestMsg(hdrSize +
+                                            PLDM_DISCOVERY_REQ_BYTES);
+            size_t length = PLDM_DISCOVERY_REQ_BYTES;
+            uint8_t eid = 0;
+            if (pldm_discovery_next_request(
+                    discovery, &eid,
+                    reinterpret_cast<pldm_msg*>(requestMsg.data()),
+                    &length) != PLDM_SUCCESS)
+            {
+                break;
+            }
+            requestMsg.resize(hdrSize + length);
+            sent.emplace_back(eid, std::move(requestMsg));
+        }
+        EXPECT_GT(sent.size(), 0u);
+        EXPECT_LE(sent.size(), window);
+        if (sent.empty())
+        {
+            break;
+        }
+
+        for (auto& [eid, requestMsg] : sent)
+        {
+            auto responseMsg = endpoints[eid].respond(requestMsg);
+            EXPECT_EQ(pldm_discovery_handle_response(
+                          discovery, eid,
+                          reinterpret_cast<pldm_msg*>(responseMsg.data()),
+                          responseMsg.size() - hdrSize),
+                      PLDM_SUCCESS);
+        }
+        *numRequests += sent.size();
+        ++rounds;
+    }
+    return rounds;
+}
+
+} // namespace
+
+TEST(Discovery, testPipelined)
+{
+    constexpr size_t numEndpoints = 64;
+    std::vector<FakeEndpoint> endpoints;
+    for (size_t eid = 0; eid < numEndpoints; ++eid)
+    {
+        endpoints.push_back({static_cast<uint8_t>(eid + 1)});
+    }
+
+    for (size_t window : {size_t(256), size_t(4)})
+    {
+        auto discovery = pldm_discovery_init(window);
+        for (size_t eid = 0; eid < numEndpoints; ++eid)
+        {
+            EXPECT_EQ(pldm_discovery_add(discovery, eid), PLDM_SUCCESS);
+        }
+
+        size_t numRequests = 0;
+        size_t rounds =
+            runDiscovery(discovery, endpoints, window, &numRequests);
+        // GetTID, GetPLDMTypes, three GetPLDMVersion parts for platform
+        // and GetPLDMVersion and GetPLDMCommands for each of three types
+        EXPECT_EQ(numRequests, numEndpoints * 10);
+        if (window == 256)
+        {
+            // One round each for GetTID and GetPLDMTypes, three for the
+            // platform version and one for its commands
+            EXPECT_EQ(rounds, 6u);
+        }
+        else
+        {
+            EXPECT_EQ(rounds, numRequests / window);
+        }
+
+        for (size_t eid = 0; eid < numEndpoints; ++eid)
+        {
+            const pldm_discovery_record* record = nullptr;
+            ASSERT_EQ(pldm_discovery_get_record(discovery, eid, &record),
+                      PLDM_SUCCESS);
+            EXPECT_EQ(record->eid, eid);
+            EXPECT_EQ(record->tid, eid + 1);
+            EXPECT_EQ(record->types[0].byte, 0x15);
+            for (uint8_t type : {0, 2, 4})
+            {
+                EXPECT_EQ(record->versions[type].alpha, type);
+                EXPECT_EQ(record->versions[type].major, 0xf1);
+                EXPECT_EQ(record->commands[type][0].byte, type + 1);
+            }
+        }
+        pldm_discovery_destroy(discovery);
+    }
+}
+
+TEST(Discovery, testErrors)
+{
+    std::vector<FakeEndpoint> endpoints{{1}, {2}, {3}};
+    endpoints[0].corruptOnce = true;
+    endpoints[1].rejectFruCommands = true;
+
+    auto discovery = pldm_discovery_init(8);
+    uint8_t eid = 0;
+    std::vector<uint8_t> requestMsg(hdrSize + PLDM_DISCOVERY_REQ_BYTES);
+    auto request = reinterpret_cast<pldm_msg*>(requestMsg.data());
+    size_t length = PLDM_DISCOVERY_REQ_BYTES - 1;
+    EXPECT_EQ(pldm_discovery_next_request(discovery, &eid, request, &length),
+              PLDM_ERROR_INVALID_LENGTH);
+    length = PLDM_DISCOVERY_REQ_BYTES;
+    EXPECT_EQ(pldm_discovery_next_request(discovery, &eid, request, &length),
+              PLDM_ERROR_NOT_READY);
+    const pldm_discovery_record* record = nullptr;
+    EXPECT_EQ(pldm_discovery_get_record(discovery, 2, &record),
+              PLDM_ERROR_INVALID_DATA);
+
+    // Endpoint 2 never answers, and fails once its retries are used up
+    EXPECT_EQ(pldm_discovery_add(discovery, 2), PLDM_SUCCESS);
+    for (int i = 0; i <= PLDM_DISCOVERY_MAX_RETRIES; ++i)
+    {
+        length = PLDM_DISCOVERY_REQ_BYTES;
+        ASSERT_EQ(
+            pldm_discovery_next_request(discovery, &eid, request, &length),
+            PLDM_SUCCESS);
+        EXPECT_EQ(eid, 2);
+        EXPECT_EQ(request->hdr.command, PLDM_GET_TID);
+        EXPECT_EQ(pldm_discovery_add(discovery, 2), PLDM_ERROR_NOT_READY);
+        EXPECT_EQ(pldm_discovery_cancel(discovery, 2,
+                                        request->hdr.instance_id + 1),
+                  PLDM_ERROR_INVALID_DATA);
+        EXPECT_EQ(
+            pldm_discovery_cancel(discovery, 2, request->hdr.instance_id),
+            PLDM_SUCCESS);
+    }
+    EXPECT_EQ(pldm_discovery_get_record(discovery, 2, &record), PLDM_ERROR);
+
+    // A bad CRC32 fetches the version data again, and a type whose
+    // GetPLDMCommands fails is left out
+    EXPECT_EQ(pldm_discovery_add(discovery, 0), PLDM_SUCCESS);
+    EXPECT_EQ(pldm_discovery_add(discovery, 1), PLDM_SUCCESS);
+    EXPECT_EQ(pldm_discovery_get_record(discovery, 0, &record),
+              PLDM_ERROR_NOT_READY);
+    size_t numRequests = 0;
+    runDiscovery(discovery, endpoints, 8, &numRequests);
+    EXPECT_EQ(numRequests, 21u);
+
+    ASSERT_EQ(pldm_discovery_get_record(discovery, 0, &record),
+              PLDM_SUCCESS);
+    EXPECT_EQ(record->types[0].byte, 0x15);
+    EXPECT_EQ(record->versions[FakeEndpoint::platform].major, 0xf1);
+    ASSERT_EQ(pldm_discovery_get_record(discovery, 1, &record),
+              PLDM_SUCCESS);
+    EXPECT_EQ(record->types[0].byte, 0x05);
+
+    // A response nobody asked for
+    auto responseMsg = endpoints[0].respond(requestMsg);
+    EXPECT_EQ(pldm_discovery_handle_response(
+                  discovery, 0,
+                  reinterpret_cast<pldm_msg*>(responseMsg.data()),
+                  responseMsg.size() - hdrSize),
+              PLDM_ERROR_INVALID_DATA);
+
+    pldm_discovery_destroy(discovery);
+}
+
+TEST(CapabilityCache, testSupported)
+{
+    pldm_capabilities caps{};
+    std::array<bitfield8_t, 8> types{};
+    types[0].byte = 0x05;
+    types[7].byte = 0x80;
+    pldm_capabilities_set_types(&caps, types.data());
+    EXPECT_TRUE(pldm_capabilities_type_supported(&caps, 0));
+    EXPECT_FALSE(pldm_capabilities_type_supported(&caps, 1));
+    EXPECT_TRUE(pldm_capabilities_type_supported(&caps, 2));
+    EXPECT_TRUE(pldm_capabilities_type_supported(&caps, 63));
+    EXPECT_FALSE(pldm_capabilities_type_supported(&caps, 64));
+
+    std::array<bitfield8_t, PLDM_MAX_CMDS_PER_TYPE / 8> commands{};
+    commands[0].byte = 0x3c;
+    commands[8].byte = 0x01;
+    commands[31].byte = 0x80;
+    ver32_t version{0xf1, 0xf0, 0xf0, 0x00};
+    EXPECT_EQ(pldm_capabilities_set_commands(&caps, 1, version,
+                                             commands.data()),
+              PLDM_ERROR_INVALID_PLDM_TYPE);
+    EXPECT_EQ(pldm_capabilities_set_commands(&caps, 2, version,
+                                             commands.data()),
+              PLDM_SUCCESS);
+    EXPECT_EQ(caps.versions[2].major, 0xf1);
+    for (int command = 0; command < PLDM_MAX_CMDS_PER_TYPE; ++command)
+    {
+        bool expected = (command >= 2 && command <= 5) || command == 64 ||
+                        command == 255;
+        EXPECT_EQ(pldm_capabilities_command_supported(&caps, 2, command),
+                  expected);
+        EXPECT_FALSE(pldm_capabilities_command_supported(&caps, 0, command));
+    }
+    EXPECT_FALSE(pldm_capabilities_command_supported(&caps, 64, 2));
+
+    // Dropping a type clears its commands
+    types[0].byte = 0x01;
+    pldm_capabilities_set_types(&caps, types.data());
+    EXPECT_FALSE(pldm_capabilities_command_supported(&caps, 2, 2));
+
+    pldm_discovery_record record{};
+    record.types[0].byte = 0x04;
+    record.versions[2] = version;
+    record.commands[2][0].byte = 0x04;
+    pldm_capabilities_from_discovery(&caps, &record);
+    EXPECT_EQ(caps.types, 0x04u);
+    EXPECT_TRUE(pldm_capabilities_command_supported(&caps, 2, 2));
+    EXPECT_FALSE(pldm_capabilities_command_supported(&caps, 2, 3));
+}
+
+TEST(CapabilityCache, testSaveLoad)
+{
+    std::array<uint8_t, PLDM_CAPABILITY_UID_SIZE> uid1{1, 2, 3};
+    std::array<uint8_t, PLDM_CAPABILITY_UID_SIZE> uid2{4, 5, 6};
+    std::array<uint8_t, PLDM_CAPABILITY_UID_SIZE> uid3{7, 8, 9};
+    pldm_capabilities caps1{};
+    caps1.types = 0x15;
+    caps1.commands[4][1] = 0x8000000000000001;
+    caps1.versions[4] = {0xf1, 0xf2, 0xf3, 0x61};
+    pldm_capabilities caps2{};
+    caps2.types = 0x01;
+    caps2.commands[0][0] = 0x3c;
+
+    auto cache = pldm_capability_cache_init();
+    EXPECT_EQ(pldm_capability_cache_get(cache, 9), nullptr);
+    pldm_capability_cache_set(cache, 9, uid1.data(), &caps1);
+    pldm_capability_cache_set(cache, 10, uid2.data(), &caps2);
+    pldm_capability_cache_set(cache, 11, uid3.data(), &caps2);
+    pldm_capability_cache_remove(cache, 11);
+    EXPECT_EQ(pldm_capability_cache_get(cache, 11), nullptr);
+    ASSERT_NE(pldm_capability_cache_get(cache, 9), nullptr);
+    EXPECT_TRUE(pldm_capabilities_command_supported(
+        pldm_capability_cache_get(cache, 9), 4, 127));
+
+    // Three types of the first terminus and one of the second
+    size_t size = pldm_capability_cache_saved_size(cache);
+    EXPECT_EQ(size, 8u + 2 * 24 + 4 * 36 + 4);
+    std::vector<uint8_t> data(size);
+    EXPECT_EQ(pldm_capability_cache_save(cache, data.data(), size - 1),
+              PLDM_ERROR_INVALID_LENGTH);
+    EXPECT_EQ(pldm_capability_cache_save(cache, data.data(), size),
+              PLDM_SUCCESS);
+    pldm_capability_cache_destroy(cache);
+
+    // A later boot: nothing is known by TID until a UID is bound
+    cache = pldm_capability_cache_init();
+    EXPECT_EQ(pldm_capability_cache_load(cache, data.data(), 4),
+              PLDM_ERROR_INVALID_LENGTH);
+    auto corrupt = data;
+    corrupt[20] ^= 1;
+    EXPECT_EQ(pldm_capability_cache_load(cache, corrupt.data(), size),
+              PLDM_ERROR_INVALID_DATA);
+    EXPECT_EQ(pldm_capability_cache_saved_size(cache), 12u);
+
+    EXPECT_EQ(pldm_capability_cache_load(cache, data.data(), size),
+              PLDM_SUCCESS);
+    EXPECT_EQ(pldm_capability_cache_get(cache, 9), nullptr);
+    EXPECT_EQ(pldm_capability_cache_bind(cache, uid3.data(), 20),
+              PLDM_ERROR_INVALID_DATA);
+    EXPECT_EQ(pldm_capability_cache_bind(cache, uid1.data(), 20),
+              PLDM_SUCCESS);
+    auto caps = pldm_capability_cache_get(cache, 20);
+    ASSERT_NE(caps, nullptr);
+    EXPECT_EQ(memcmp(caps, &caps1, sizeof(caps1)), 0);
+
+    // A UID already bound keeps its capabilities when loading again
+    pldm_capability_cache_set(cache, 20, uid1.data(), &caps2);
+    EXPECT_EQ(pldm_capability_cache_load(cache, data.data(), size),
+              PLDM_SUCCESS);
+    EXPECT_EQ(memcmp(pldm_capability_cache_get(cache, 20), &caps2,
+                     sizeof(caps2)),
+              0);
+
+    // Binding a UID to another TID moves it
+    EXPECT_EQ(pldm_capability_cache_bind(cache, uid2.data(), 20),
+              PLDM_SUCCESS);
+    EXPECT_EQ(pldm_capability_cache_bind(cache, uid2.data(), 21),
+              PLDM_SUCCESS);
+    EXPECT_EQ(pldm_capability_cache_get(cache, 20), nullptr);
+    EXPECT_EQ(memcmp(pldm_capability_cache_get(cache, 21), &caps2,
+                     sizeof(caps2)),
+              0);
+    pldm_capability_cache_destroy(cache);
+}
+
+TEST(MultipartVersion, testCompare)
+{
+    // 1.0, 1.0.0, 1.0.0a, 1.2, 1.10, 2.0
+    std::array<ver32_t, 6> ordered{
+        ver32_t{0xf1, 0xf0, 0xff, 0x00}, ver32_t{0xf1, 0xf0, 0xf0, 0x00},
+        ver32_t{0xf1, 0xf0, 0xf0, 'a'},  ver32_t{0xf1, 0xf2, 0xff, 0x00},
+        ver32_t{0xf1, 0x10, 0xff, 0x00}, ver32_t{0xf2, 0xf0, 0xff, 0x00}};
+    for (size_t i = 0; i < ordered.size(); ++i)
+    {
+        for (size_t j = 0; j < ordered.size(); ++j)
+        {
+            int cmp = pldm_ver32_compare(&ordered[i], &ordered[j]);
+            EXPECT_EQ(cmp < 0, i < j);
+            EXPECT_EQ(cmp == 0, i == j);
+        }
+    }
+    // One digit and two digit encodings of the same number
+    ver32_t one{0xf1, 0xf0, 0xf0, 0x00};
+    ver32_t oneBcd{0x01, 0x00, 0x00, 0x00};
+    EXPECT_EQ(pldm_ver32_compare(&one, &oneBcd), 0);
+
+    std::array<ver32_t, 3> ours{ordered[0], ordered[2], ordered[4]};
+    std::array<ver32_t, 4> theirs{ordered[0], ordered[1], ordered[2],
+                                  ordered[5]};
+    ver32_t common{};
+    EXPECT_EQ(pldm_version_highest_common(ours.data(), ours.size(),
+                                          theirs.data(), theirs.size(),
+                                          &common),
+              PLDM_SUCCESS);
+    EXPECT_EQ(memcmp(&common, &ordered[2], sizeof(common)), 0);
+    EXPECT_EQ(pldm_version_highest_common(ours.data() + 1, 1,
+                                          theirs.data() + 3, 1, &common),
+              PLDM_ERROR);
+    EXPECT_EQ(pldm_version_highest_common(nullptr, 0, theirs.data(),
+                                          theirs.size(), &common),
+              PLDM_ERROR);
+}
+
+TEST(MultipartVersion, testRoundTrip)
+{
+    std::vector<ver32_t> versions;
+    for (uint8_t minor = 0; minor < 20; ++minor)
+    {
+        versions.push_back(ver32_t{0xf1, dec2bcd8((minor * 7 + 3) % 20),
+                                   0xff, 0x00});
+    }
+
+    for (size_t partSize : {size_t(1), size_t(3), size_t(4), size_t(7),
+                            size_t(61), size_t(100)})
+    {
+        for (size_t maxVersions : {size_t(1), size_t(5), size_t(32)})
+        {
+            std::vector<ver32_t> kept(maxVersions);
+            pldm_version_reassembler reassembler;
+            pldm_version_reassembler_init(&reassembler, kept.data(),
+                                          kept.size());
+
+            bool complete = false;
+            size_t parts = 0;
+            while (!complete)
+            {
+                std::array<uint8_t, hdrSize + PLDM_GET_VERSION_REQ_BYTES>
+                    requestMsg{};
+                auto request = reinterpret_cast<pldm_msg*>(requestMsg.data());
+                ASSERT_EQ(pldm_version_reassembler_encode_req(
+                              &reassembler, 0, PLDM_BASE, request),
+                          PLDM_SUCCESS);
+                uint32_t handle = 0;
+                uint8_t opflag = 0;
+                uint8_t type = 0;
+                ASSERT_EQ(decode_get_version_req(request,
+                                                 PLDM_GET_VERSION_REQ_BYTES,
+                                                 &handle, &opflag, &type),
+                          PLDM_SUCCESS);
+
+                std::vector<uint8_t> responseMsg(hdrSize + 128);
+                auto response = reinterpret_cast<pldm_msg*>(responseMsg.data());
+                size_t length = 0;
+                ASSERT_EQ(encode_get_version_resp_multipart(
+                              0, versions.data(), versions.size(), handle,
+                              opflag,
+                              PLDM_GET_VERSION_RESP_FIXED_BYTES + partSize,
+                              response, &length),
+                          PLDM_SUCCESS);
+                uint8_t cc = 0;
+                ASSERT_EQ(pldm_version_reassembler_add(
+                              &reassembler, response, length, &cc, &complete),
+                          PLDM_SUCCESS);
+                EXPECT_EQ(cc, PLDM_SUCCESS);
+                ++parts;
+            }
+
+            size_t total = versions.size() * sizeof(ver32_t) + 4;
+            EXPECT_EQ(parts, (total + partSize - 1) / partSize);
+            size_t numKept = std::min(maxVersions, versions.size());
+            ASSERT_EQ(reassembler.num_versions, numKept);
+            EXPECT_EQ(reassembler.first.minor, versions[0].minor);
+            // The newest versions, oldest first
+            for (size_t i = 0; i < numKept; ++i)
+            {
+                EXPECT_EQ(kept[i].minor,
+                          dec2bcd8(versions.size() - numKept + i));
+            }
+        }
+    }
+}
+
+TEST(MultipartVersion, testErrors)
+{
+    std::array<ver32_t, 2> versions{ver32_t{0xf1, 0xf0, 0xf0, 0x00},
+                                    ver32_t{0xf1, 0xf1, 0xf0, 0x00}};
+    std::array<uint8_t, hdrSize + 64> responseMsg{};
+    auto response = reinterpret_cast<pldm_msg*>(responseMsg.data());
+    size_t length = 0;
+
+    EXPECT_EQ(encode_get_version_resp_multipart(
+                  0, versions.data(), 0, 0, PLDM_GET_FIRSTPART, 64, response,
+                  &length),
+              PLDM_ERROR_INVALID_DATA);
+    EXPECT_EQ(encode_get_version_resp_multipart(
+                  0, versions.data(), versions.size(), 0, PLDM_GET_FIRSTPART,
+                  PLDM_GET_VERSION_RESP_FIXED_BYTES, response, &length),
+              PLDM_ERROR_INVALID_LENGTH);
+
+    EXPECT_EQ(encode_get_version_resp_multipart(
+                  0, versions.data(), versions.size(), 0, 2, 64, response,
+                  &length),
+              PLDM_SUCCESS);
+    EXPECT_EQ(length, 1u);
+    EXPECT_EQ(response->payload[0], PLDM_INVALID_TRANSFER_OPERATION_FLAG);
+    for (uint32_t handle : {0u, 12u})
+    {
+        EXPECT_EQ(encode_get_version_resp_multipart(
+                      0, versions.data(), versions.size(), handle,
+                      PLDM_GET_NEXTPART, 64, response, &length),
+                  PLDM_SUCCESS);
+        EXPECT_EQ(length, 1u);
+        EXPECT_EQ(response->payload[0], PLDM_ERROR_INVALID_DATA);
+    }
+
+    ver32_t kept{};
+    pldm_version_reassembler reassembler;
+    uint8_t cc = 0;
+    bool complete = false;
+
+    // A completion code is passed on
+    pldm_version_reassembler_init(&reassembler, &kept, 1);
+    EXPECT_EQ(pldm_version_reassembler_add(&reassembler, response, length,
+                                           &cc, &complete),
+              PLDM_SUCCESS);
+    EXPECT_EQ(cc, PLDM_ERROR_INVALID_DATA);
+    EXPECT_FALSE(complete);
+
+    // A later part where the first was expected
+    EXPECT_EQ(encode_get_version_resp_multipart(
+                  0, versions.data(), versions.size(), 4, PLDM_GET_NEXTPART,
+                  PLDM_GET_VERSION_RESP_FIXED_BYTES + 4, response, &length),
+              PLDM_SUCCESS);
+    EXPECT_EQ(pldm_version_reassembler_add(&reassembler, response, length,
+                                           &cc, &complete),
+              PLDM_ERROR_INVALID_DATA);
+
+    // A bad CRC32
+    pldm_version_reassembler_init(&reassembler, &kept, 1);
+    EXPECT_EQ(encode_get_version_resp_multipart(
+                  0, versions.data(), versions.size(), 0, PLDM_GET_FIRSTPART,
+                  64, response, &length),
+              PLDM_SUCCESS);
+    EXPECT_EQ(length, PLDM_GET_VERSION_RESP_FIXED_BYTES + 12);
+    response->payload[length - 1] ^= 1;
+    EXPECT_EQ(pldm_version_reassembler_add(&reassembler, response, length,
+                                           &cc, &complete),
+              PLDM_ERROR_INVALID_DATA);
+    EXPECT_FALSE(complete);
+
+    // Data that is not a whole number of versions
+    pldm_version_reassembler_init(&reassembler, &kept, 1);
+    response->payload[length - 1] ^= 1;
+    EXPECT_EQ(pldm_version_reassembler_add(&reassembler, response, length - 1,
+                                           &cc, &complete),
+              PLDM_ERROR_INVALID_DATA);
+}
+
+TEST(ResponseTemplate, testEncode)
+{
+    std::array<bitfield8_t, 8> types{};
+    types[0].byte = 0x15;
+    std::array<uint8_t, hdrSize + PLDM_GET_TYPES_RESP_BYTES> encoded{};
+    auto encodedMsg = reinterpret_cast<pldm_msg*>(encoded.data());
+    ASSERT_EQ(encode_get_types_resp(0, PLDM_SUCCESS, types.data(), encodedMsg),
+              PLDM_SUCCESS);
+    auto tmpl =
+        pldm_response_template_init(encodedMsg, PLDM_GET_TYPES_RESP_BYTES);
+    ASSERT_NE(tmpl, nullptr);
+
+    std::array<uint8_t, hdrSize + PLDM_GET_TYPES_RESP_BYTES> responseMsg{};
+    auto response = reinterpret_cast<pldm_msg*>(responseMsg.data());
+    for (uint8_t instanceId = 0; instanceId < PLDM_INSTANCE_MAX; ++instanceId)
+    {
+        ASSERT_EQ(encode_get_types_resp(instanceId, PLDM_SUCCESS,
+                                        types.data(), encodedMsg),
+                  PLDM_SUCCESS);
+        responseMsg.fill(0xff);
+        size_t length = PLDM_GET_TYPES_RESP_BYTES;
+        ASSERT_EQ(pldm_response_template_encode(tmpl, instanceId, response,
+                                                &length),
+                  PLDM_SUCCESS);
+        EXPECT_EQ(length, PLDM_GET_TYPES_RESP_BYTES);
+        EXPECT_EQ(responseMsg, encoded);
+
+        std::array<iovec, 2> iov{};
+        uint8_t hdrByte = 0;
+        ASSERT_EQ(pldm_response_template_iov(tmpl, instanceId, &hdrByte,
+                                             iov.data()),
+                  PLDM_SUCCESS);
+        std::vector<uint8_t> gathered;
+        for (auto& part : iov)
+        {
+            auto base = static_cast<const uint8_t*>(part.iov_base);
+            gathered.insert(gathered.end(), base, base + part.iov_len);
+        }
+        EXPECT_THAT(gathered, ElementsAreArray(encoded));
+    }
+
+    size_t length = PLDM_GET_TYPES_RESP_BYTES - 1;
+    EXPECT_EQ(pldm_response_template_encode(tmpl, 0, response, &length),
+              PLDM_ERROR_INVALID_LENGTH);
+    length = PLDM_GET_TYPES_RESP_BYTES;
+    EXPECT_EQ(pldm_response_template_encode(tmpl, PLDM_INSTANCE_MAX, response,
+                                            &length),
+              PLDM_ERROR_INVALID_DATA);
+    pldm_response_template_destroy(tmpl);
+
+    // Only responses make templates
+    ASSERT_EQ(encode_get_types_req(0, encodedMsg), PLDM_SUCCESS);
+    EXPECT_EQ(pldm_response_template_init(encodedMsg, 0), nullptr);
+}
+
+TEST(ResponseTemplate, testHandler)
+{
+    std::array<uint8_t, hdrSize + PLDM_GET_TID_RESP_BYTES> encoded{};
+    auto encodedMsg = reinterpret_cast<pldm_msg*>(encoded.data());
+    ASSERT_EQ(encode_get_tid_resp(0, PLDM_SUCCESS, 9, encodedMsg),
+              PLDM_SUCCESS);
+    auto tmpl =
+        pldm_response_template_init(encodedMsg, PLDM_GET_TID_RESP_BYTES);
+
+    auto responder = pldm_responder_init();
+    ASSERT_EQ(pldm_responder_register(responder, PLDM_BASE, PLDM_GET_TID,
+                                      pldm_response_template_handler, tmpl),
+              PLDM_SUCCESS);
+
+    std::array<uint8_t, hdrSize> requestMsg{};
+    auto request = reinterpret_cast<pldm_msg*>(requestMsg.data());
+    std::array<uint8_t, hdrSize + PLDM_GET_TID_RESP_BYTES> responseMsg{};
+    auto response = reinterpret_cast<pldm_msg*>(responseMsg.data());
+    ASSERT_EQ(encode_get_tid_req(17, request), PLDM_SUCCESS);
+    size_t length = PLDM_GET_TID_RESP_BYTES;
+    ASSERT_EQ(
+        pldm_responder_dispatch(responder, request, 0, response, &length),
+        PLDM_SUCCESS);
+
+    uint8_t cc = 0;
+    uint8_t tid = 0;
+    EXPECT_EQ(response->hdr.instance_id, 17);
+    EXPECT_EQ(decode_get_tid_resp(response, length, &cc, &tid), PLDM_SUCCESS);
+    EXPECT_EQ(cc, PLDM_SUCCESS);
+    EXPECT_EQ(tid, 9);
+
+    pldm_responder_destroy(responder);
+    pldm_response_template_destroy(tmpl);
+}
+
 int main(int argc, char** argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
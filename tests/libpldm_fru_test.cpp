@@ -839,6 +839,1078 @@ TEST(SetFruRecordTable, testGoodDecodeResponse)
     ASSERT_EQ(nextDataTransferHandle, retNextDataTransferHandle);
 }
 
+TEST(FruTableIndex, testGetRecordByOption)
+{
+    // rsi 1 and 2, the second record of rsi 1 is appended last
+    std::vector<std::vector<uint8_t>> tlvs = {
+        {PLDM_FRU_FIELD_TYPE_NAME, 2, 'a', 'b', PLDM_FRU_FIELD_TYPE_SN, 1, '1'},
+        {PLDM_FRU_FIELD_TYPE_NAME, 1, 'c'},
+        {PLDM_FRU_FIELD_TYPE_SN, 3, '2', '3', '4', PLDM_FRU_FIELD_TYPE_NAME, 0},
+    };
+    std::vector<uint16_t> rsis = {1, 2, 1};
+    std::vector<uint8_t> numFields = {2, 1, 2};
+    constexpr size_t recordHdrSize = sizeof(pldm_fru_record_data_format) -
+                                     sizeof(pldm_fru_record_tlv);
+
+    std::vector<uint8_t> table;
+    size_t tableSize = 0;
+    auto index = pldm_fru_table_index_init();
+    for (size_t i = 0; i < tlvs.size(); ++i)
+    {
+        table.resize(tableSize + recordHdrSize + tlvs[i].size());
+        ASSERT_EQ(encode_fru_record(table.data(), table.size(), &tableSize,
+                                    rsis[i], PLDM_FRU_RECORD_TYPE_GENERAL,
+                                    numFields[i], PLDM_FRU_ENCODING_ASCII,
+                                    tlvs[i].data(), tlvs[i].size()),
+                  PLDM_SUCCESS);
+        ASSERT_EQ(pldm_fru_table_index_update(index, table.data(), tableSize),
+                  PLDM_SUCCESS);
+    }
+    EXPECT_EQ(pldm_fru_table_index_get_num_records(index), 3u);
+    EXPECT_EQ(pldm_fru_table_index_get_num_rsis(index), 2u);
+
+    struct
+    {
+        uint16_t rsi;
+        uint8_t rt;
+        uint8_t ft;
+    } options[] = {
+        {0, 0, 0},
+        {1, 0, 0},
+        {2, 0, 0},
+        {1, 0, PLDM_FRU_FIELD_TYPE_NAME},
+        {0, 0, PLDM_FRU_FIELD_TYPE_SN},
+        {1, PLDM_FRU_RECORD_TYPE_OEM, 0},
+        {3, 0, 0},
+    };
+    for (const auto& option : options)
+    {
+        std::array<uint8_t, 64> expected{};
+        size_t expectedSize = expected.size();
+        get_fru_record_by_option(table.data(), tableSize, expected.data(),
+                                 &expectedSize, option.rsi, option.rt,
+                                 option.ft);
+
+        std::array<uint8_t, 64> records{};
+        size_t recordsSize = records.size();
+        ASSERT_EQ(pldm_fru_table_index_get_record_by_option(
+                      index, table.data(), records.data(), &recordsSize,
+                      option.rsi, option.rt, option.ft),
+                  PLDM_SUCCESS);
+        ASSERT_EQ(recordsSize, expectedSize);
+        EXPECT_EQ(0, memcmp(records.data(), expected.data(), recordsSize));
+    }
+
+    std::array<uint8_t, recordHdrSize + 2> small{};
+    size_t smallSize = small.size();
+    EXPECT_EQ(pldm_fru_table_index_get_record_by_option(
+                  index, table.data(), small.data(), &smallSize, 1, 0, 0),
+              PLDM_ERROR_INVALID_LENGTH);
+
+    // A truncated record is left out of the index
+    table.push_back(0);
+    table.push_back(0);
+    EXPECT_EQ(pldm_fru_table_index_update(index, table.data(), table.size()),
+              PLDM_ERROR_INVALID_LENGTH);
+    EXPECT_EQ(pldm_fru_table_index_get_num_records(index), 3u);
+
+    // A smaller table is indexed from scratch
+    EXPECT_EQ(pldm_fru_table_index_update(
+                  index, table.data(), recordHdrSize + tlvs[0].size()),
+              PLDM_SUCCESS);
+    EXPECT_EQ(pldm_fru_table_index_get_num_records(index), 1u);
+    EXPECT_EQ(pldm_fru_table_index_get_num_rsis(index), 1u);
+
+    pldm_fru_table_index_destroy(index);
+}
+
+// Length and CRC32 of a FRU record table and its pad bytes
+static size_t paddedSize(size_t size)
+{
+    return (size + 3) / 4 * 4;
+}
+
+static uint32_t paddedCrc32(const uint8_t* data, size_t size)
+{
+    std::vector<uint8_t> padded(data, data + size);
+    padded.resize(paddedSize(size));
+    return crc32(padded.data(), padded.size());
+}
+
+TEST(FruTable, testBuild)
+{
+    auto table = pldm_fru_table_init();
+    const uint8_t name[] = {'a', 'b'};
+    const uint8_t sn[] = {'1'};
+
+    EXPECT_EQ(pldm_fru_table_add_field(table, PLDM_FRU_FIELD_TYPE_NAME, name,
+                                       sizeof(name)),
+              PLDM_ERROR_INVALID_DATA);
+
+    uint32_t maxSize{};
+    uint32_t length{};
+    uint16_t rsis{};
+    uint16_t records{};
+    uint32_t checksum{};
+    pldm_fru_table_get_metadata(table, &maxSize, &length, &rsis, &records,
+                                &checksum);
+    EXPECT_EQ(length, 0u);
+    EXPECT_EQ(records, 0u);
+    EXPECT_EQ(checksum, crc32(nullptr, 0));
+
+    ASSERT_EQ(pldm_fru_table_add_record(table, 1, PLDM_FRU_RECORD_TYPE_GENERAL,
+                                        PLDM_FRU_ENCODING_ASCII),
+              PLDM_SUCCESS);
+    ASSERT_EQ(pldm_fru_table_add_field(table, PLDM_FRU_FIELD_TYPE_NAME, name,
+                                       sizeof(name)),
+              PLDM_SUCCESS);
+    ASSERT_EQ(pldm_fru_table_add_field(table, PLDM_FRU_FIELD_TYPE_SN, sn,
+                                       sizeof(sn)),
+              PLDM_SUCCESS);
+    ASSERT_EQ(pldm_fru_table_add_record(table, 2, PLDM_FRU_RECORD_TYPE_GENERAL,
+                                        PLDM_FRU_ENCODING_ASCII),
+              PLDM_SUCCESS);
+    ASSERT_EQ(pldm_fru_table_add_field(table, PLDM_FRU_FIELD_TYPE_NAME, name,
+                                       1),
+              PLDM_SUCCESS);
+    ASSERT_EQ(pldm_fru_table_add_record(table, 1, PLDM_FRU_RECORD_TYPE_OEM,
+                                        PLDM_FRU_ENCODING_ASCII),
+              PLDM_SUCCESS);
+
+    // Same table, built with encode_fru_record()
+    std::vector<std::vector<uint8_t>> tlvs = {
+        {PLDM_FRU_FIELD_TYPE_NAME, 2, 'a', 'b', PLDM_FRU_FIELD_TYPE_SN, 1, '1'},
+        {PLDM_FRU_FIELD_TYPE_NAME, 1, 'a'},
+        {},
+    };
+    std::vector<uint16_t> expectedRsis = {1, 2, 1};
+    std::vector<uint8_t> types = {PLDM_FRU_RECORD_TYPE_GENERAL,
+                                  PLDM_FRU_RECORD_TYPE_GENERAL,
+                                  PLDM_FRU_RECORD_TYPE_OEM};
+    std::vector<uint8_t> numFields = {2, 1, 0};
+    constexpr size_t recordHdrSize = sizeof(pldm_fru_record_data_format) -
+                                     sizeof(pldm_fru_record_tlv);
+    std::vector<uint8_t> expected(3 * recordHdrSize + tlvs[0].size() +
+                                  tlvs[1].size());
+    size_t expectedSize = 0;
+    for (size_t i = 0; i < tlvs.size(); ++i)
+    {
+        auto record = reinterpret_cast<pldm_fru_record_data_format*>(
+            expected.data() + expectedSize);
+        record->record_set_id = htole16(expectedRsis[i]);
+        record->record_type = types[i];
+        record->num_fru_fields = numFields[i];
+        record->encoding_type = PLDM_FRU_ENCODING_ASCII;
+        expectedSize += recordHdrSize;
+        std::copy(tlvs[i].begin(), tlvs[i].end(),
+                  expected.begin() + expectedSize);
+        expectedSize += tlvs[i].size();
+    }
+
+    size_t size{};
+    auto data = pldm_fru_table_get_data(table, &size);
+    ASSERT_EQ(size, expected.size());
+    EXPECT_EQ(0, memcmp(data, expected.data(), size));
+
+    pldm_fru_table_get_metadata(table, &maxSize, &length, &rsis, &records,
+                                &checksum);
+    EXPECT_EQ(maxSize, 0u);
+    EXPECT_EQ(length, paddedSize(expected.size()));
+    EXPECT_NE(length, expected.size());
+    EXPECT_EQ(rsis, 2u);
+    EXPECT_EQ(records, 3u);
+    EXPECT_EQ(checksum, paddedCrc32(expected.data(), expected.size()));
+
+    // Growing the last record keeps the metadata up to date
+    std::vector<uint8_t> big(255, 'x');
+    ASSERT_EQ(pldm_fru_table_add_field(table, PLDM_FRU_FIELD_TYPE_DESC,
+                                       big.data(), big.size()),
+              PLDM_SUCCESS);
+    data = pldm_fru_table_get_data(table, &size);
+    pldm_fru_table_get_metadata(table, &maxSize, &length, &rsis, &records,
+                                &checksum);
+    EXPECT_EQ(length, paddedSize(size));
+    EXPECT_EQ(records, 3u);
+    EXPECT_EQ(checksum, paddedCrc32(data, size));
+
+    // The maximum size is what SetFRURecordTable accepts, not the largest
+    // record
+    EXPECT_EQ(maxSize, 0u);
+    pldm_fru_table_set_maximum_size(table, 1024);
+    pldm_fru_table_get_metadata(table, &maxSize, &length, &rsis, &records,
+                                &checksum);
+    EXPECT_EQ(maxSize, 1024u);
+
+    pldm_fru_table_destroy(table);
+}
+
+TEST(FruTable, testSetField)
+{
+    auto table = pldm_fru_table_init();
+    const uint8_t name[] = {'a', 'b'};
+    const uint8_t tag[] = {'t', 'a', 'g'};
+    for (uint16_t rsi = 1; rsi <= 3; ++rsi)
+    {
+        ASSERT_EQ(pldm_fru_table_add_record(table, rsi,
+                                            PLDM_FRU_RECORD_TYPE_GENERAL,
+                                            PLDM_FRU_ENCODING_ASCII),
+                  PLDM_SUCCESS);
+        ASSERT_EQ(pldm_fru_table_add_field(table, PLDM_FRU_FIELD_TYPE_NAME,
+                                           name, sizeof(name)),
+                  PLDM_SUCCESS);
+        ASSERT_EQ(pldm_fru_table_add_field(table, PLDM_FRU_FIELD_TYPE_ASSET_TAG,
+                                           tag, sizeof(tag)),
+                  PLDM_SUCCESS);
+    }
+
+    auto checkMetadata = [table]() {
+        size_t size{};
+        auto data = pldm_fru_table_get_data(table, &size);
+        uint32_t maxSize{};
+        uint32_t length{};
+        uint16_t rsis{};
+        uint16_t records{};
+        uint32_t checksum{};
+        pldm_fru_table_get_metadata(table, &maxSize, &length, &rsis, &records,
+                                    &checksum);
+        EXPECT_EQ(maxSize, 0u);
+        EXPECT_EQ(length, paddedSize(size));
+        EXPECT_EQ(rsis, 3u);
+        EXPECT_EQ(records, 3u);
+        EXPECT_EQ(checksum, paddedCrc32(data, size));
+    };
+    checkMetadata();
+
+    // Same length, in a complete record and in the last one
+    const uint8_t newTag[] = {'T', 'A', 'G'};
+    EXPECT_EQ(pldm_fru_table_set_field(table, 1, PLDM_FRU_FIELD_TYPE_ASSET_TAG,
+                                       newTag, sizeof(newTag)),
+              PLDM_SUCCESS);
+    checkMetadata();
+    EXPECT_EQ(pldm_fru_table_set_field(table, 2, PLDM_FRU_FIELD_TYPE_NAME,
+                                       newTag, 2),
+              PLDM_SUCCESS);
+    checkMetadata();
+    EXPECT_EQ(pldm_fru_table_set_field(table, 3, PLDM_FRU_FIELD_TYPE_ASSET_TAG,
+                                       newTag, sizeof(newTag)),
+              PLDM_SUCCESS);
+    checkMetadata();
+
+    // Longer, then shorter
+    const uint8_t longTag[] = {'l', 'o', 'n', 'g', ' ', 't', 'a', 'g'};
+    EXPECT_EQ(pldm_fru_table_set_field(table, 1, PLDM_FRU_FIELD_TYPE_ASSET_TAG,
+                                       longTag, sizeof(longTag)),
+              PLDM_SUCCESS);
+    checkMetadata();
+    EXPECT_EQ(pldm_fru_table_set_field(table, 1, PLDM_FRU_FIELD_TYPE_NAME,
+                                       nullptr, 0),
+              PLDM_SUCCESS);
+    checkMetadata();
+    EXPECT_EQ(pldm_fru_table_set_field(table, 1, PLDM_FRU_FIELD_TYPE_ASSET_TAG,
+                                       tag, sizeof(tag)),
+              PLDM_SUCCESS);
+    checkMetadata();
+    EXPECT_EQ(pldm_fru_table_set_field(table, 3, PLDM_FRU_FIELD_TYPE_ASSET_TAG,
+                                       longTag, sizeof(longTag)),
+              PLDM_SUCCESS);
+    checkMetadata();
+
+    // Fields after a resized one are still found
+    EXPECT_EQ(pldm_fru_table_set_field(table, 2, PLDM_FRU_FIELD_TYPE_ASSET_TAG,
+                                       newTag, sizeof(newTag)),
+              PLDM_SUCCESS);
+    checkMetadata();
+
+    size_t size{};
+    auto data = pldm_fru_table_get_data(table, &size);
+    std::vector<uint8_t> expected = {
+        1, 0, PLDM_FRU_RECORD_TYPE_GENERAL, 2, PLDM_FRU_ENCODING_ASCII,
+        PLDM_FRU_FIELD_TYPE_NAME, 0, PLDM_FRU_FIELD_TYPE_ASSET_TAG, 3, 't',
+        'a', 'g',
+        2, 0, PLDM_FRU_RECORD_TYPE_GENERAL, 2, PLDM_FRU_ENCODING_ASCII,
+        PLDM_FRU_FIELD_TYPE_NAME, 2, 'T', 'A', PLDM_FRU_FIELD_TYPE_ASSET_TAG, 3,
+        'T', 'A', 'G',
+        3, 0, PLDM_FRU_RECORD_TYPE_GENERAL, 2, PLDM_FRU_ENCODING_ASCII,
+        PLDM_FRU_FIELD_TYPE_NAME, 2, 'a', 'b', PLDM_FRU_FIELD_TYPE_ASSET_TAG, 8,
+        'l', 'o', 'n', 'g', ' ', 't', 'a', 'g'};
+    ASSERT_EQ(size, expected.size());
+    EXPECT_EQ(0, memcmp(data, expected.data(), size));
+
+    EXPECT_EQ(pldm_fru_table_set_field(table, 4, PLDM_FRU_FIELD_TYPE_NAME,
+                                       name, sizeof(name)),
+              PLDM_ERROR_INVALID_DATA);
+    EXPECT_EQ(pldm_fru_table_set_field(table, 1, PLDM_FRU_FIELD_TYPE_SN, name,
+                                       sizeof(name)),
+              PLDM_ERROR_INVALID_DATA);
+
+    pldm_fru_table_destroy(table);
+}
+
+TEST(FruTableTransfer, testMultipart)
+{
+    std::vector<uint8_t> table(21);
+    for (size_t i = 0; i < table.size(); ++i)
+    {
+        table[i] = i;
+    }
+    auto checksum = crc32(table.data(), table.size());
+
+    pldm_fru_table_transfer transfer{};
+    EXPECT_EQ(pldm_fru_table_transfer_init(&transfer, table.data(),
+                                           table.size(), checksum, 7),
+              PLDM_ERROR_INVALID_LENGTH);
+    ASSERT_EQ(pldm_fru_table_transfer_init(&transfer, table.data(),
+                                           table.size(), checksum, 8),
+              PLDM_SUCCESS);
+
+    std::array<uint8_t, sizeof(pldm_msg_hdr) +
+                            sizeof(pldm_get_fru_record_table_req)>
+        requestMsg{};
+    auto request = reinterpret_cast<pldm_msg*>(requestMsg.data());
+    std::array<uint8_t, sizeof(pldm_msg_hdr) +
+                            PLDM_GET_FRU_RECORD_TABLE_MIN_RESP_BYTES>
+        responseMsg{};
+    auto response = reinterpret_cast<pldm_msg*>(responseMsg.data());
+    auto resp =
+        reinterpret_cast<pldm_get_fru_record_table_resp*>(response->payload);
+
+    std::vector<uint8_t> received;
+    std::vector<uint8_t> flags;
+    uint32_t handle = 0;
+    uint8_t op = PLDM_GET_FIRSTPART;
+    variable_field data{};
+    variable_field trailer{};
+    do
+    {
+        ASSERT_EQ(encode_get_fru_record_table_req(
+                      0, handle, op, request,
+                      sizeof(pldm_get_fru_record_table_req)),
+                  PLDM_SUCCESS);
+        ASSERT_EQ(pldm_fru_table_transfer_encode_resp(
+                      &transfer, 1, request,
+                      sizeof(pldm_get_fru_record_table_req), response, &data,
+                      &trailer),
+                  PLDM_SUCCESS);
+        ASSERT_EQ(resp->completion_code, PLDM_SUCCESS);
+        EXPECT_EQ(response->hdr.instance_id, 1u);
+        EXPECT_EQ(response->hdr.command, PLDM_GET_FRU_RECORD_TABLE);
+        EXPECT_LE(data.length + trailer.length, 8u);
+        EXPECT_GT(data.length, 0u);
+        // The data points into the table
+        EXPECT_EQ(data.ptr, table.data() + received.size());
+        received.insert(received.end(), data.ptr, data.ptr + data.length);
+        flags.push_back(resp->transfer_flag);
+        handle = le32toh(resp->next_data_transfer_handle);
+        EXPECT_EQ(handle, resp->transfer_flag == PLDM_END ? 0 : received.size());
+        op = PLDM_GET_NEXTPART;
+    } while (resp->transfer_flag != PLDM_END);
+
+    EXPECT_EQ(received, table);
+    EXPECT_EQ(flags.front(), PLDM_START);
+    EXPECT_EQ(flags.size(), 4u);
+    EXPECT_EQ(flags[1], PLDM_MIDDLE);
+    std::array<uint8_t, 7> expectedTrailer{};
+    uint32_t leChecksum = htole32(checksum);
+    memcpy(expectedTrailer.data() + 3, &leChecksum, sizeof(leChecksum));
+    ASSERT_EQ(trailer.length, expectedTrailer.size());
+    EXPECT_EQ(0, memcmp(trailer.ptr, expectedTrailer.data(), trailer.length));
+
+    // No transfer in progress any more
+    ASSERT_EQ(encode_get_fru_record_table_req(
+                  0, 8, PLDM_GET_NEXTPART, request,
+                  sizeof(pldm_get_fru_record_table_req)),
+              PLDM_SUCCESS);
+    ASSERT_EQ(pldm_fru_table_transfer_encode_resp(
+                  &transfer, 1, request, sizeof(pldm_get_fru_record_table_req),
+                  response, &data, &trailer),
+              PLDM_SUCCESS);
+    EXPECT_EQ(resp->completion_code, PLDM_FRU_INVALID_DATA_TRANSFER_HANDLE);
+    EXPECT_EQ(data.length + trailer.length, 0u);
+
+    ASSERT_EQ(encode_get_fru_record_table_req(
+                  0, 0, 2, request, sizeof(pldm_get_fru_record_table_req)),
+              PLDM_SUCCESS);
+    ASSERT_EQ(pldm_fru_table_transfer_encode_resp(
+                  &transfer, 1, request, sizeof(pldm_get_fru_record_table_req),
+                  response, &data, &trailer),
+              PLDM_SUCCESS);
+    EXPECT_EQ(resp->completion_code, PLDM_FRU_INVALID_TRANSFER_OPERATION_FLAG);
+
+    // Everything in a single part
+    ASSERT_EQ(pldm_fru_table_transfer_init(&transfer, table.data(), 20,
+                                           checksum, 64),
+              PLDM_SUCCESS);
+    ASSERT_EQ(encode_get_fru_record_table_req(
+                  0, 0, PLDM_GET_FIRSTPART, request,
+                  sizeof(pldm_get_fru_record_table_req)),
+              PLDM_SUCCESS);
+    ASSERT_EQ(pldm_fru_table_transfer_encode_resp(
+                  &transfer, 1, request, sizeof(pldm_get_fru_record_table_req),
+                  response, &data, &trailer),
+              PLDM_SUCCESS);
+    EXPECT_EQ(resp->transfer_flag, PLDM_START_AND_END);
+    EXPECT_EQ(data.length, 20u);
+    EXPECT_EQ(trailer.length, FRU_TABLE_CHECKSUM_SIZE);
+}
+
+TEST(FruTableIndex, testEncodeRecordByOptionResp)
+{
+    std::vector<std::vector<uint8_t>> tlvs = {
+        {PLDM_FRU_FIELD_TYPE_NAME, 2, 'a', 'b', PLDM_FRU_FIELD_TYPE_SN, 1, '1'},
+        {PLDM_FRU_FIELD_TYPE_NAME, 1, 'c'},
+        {PLDM_FRU_FIELD_TYPE_SN, 3, '2', '3', '4', PLDM_FRU_FIELD_TYPE_NAME, 0},
+    };
+    std::vector<uint16_t> rsis = {1, 2, 1};
+    std::vector<uint8_t> numFields = {2, 1, 2};
+    constexpr size_t recordHdrSize = sizeof(pldm_fru_record_data_format) -
+                                     sizeof(pldm_fru_record_tlv);
+
+    std::vector<uint8_t> table;
+    size_t tableSize = 0;
+    auto index = pldm_fru_table_index_init();
+    for (size_t i = 0; i < tlvs.size(); ++i)
+    {
+        table.resize(tableSize + recordHdrSize + tlvs[i].size());
+        ASSERT_EQ(encode_fru_record(table.data(), table.size(), &tableSize,
+                                    rsis[i], PLDM_FRU_RECORD_TYPE_GENERAL,
+                                    numFields[i], PLDM_FRU_ENCODING_ASCII,
+                                    tlvs[i].data(), tlvs[i].size()),
+                  PLDM_SUCCESS);
+        ASSERT_EQ(pldm_fru_table_index_update(index, table.data(), tableSize),
+                  PLDM_SUCCESS);
+    }
+
+    struct
+    {
+        uint16_t rsi;
+        uint8_t rt;
+        uint8_t ft;
+    } options[] = {
+        {0, 0, 0},
+        {1, 0, 0},
+        {2, 0, 0},
+        {1, 0, PLDM_FRU_FIELD_TYPE_NAME},
+        {0, 0, PLDM_FRU_FIELD_TYPE_SN},
+        {1, PLDM_FRU_RECORD_TYPE_OEM, 0},
+        {3, 0, 0},
+    };
+    std::array<uint8_t, sizeof(pldm_msg_hdr) + 64> responseMsg{};
+    auto response = reinterpret_cast<pldm_msg*>(responseMsg.data());
+    auto resp = reinterpret_cast<pldm_get_fru_record_by_option_resp*>(
+        response->payload);
+    for (const auto& option : options)
+    {
+        std::array<uint8_t, 64> expected{};
+        size_t expectedSize = expected.size();
+        get_fru_record_by_option(table.data(), tableSize, expected.data(),
+                                 &expectedSize, option.rsi, option.rt,
+                                 option.ft);
+
+        // Each part holds at least a record header or the longest field
+        for (size_t dataSize : {7, 9, 20, 64 - 6})
+        {
+            std::vector<uint8_t> records;
+            uint8_t transferOpFlag = PLDM_GET_FIRSTPART;
+            uint32_t handle = 0;
+            bool done = false;
+            for (size_t parts = 0; !done && parts < expected.size(); ++parts)
+            {
+                size_t payloadLength =
+                    PLDM_GET_FRU_RECORD_BY_OPTION_MIN_RESP_BYTES + dataSize;
+                ASSERT_EQ(pldm_fru_table_index_encode_record_by_option_resp(
+                              index, table.data(), 0, handle, transferOpFlag,
+                              option.rsi, option.rt, option.ft, response,
+                              &payloadLength),
+                          PLDM_SUCCESS);
+                ASSERT_EQ(resp->completion_code, PLDM_SUCCESS);
+                ASSERT_GE(payloadLength,
+                          PLDM_GET_FRU_RECORD_BY_OPTION_MIN_RESP_BYTES);
+                records.insert(records.end(), resp->fru_structure_data,
+                               response->payload + payloadLength);
+
+                bool first = transferOpFlag == PLDM_GET_FIRSTPART;
+                done = resp->transfer_flag == PLDM_END ||
+                       resp->transfer_flag == PLDM_START_AND_END;
+                EXPECT_EQ(first, resp->transfer_flag == PLDM_START ||
+                                     resp->transfer_flag == PLDM_START_AND_END);
+                handle = le32toh(resp->next_data_transfer_handle);
+                transferOpFlag = PLDM_GET_NEXTPART;
+            }
+            ASSERT_TRUE(done);
+            EXPECT_EQ(handle, 0u);
+            EXPECT_EQ(records, std::vector<uint8_t>(expected.begin(),
+                                                    expected.begin() +
+                                                        expectedSize));
+        }
+    }
+
+    // Too small for the first record header
+    size_t payloadLength = PLDM_GET_FRU_RECORD_BY_OPTION_MIN_RESP_BYTES + 4;
+    EXPECT_EQ(pldm_fru_table_index_encode_record_by_option_resp(
+                  index, table.data(), 0, 0, PLDM_GET_FIRSTPART, 0, 0, 0,
+                  response, &payloadLength),
+              PLDM_ERROR_INVALID_LENGTH);
+
+    // A cursor past the last record
+    payloadLength = PLDM_GET_FRU_RECORD_BY_OPTION_MIN_RESP_BYTES + 64 - 6;
+    EXPECT_EQ(pldm_fru_table_index_encode_record_by_option_resp(
+                  index, table.data(), 0, 3 << 8, PLDM_GET_NEXTPART, 0, 0, 0,
+                  response, &payloadLength),
+              PLDM_SUCCESS);
+    EXPECT_EQ(resp->completion_code, PLDM_FRU_INVALID_DATA_TRANSFER_HANDLE);
+    EXPECT_EQ(payloadLength, 1u);
+
+    // A cursor to a record of another record set
+    payloadLength = PLDM_GET_FRU_RECORD_BY_OPTION_MIN_RESP_BYTES + 64 - 6;
+    EXPECT_EQ(pldm_fru_table_index_encode_record_by_option_resp(
+                  index, table.data(), 0, 1 << 8, PLDM_GET_NEXTPART, 1, 0, 0,
+                  response, &payloadLength),
+              PLDM_SUCCESS);
+    EXPECT_EQ(resp->completion_code, PLDM_FRU_INVALID_DATA_TRANSFER_HANDLE);
+
+    // A cursor to the second field of a record of another record type
+    payloadLength = PLDM_GET_FRU_RECORD_BY_OPTION_MIN_RESP_BYTES + 64 - 6;
+    EXPECT_EQ(pldm_fru_table_index_encode_record_by_option_resp(
+                  index, table.data(), 0, 2, PLDM_GET_NEXTPART, 1,
+                  PLDM_FRU_RECORD_TYPE_OEM, 0, response, &payloadLength),
+              PLDM_SUCCESS);
+    EXPECT_EQ(resp->completion_code, PLDM_FRU_INVALID_DATA_TRANSFER_HANDLE);
+    EXPECT_EQ(payloadLength, 1u);
+
+    payloadLength = PLDM_GET_FRU_RECORD_BY_OPTION_MIN_RESP_BYTES + 64 - 6;
+    EXPECT_EQ(pldm_fru_table_index_encode_record_by_option_resp(
+                  index, table.data(), 0, 0, 2, 0, 0, 0, response,
+                  &payloadLength),
+              PLDM_SUCCESS);
+    EXPECT_EQ(resp->completion_code, PLDM_FRU_INVALID_TRANSFER_OPERATION_FLAG);
+
+    pldm_fru_table_index_destroy(index);
+}
+
+TEST(FruTableReceiver, testMultipart)
+{
+    auto source = pldm_fru_table_init();
+    const uint8_t name[] = {'b', 'o', 'a', 'r', 'd'};
+    const uint8_t sn[] = {'1', '2'};
+    ASSERT_EQ(pldm_fru_table_add_record(source, 1, PLDM_FRU_RECORD_TYPE_GENERAL,
+                                        PLDM_FRU_ENCODING_ASCII),
+              PLDM_SUCCESS);
+    ASSERT_EQ(pldm_fru_table_add_field(source, PLDM_FRU_FIELD_TYPE_NAME, name,
+                                       sizeof(name)),
+              PLDM_SUCCESS);
+    ASSERT_EQ(pldm_fru_table_add_field(source, PLDM_FRU_FIELD_TYPE_SN, sn,
+                                       sizeof(sn)),
+              PLDM_SUCCESS);
+    ASSERT_EQ(pldm_fru_table_add_record(source, 2, PLDM_FRU_RECORD_TYPE_OEM,
+                                        PLDM_FRU_ENCODING_ASCII),
+              PLDM_SUCCESS);
+
+    size_t size;
+    auto data = pldm_fru_table_get_data(source, &size);
+    std::vector<uint8_t> table(data, data + size);
+    uint32_t maxSize, length, checksum;
+    uint16_t rsis, records;
+    pldm_fru_table_get_metadata(source, &maxSize, &length, &rsis, &records,
+                                &checksum);
+    // 3 pad bytes, covered by the checksum
+    ASSERT_EQ(table.size() % 4, 1u);
+    ASSERT_EQ(checksum, paddedCrc32(table.data(), table.size()));
+    auto makeStream = [&table](uint32_t crc) {
+        std::vector<uint8_t> stream(table);
+        stream.resize(stream.size() + 3);
+        crc = htole32(crc);
+        stream.insert(stream.end(), reinterpret_cast<uint8_t*>(&crc),
+                      reinterpret_cast<uint8_t*>(&crc) + sizeof(crc));
+        return stream;
+    };
+    auto stream = makeStream(checksum);
+
+    std::vector<uint8_t> requestMsg(sizeof(pldm_msg_hdr) +
+                                    sizeof(pldm_set_fru_record_table_req) +
+                                    stream.size());
+    auto request = reinterpret_cast<pldm_msg*>(requestMsg.data());
+    std::array<uint8_t, sizeof(pldm_msg_hdr) +
+                            sizeof(pldm_set_fru_record_table_resp)>
+        responseMsg{};
+    auto response = reinterpret_cast<pldm_msg*>(responseMsg.data());
+    auto resp =
+        reinterpret_cast<pldm_set_fru_record_table_resp*>(response->payload);
+
+    // Send parts of the stream, returning the completion code of the last
+    auto send = [&](pldm_fru_table_receiver* receiver,
+                    const std::vector<uint8_t>& parts, size_t partSize) {
+        uint32_t handle = 0;
+        for (size_t offset = 0; offset < parts.size(); offset += partSize)
+        {
+            size_t len = std::min(partSize, parts.size() - offset);
+            bool first = offset == 0;
+            bool last = offset + len == parts.size();
+            uint8_t flag = first ? (last ? PLDM_START_AND_END : PLDM_START)
+                                 : (last ? PLDM_END : PLDM_MIDDLE);
+            variable_field part{parts.data() + offset, len};
+            size_t payloadLength = sizeof(pldm_set_fru_record_table_req) + len;
+            EXPECT_EQ(encode_set_fru_record_table_req(0, handle, flag, &part,
+                                                      request, payloadLength),
+                      PLDM_SUCCESS);
+            EXPECT_EQ(pldm_fru_table_receiver_recv(receiver, 0, request,
+                                                   payloadLength, response),
+                      PLDM_SUCCESS);
+            EXPECT_EQ(response->hdr.command, PLDM_SET_FRU_RECORD_TABLE);
+            if (resp->completion_code != PLDM_SUCCESS)
+            {
+                return resp->completion_code;
+            }
+            handle = le32toh(resp->next_data_transfer_handle);
+            EXPECT_EQ(handle, last ? 0 : offset + len);
+        }
+        return resp->completion_code;
+    };
+
+    // A checksum of the records alone is accepted too
+    auto unpaddedStream = makeStream(crc32(table.data(), table.size()));
+    for (size_t partSize : {1, 3, 8, 64, 100})
+    {
+        auto dest = pldm_fru_table_init();
+        ASSERT_EQ(pldm_fru_table_add_record(dest, 3,
+                                            PLDM_FRU_RECORD_TYPE_GENERAL,
+                                            PLDM_FRU_ENCODING_ASCII),
+                  PLDM_SUCCESS);
+        pldm_fru_table_set_maximum_size(dest, table.size());
+        auto receiver = pldm_fru_table_receiver_init(dest);
+        EXPECT_EQ(send(receiver, partSize == 100 ? unpaddedStream : stream,
+                       partSize),
+                  PLDM_SUCCESS);
+
+        data = pldm_fru_table_get_data(dest, &size);
+        EXPECT_EQ(std::vector<uint8_t>(data, data + size), table);
+        uint32_t destMaxSize, destLength, destChecksum;
+        uint16_t destRsis, destRecords;
+        pldm_fru_table_get_metadata(dest, &destMaxSize, &destLength, &destRsis,
+                                    &destRecords, &destChecksum);
+        EXPECT_EQ(destMaxSize, table.size());
+        EXPECT_EQ(destLength, length);
+        EXPECT_EQ(destRsis, rsis);
+        EXPECT_EQ(destRecords, records);
+        EXPECT_EQ(destChecksum, checksum);
+
+        // The received table is indexed
+        const uint8_t newSn[] = {'4', '5', '6'};
+        EXPECT_EQ(pldm_fru_table_set_field(dest, 1, PLDM_FRU_FIELD_TYPE_SN,
+                                           newSn, sizeof(newSn)),
+                  PLDM_SUCCESS);
+
+        pldm_fru_table_receiver_destroy(receiver);
+        pldm_fru_table_destroy(dest);
+    }
+
+    // SetFRURecordTable is not supported by a table without a maximum size,
+    // and tables larger than it are refused
+    auto dest = pldm_fru_table_init();
+    auto receiver = pldm_fru_table_receiver_init(dest);
+    EXPECT_EQ(send(receiver, stream, 8), PLDM_ERROR_UNSUPPORTED_PLDM_CMD);
+    pldm_fru_table_set_maximum_size(dest, table.size() - 1);
+    EXPECT_EQ(send(receiver, stream, 8), PLDM_ERROR_INVALID_LENGTH);
+    EXPECT_EQ(send(receiver, stream, stream.size()),
+              PLDM_ERROR_INVALID_LENGTH);
+    data = pldm_fru_table_get_data(dest, &size);
+    EXPECT_EQ(size, 0u);
+    pldm_fru_table_set_maximum_size(dest, table.size());
+
+    auto corrupt = stream;
+    corrupt[6] ^= 1;
+    EXPECT_EQ(send(receiver, corrupt, 8),
+              PLDM_FRU_INVALID_DATA_INTEGRITY_CHECK);
+    data = pldm_fru_table_get_data(dest, &size);
+    EXPECT_EQ(size, 0u);
+
+    // A field runs into the checksum
+    auto truncated = stream;
+    truncated.erase(truncated.begin() + 6, truncated.begin() + 10);
+    EXPECT_EQ(send(receiver, truncated, 8), PLDM_ERROR_INVALID_DATA);
+
+    // A nonzero pad byte, under a checksum of the records alone
+    auto badPad = makeStream(crc32(table.data(), table.size()));
+    badPad[table.size() + 1] = 0xff;
+    EXPECT_EQ(send(receiver, badPad, 8), PLDM_ERROR_INVALID_DATA);
+    data = pldm_fru_table_get_data(dest, &size);
+    EXPECT_EQ(size, 0u);
+
+    // Out of sequence
+    variable_field part{stream.data(), 8};
+    size_t payloadLength = sizeof(pldm_set_fru_record_table_req) + 8;
+    ASSERT_EQ(encode_set_fru_record_table_req(0, 0, PLDM_MIDDLE, &part,
+                                              request, payloadLength),
+              PLDM_SUCCESS);
+    ASSERT_EQ(pldm_fru_table_receiver_recv(receiver, 0, request,
+                                           payloadLength, response),
+              PLDM_SUCCESS);
+    EXPECT_EQ(resp->completion_code, PLDM_FRU_INVALID_TRANSFER_FLAG);
+    ASSERT_EQ(encode_set_fru_record_table_req(0, 0, PLDM_START, &part,
+                                              request, payloadLength),
+              PLDM_SUCCESS);
+    ASSERT_EQ(pldm_fru_table_receiver_recv(receiver, 0, request,
+                                           payloadLength, response),
+              PLDM_SUCCESS);
+    EXPECT_EQ(resp->completion_code, PLDM_SUCCESS);
+    ASSERT_EQ(encode_set_fru_record_table_req(0, 4, PLDM_END, &part, request,
+                                              payloadLength),
+              PLDM_SUCCESS);
+    ASSERT_EQ(pldm_fru_table_receiver_recv(receiver, 0, request,
+                                           payloadLength, response),
+              PLDM_SUCCESS);
+    EXPECT_EQ(resp->completion_code, PLDM_FRU_INVALID_DATA_TRANSFER_HANDLE);
+
+    pldm_fru_table_receiver_destroy(receiver);
+    pldm_fru_table_destroy(dest);
+    pldm_fru_table_destroy(source);
+}
+
+TEST(FruRecordIter, testIterate)
+{
+    std::vector<uint8_t> table = {
+        0x01, 0x00, PLDM_FRU_RECORD_TYPE_GENERAL, 2, PLDM_FRU_ENCODING_ASCII,
+        PLDM_FRU_FIELD_TYPE_NAME, 2, 'a', 'b', PLDM_FRU_FIELD_TYPE_SN, 0,
+        0x02, 0x01, PLDM_FRU_RECORD_TYPE_OEM, 1, PLDM_FRU_ENCODING_ASCII,
+        PLDM_FRU_FIELD_TYPE_VERSION, 1, 'c'};
+
+    struct pldm_fru_record_iter records;
+    struct pldm_fru_record_view record;
+    struct pldm_fru_field_iter fields;
+    struct pldm_fru_field_view field;
+    ASSERT_TRUE(
+        pldm_fru_record_iter_init(&records, table.data(), table.size()));
+
+    ASSERT_TRUE(pldm_fru_record_iter_next(&records, &record));
+    EXPECT_EQ(record.record_set_id, 1);
+    EXPECT_EQ(record.record_type, PLDM_FRU_RECORD_TYPE_GENERAL);
+    EXPECT_EQ(record.num_fru_fields, 2);
+    EXPECT_EQ(record.encoding_type, PLDM_FRU_ENCODING_ASCII);
+    pldm_fru_field_iter_init(&fields, &record);
+    ASSERT_TRUE(pldm_fru_field_iter_next(&fields, &field));
+    EXPECT_EQ(field.type, PLDM_FRU_FIELD_TYPE_NAME);
+    EXPECT_EQ(field.length, 2);
+    EXPECT_EQ(field.value, &table[7]);
+    ASSERT_TRUE(pldm_fru_field_iter_next(&fields, &field));
+    EXPECT_EQ(field.type, PLDM_FRU_FIELD_TYPE_SN);
+    EXPECT_EQ(field.length, 0);
+    EXPECT_FALSE(pldm_fru_field_iter_next(&fields, &field));
+
+    ASSERT_TRUE(pldm_fru_record_iter_next(&records, &record));
+    EXPECT_EQ(record.record_set_id, 0x102);
+    EXPECT_EQ(record.record_type, PLDM_FRU_RECORD_TYPE_OEM);
+    pldm_fru_field_iter_init(&fields, &record);
+    ASSERT_TRUE(pldm_fru_field_iter_next(&fields, &field));
+    EXPECT_EQ(field.type, PLDM_FRU_FIELD_TYPE_VERSION);
+    EXPECT_EQ(field.value[0], 'c');
+    EXPECT_FALSE(pldm_fru_field_iter_next(&fields, &field));
+    EXPECT_FALSE(pldm_fru_record_iter_next(&records, &record));
+
+    std::array<uint8_t, 64> selected{};
+    size_t selectedSize = selected.size();
+    EXPECT_EQ(get_fru_record_by_option(table.data(), table.size(),
+                                       selected.data(), &selectedSize, 0, 0,
+                                       0),
+              PLDM_SUCCESS);
+    EXPECT_EQ(selectedSize, table.size());
+
+    // Truncated in a record header, a field header and a field value
+    for (size_t size : {3, 10, 18})
+    {
+        EXPECT_FALSE(pldm_fru_record_iter_init(&records, table.data(), size));
+
+        selectedSize = selected.size();
+        EXPECT_EQ(get_fru_record_by_option(table.data(), size,
+                                           selected.data(), &selectedSize, 0,
+                                           0, 0),
+                  PLDM_ERROR_INVALID_LENGTH);
+        EXPECT_EQ(selectedSize, 0u);
+    }
+
+    // More fields than the table holds
+    table[14] = 2;
+    EXPECT_FALSE(
+        pldm_fru_record_iter_init(&records, table.data(), table.size()));
+    selectedSize = selected.size();
+    EXPECT_EQ(get_fru_record_by_option(table.data(), table.size(),
+                                       selected.data(), &selectedSize, 0, 0,
+                                       0),
+              PLDM_ERROR_INVALID_LENGTH);
+
+    EXPECT_TRUE(pldm_fru_record_iter_init(&records, nullptr, 0));
+    EXPECT_FALSE(pldm_fru_record_iter_next(&records, &record));
+}
+
+TEST(FruCache, testPoll)
+{
+    std::vector<uint8_t> table = {0x01, 0x00, PLDM_FRU_RECORD_TYPE_GENERAL,
+                                  1,    PLDM_FRU_ENCODING_ASCII,
+                                  PLDM_FRU_FIELD_TYPE_SN, 2, '1', '2'};
+    auto checksum = crc32(table.data(), table.size());
+
+    std::array<uint8_t, sizeof(pldm_msg_hdr) +
+                            PLDM_GET_FRU_RECORD_TABLE_METADATA_RESP_BYTES>
+        responseMsg{};
+    auto response = reinterpret_cast<pldm_msg*>(responseMsg.data());
+    auto poll = [&](pldm_fru_cache* cache, uint8_t tid,
+                    uint8_t completionCode, uint32_t length, uint32_t crc) {
+        EXPECT_EQ(encode_get_fru_record_table_metadata_resp(
+                      0, completionCode, 1, 0, length, length, 1, 1, crc,
+                      response),
+                  PLDM_SUCCESS);
+        uint8_t cc;
+        bool needsFetch;
+        EXPECT_EQ(pldm_fru_cache_update_metadata(
+                      cache, tid, response,
+                      PLDM_GET_FRU_RECORD_TABLE_METADATA_RESP_BYTES, &cc,
+                      &needsFetch),
+                  PLDM_SUCCESS);
+        EXPECT_EQ(cc, completionCode);
+        return needsFetch;
+    };
+
+    auto cache = pldm_fru_cache_init();
+    size_t size;
+    EXPECT_EQ(pldm_fru_cache_get_table(cache, 9, &size, nullptr), nullptr);
+
+    // Nothing cached yet
+    EXPECT_TRUE(poll(cache, 9, PLDM_SUCCESS, table.size(), checksum));
+    // The table must match the metadata
+    EXPECT_EQ(pldm_fru_cache_set_table(cache, 9, table.data(),
+                                       table.size() - 1),
+              PLDM_ERROR_INVALID_DATA);
+    ASSERT_EQ(pldm_fru_cache_set_table(cache, 9, table.data(), table.size()),
+              PLDM_SUCCESS);
+    EXPECT_FALSE(poll(cache, 9, PLDM_SUCCESS, table.size(), checksum));
+    // Other termini are cached apart
+    EXPECT_TRUE(poll(cache, 10, PLDM_SUCCESS, table.size(), checksum));
+
+    const pldm_fru_table_index* index = nullptr;
+    auto cached = pldm_fru_cache_get_table(cache, 9, &size, &index);
+    ASSERT_NE(cached, nullptr);
+    EXPECT_EQ(std::vector<uint8_t>(cached, cached + size), table);
+    EXPECT_NE(cached, table.data());
+    ASSERT_NE(index, nullptr);
+    EXPECT_EQ(pldm_fru_table_index_get_num_records(index), 1u);
+
+    // A failed poll leaves the cache as is
+    EXPECT_FALSE(poll(cache, 9, PLDM_ERROR, 0, 0));
+
+    // The table changed on the terminus
+    table[8] = '3';
+    checksum = crc32(table.data(), table.size());
+    EXPECT_TRUE(poll(cache, 9, PLDM_SUCCESS, table.size(), checksum));
+    EXPECT_EQ(pldm_fru_cache_get_table(cache, 9, &size, nullptr), cached);
+    ASSERT_EQ(pldm_fru_cache_set_table(cache, 9, table.data(), table.size()),
+              PLDM_SUCCESS);
+    EXPECT_FALSE(poll(cache, 9, PLDM_SUCCESS, table.size(), checksum));
+
+    // Metadata that counts the pad bytes matches the same table
+    auto paddedChecksum = paddedCrc32(table.data(), table.size());
+    EXPECT_FALSE(poll(cache, 9, PLDM_SUCCESS, paddedSize(table.size()),
+                      paddedChecksum));
+    EXPECT_TRUE(poll(cache, 9, PLDM_SUCCESS, paddedSize(table.size()),
+                     checksum));
+    EXPECT_TRUE(
+        poll(cache, 9, PLDM_SUCCESS, table.size(), paddedChecksum));
+    EXPECT_TRUE(poll(cache, 10, PLDM_SUCCESS, paddedSize(table.size()),
+                     paddedChecksum));
+    EXPECT_EQ(pldm_fru_cache_set_table(cache, 10, table.data(), table.size()),
+              PLDM_SUCCESS);
+
+    pldm_fru_cache_invalidate(cache, 9);
+    EXPECT_EQ(pldm_fru_cache_get_table(cache, 9, &size, nullptr), nullptr);
+    EXPECT_TRUE(poll(cache, 9, PLDM_SUCCESS, table.size(), checksum));
+
+    pldm_fru_cache_destroy(cache);
+}
+
+TEST(FruQuery, testRun)
+{
+    std::vector<uint8_t> table1 = {
+        0x01, 0x00, PLDM_FRU_RECORD_TYPE_GENERAL, 2, PLDM_FRU_ENCODING_ASCII,
+        PLDM_FRU_FIELD_TYPE_NAME, 1, 'a', PLDM_FRU_FIELD_TYPE_SN, 1, '1',
+        0x02, 0x00, PLDM_FRU_RECORD_TYPE_OEM, 1, PLDM_FRU_ENCODING_ASCII,
+        PLDM_FRU_FIELD_TYPE_SN, 1, '2'};
+    std::vector<uint8_t> table2 = {
+        0x01, 0x00, PLDM_FRU_RECORD_TYPE_GENERAL, 1, PLDM_FRU_ENCODING_ASCII,
+        PLDM_FRU_FIELD_TYPE_SN, 2, '3', '4'};
+
+    auto cache = pldm_fru_cache_init();
+    ASSERT_EQ(pldm_fru_cache_set_table(cache, 1, table1.data(), table1.size()),
+              PLDM_SUCCESS);
+    ASSERT_EQ(pldm_fru_cache_set_table(cache, 2, table2.data(), table2.size()),
+              PLDM_SUCCESS);
+    auto query = pldm_fru_query_init();
+    for (uint8_t tid : {1, 2})
+    {
+        size_t size;
+        const pldm_fru_table_index* index;
+        auto table = pldm_fru_cache_get_table(cache, tid, &size, &index);
+        ASSERT_EQ(pldm_fru_query_add_table(query, tid, table, index),
+                  PLDM_SUCCESS);
+    }
+
+    // Serial number of every General record
+    std::array<pldm_fru_query_result, 4> results{};
+    size_t numResults;
+    ASSERT_EQ(pldm_fru_query_run(query, 0, PLDM_FRU_RECORD_TYPE_GENERAL,
+                                 PLDM_FRU_FIELD_TYPE_SN, results.data(),
+                                 results.size(), &numResults),
+              PLDM_SUCCESS);
+    ASSERT_EQ(numResults, 2u);
+    EXPECT_EQ(results[0].tid, 1);
+    EXPECT_EQ(results[0].record_set_id, 1);
+    EXPECT_EQ(results[0].field.type, PLDM_FRU_FIELD_TYPE_SN);
+    EXPECT_EQ(results[0].field.length, 1);
+    EXPECT_EQ(results[0].field.value[0], '1');
+    EXPECT_EQ(results[1].tid, 2);
+    EXPECT_EQ(results[1].field.length, 2);
+    EXPECT_EQ(0, memcmp(results[1].field.value, "34", 2));
+
+    ASSERT_EQ(pldm_fru_query_run(query, 2, 0, 0, results.data(),
+                                 results.size(), &numResults),
+              PLDM_SUCCESS);
+    ASSERT_EQ(numResults, 1u);
+    EXPECT_EQ(results[0].record_type, PLDM_FRU_RECORD_TYPE_OEM);
+    EXPECT_EQ(results[0].field.value[0], '2');
+
+    // More matches than results, by field type first
+    ASSERT_EQ(pldm_fru_query_run(query, 0, 0, 0, results.data(), 1,
+                                 &numResults),
+              PLDM_SUCCESS);
+    EXPECT_EQ(numResults, 4u);
+    EXPECT_EQ(results[0].field.type, PLDM_FRU_FIELD_TYPE_SN);
+    EXPECT_EQ(results[0].field.value[0], '1');
+
+    ASSERT_EQ(pldm_fru_query_run(query, 0, 0, PLDM_FRU_FIELD_TYPE_VENDOR,
+                                 nullptr, 0, &numResults),
+              PLDM_SUCCESS);
+    EXPECT_EQ(numResults, 0u);
+
+    pldm_fru_query_destroy(query);
+    pldm_fru_cache_destroy(cache);
+}
+
+TEST(FruQuery, testReplaceAndRemove)
+{
+    std::vector<uint8_t> table1 = {
+        0x01, 0x00, PLDM_FRU_RECORD_TYPE_GENERAL, 2, PLDM_FRU_ENCODING_ASCII,
+        PLDM_FRU_FIELD_TYPE_NAME, 1, 'a', PLDM_FRU_FIELD_TYPE_SN, 1, '1'};
+    std::vector<uint8_t> table2 = {
+        0x01, 0x00, PLDM_FRU_RECORD_TYPE_GENERAL, 1, PLDM_FRU_ENCODING_ASCII,
+        PLDM_FRU_FIELD_TYPE_SN, 1, '2'};
+    std::vector<uint8_t> newTable1 = {
+        0x03, 0x00, PLDM_FRU_RECORD_TYPE_GENERAL, 1, PLDM_FRU_ENCODING_ASCII,
+        PLDM_FRU_FIELD_TYPE_SN, 1, '3'};
+
+    auto cache = pldm_fru_cache_init();
+    auto query = pldm_fru_query_init();
+    auto add = [&](uint8_t tid, const std::vector<uint8_t>& table) {
+        ASSERT_EQ(
+            pldm_fru_cache_set_table(cache, tid, table.data(), table.size()),
+            PLDM_SUCCESS);
+        size_t size;
+        const pldm_fru_table_index* index;
+        auto cached = pldm_fru_cache_get_table(cache, tid, &size, &index);
+        ASSERT_EQ(pldm_fru_query_add_table(query, tid, cached, index),
+                  PLDM_SUCCESS);
+    };
+    add(1, table1);
+    add(2, table2);
+
+    // The new table of terminus 1 replaces its old fields, after terminus 2
+    add(1, newTable1);
+    std::array<pldm_fru_query_result, 4> results{};
+    size_t numResults;
+    ASSERT_EQ(pldm_fru_query_run(query, 0, 0, 0, results.data(),
+                                 results.size(), &numResults),
+              PLDM_SUCCESS);
+    ASSERT_EQ(numResults, 2u);
+    EXPECT_EQ(results[0].tid, 2);
+    EXPECT_EQ(results[0].field.value[0], '2');
+    EXPECT_EQ(results[1].tid, 1);
+    EXPECT_EQ(results[1].record_set_id, 3);
+    EXPECT_EQ(results[1].field.value[0], '3');
+
+    // Terminus 2 goes away
+    pldm_fru_query_remove_table(query, 2);
+    pldm_fru_cache_invalidate(cache, 2);
+    ASSERT_EQ(pldm_fru_query_run(query, 0, 0, PLDM_FRU_FIELD_TYPE_SN,
+                                 results.data(), results.size(), &numResults),
+              PLDM_SUCCESS);
+    ASSERT_EQ(numResults, 1u);
+    EXPECT_EQ(results[0].tid, 1);
+    EXPECT_EQ(results[0].field.value[0], '3');
+
+    // Removing a terminus without a table changes nothing
+    pldm_fru_query_remove_table(query, 5);
+    ASSERT_EQ(pldm_fru_query_run(query, 0, 0, 0, nullptr, 0, &numResults),
+              PLDM_SUCCESS);
+    EXPECT_EQ(numResults, 1u);
+
+    pldm_fru_query_destroy(query);
+    pldm_fru_cache_destroy(cache);
+}
+
+TEST(FruTableDiff, testDiff)
+{
+    std::vector<uint8_t> oldTable = {
+        0x01, 0x00, PLDM_FRU_RECORD_TYPE_GENERAL, 2, PLDM_FRU_ENCODING_ASCII,
+        PLDM_FRU_FIELD_TYPE_NAME, 1, 'a', PLDM_FRU_FIELD_TYPE_SN, 1, '1',
+        0x02, 0x00, PLDM_FRU_RECORD_TYPE_OEM, 1, PLDM_FRU_ENCODING_ASCII,
+        PLDM_FRU_FIELD_TYPE_SN, 1, '2'};
+    // Fields reordered, one modified, one added, one removed
+    std::vector<uint8_t> newTable = {
+        0x01, 0x00, PLDM_FRU_RECORD_TYPE_GENERAL, 3, PLDM_FRU_ENCODING_ASCII,
+        PLDM_FRU_FIELD_TYPE_SN, 2, '1', '0', PLDM_FRU_FIELD_TYPE_NAME, 1, 'a',
+        PLDM_FRU_FIELD_TYPE_VERSION, 1, 'v'};
+
+    auto oldIndex = pldm_fru_table_index_init();
+    auto newIndex = pldm_fru_table_index_init();
+    ASSERT_EQ(pldm_fru_table_index_update(oldIndex, oldTable.data(),
+                                          oldTable.size()),
+              PLDM_SUCCESS);
+    ASSERT_EQ(pldm_fru_table_index_update(newIndex, newTable.data(),
+                                          newTable.size()),
+              PLDM_SUCCESS);
+
+    pldm_fru_field_change* changes = nullptr;
+    size_t numChanges = 0;
+    ASSERT_EQ(pldm_fru_table_diff(oldTable.data(), oldIndex, newTable.data(),
+                                  newIndex, &changes, &numChanges),
+              PLDM_SUCCESS);
+    ASSERT_EQ(numChanges, 3u);
+
+    EXPECT_EQ(changes[0].kind, PLDM_FRU_FIELD_MODIFIED);
+    EXPECT_EQ(changes[0].record_set_id, 1);
+    EXPECT_EQ(changes[0].field_type, PLDM_FRU_FIELD_TYPE_SN);
+    EXPECT_EQ(changes[0].old_field.length, 1);
+    EXPECT_EQ(changes[0].new_field.length, 2);
+    EXPECT_EQ(changes[0].new_field.value, &newTable[7]);
+
+    EXPECT_EQ(changes[1].kind, PLDM_FRU_FIELD_ADDED);
+    EXPECT_EQ(changes[1].record_set_id, 1);
+    EXPECT_EQ(changes[1].field_type, PLDM_FRU_FIELD_TYPE_VERSION);
+    EXPECT_EQ(changes[1].old_field.value, nullptr);
+    EXPECT_EQ(changes[1].new_field.value[0], 'v');
+
+    EXPECT_EQ(changes[2].kind, PLDM_FRU_FIELD_REMOVED);
+    EXPECT_EQ(changes[2].record_set_id, 2);
+    EXPECT_EQ(changes[2].record_type, PLDM_FRU_RECORD_TYPE_OEM);
+    EXPECT_EQ(changes[2].old_field.value[0], '2');
+    EXPECT_EQ(changes[2].new_field.value, nullptr);
+    free(changes);
+
+    ASSERT_EQ(pldm_fru_table_diff(oldTable.data(), oldIndex, oldTable.data(),
+                                  oldIndex, &changes, &numChanges),
+              PLDM_SUCCESS);
+    EXPECT_EQ(numChanges, 0u);
+    free(changes);
+
+    pldm_fru_table_index_destroy(oldIndex);
+    pldm_fru_table_index_destroy(newIndex);
+}
+
 int main(int argc, char** argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "pldm_loopback.hpp"
+
+#include <benchmark/benchmark.h>
+
+// Request to response round trips through the loopback transport. Each
+// benchmark thread has its own link and responder thread, and reports the
+// median and 99th percentile round trip next to the message rate.
+
+using namespace pldm_loopback;
+
+constexpr size_t hdrSize = sizeof(pldm_msg_hdr);
+
+struct GetTid
+{
+    static size_t encode(uint8_t instanceId, pldm_msg* msg, uint32_t)
+    {
+        encode_get_tid_req(instanceId, msg);
+        return 0;
+    }
+
+    static bool check(const pldm_msg* msg, size_t payloadLength, uint32_t)
+    {
+        uint8_t cc = 0;
+        uint8_t respTid = 0;
+        return decode_get_tid_resp(msg, payloadLength, &cc, &respTid) ==
+                   PLDM_SUCCESS &&
+               cc == PLDM_SUCCESS && respTid == tid;
+    }
+};
+
+struct GetPdr
+{
+    static size_t encode(uint8_t instanceId, pldm_msg* msg, uint32_t)
+    {
+        encode_get_pdr_req(instanceId, pdrRecordHandle, 0, PLDM_GET_FIRSTPART,
+                           UINT8_MAX, 0, msg, PLDM_GET_PDR_REQ_BYTES);
+        return PLDM_GET_PDR_REQ_BYTES;
+    }
+
+    static bool check(const pldm_msg* msg, size_t payloadLength, uint32_t)
+    {
+        uint8_t cc = 0;
+        uint32_t nextRecord = 0;
+        uint32_t nextTransfer = 0;
+        uint8_t flag = 0;
+        uint16_t count = 0;
+        uint8_t crc = 0;
+        std::array<uint8_t, 64> record{};
+        return decode_get_pdr_resp(msg, payloadLength, &cc, &nextRecord,
+                                   &nextTransfer, &flag, &count,
+                                   record.data(), record.size(),
+                                   &crc) == PLDM_SUCCESS &&
+               cc == PLDM_SUCCESS && count == pdr().size() &&
+               std::equal(pdr().begin(), pdr().end(), record.begin());
+    }
+};
+
+struct GetSensorReading
+{
+    static size_t encode(uint8_t instanceId, pldm_msg* msg, uint32_t)
+    {
+        encode_get_sensor_reading_req(instanceId, sensorId, 0, msg);
+        return PLDM_GET_SENSOR_READING_REQ_BYTES;
+    }
+
+    static bool check(const pldm_msg* msg, size_t payloadLength, uint32_t)
+    {
+        uint8_t cc = 0;
+        // Largest reading the buffer takes on input
+        uint8_t dataSize = PLDM_SENSOR_DATA_SIZE_UINT16;
+        uint8_t opState = 0;
+        uint8_t eventEnable = 0;
+        uint8_t presentState = 0;
+        uint8_t previousState = 0;
+        uint8_t eventState = 0;
+        uint16_t reading = 0;
+        return decode_get_sensor_reading_resp(
+                   msg, payloadLength, &cc, &dataSize, &opState, &eventEnable,
+                   &presentState, &previousState, &eventState,
+                   reinterpret_cast<uint8_t*>(&reading)) == PLDM_SUCCESS &&
+               cc == PLDM_SUCCESS && reading == sensorReading;
+    }
+};
+
+// Sent by the firmware device, which this library has no encoder for
+struct RequestFirmwareData
+{
+    static uint32_t offset(uint32_t seq)
+    {
+        return (seq * maxTransferSize) % imageSize;
+    }
+
+    static size_t encode(uint8_t instanceId, pldm_msg* msg, uint32_t seq)
+    {
+        encode_pldm_header(instanceId, PLDM_FWUP, PLDM_REQUEST_FIRMWARE_DATA,
+                           PLDM_REQUEST, msg);
+        request_firmware_data_req request{htole32(offset(seq)),
+                                          htole32(maxTransferSize)};
+        std::memcpy(msg->payload, &request, sizeof(request));
+        return sizeof(request);
+    }
+
+    static bool check(const pldm_msg* msg, size_t payloadLength, uint32_t seq)
+    {
+        return payloadLength == maxTransferSize + 1 &&
+               msg->payload[0] == PLDM_SUCCESS &&
+               std::equal(msg->payload + 1, msg->payload + payloadLength,
+                          image().begin() + offset(seq));
+    }
+};
+
+template <typename Command>
+static void BM_RoundTrip(benchmark::State& state)
+{
+    Link link;
+    std::atomic<bool> stop{false};
+    std::thread responderThread([&] {
+        Responder responder;
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            if (!responder.poll(link))
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::array<uint8_t, Link::Ring::maxMessageSize> requestMsg{};
+    std::array<uint8_t, Link::Ring::maxMessageSize> responseMsg{};
+    auto request = reinterpret_cast<pldm_msg*>(requestMsg.data());
+    auto response = reinterpret_cast<const pldm_msg*>(responseMsg.data());
+    std::vector<int64_t> latencies;
+    latencies.reserve(1 << 20);
+    uint32_t seq = 0;
+
+    for (auto _ : state)
+    {
+        auto start = std::chrono::steady_clock::now();
+        uint8_t instanceId = seq & PLDM_INSTANCE_ID_MASK;
+        size_t length = Command::encode(instanceId, request, seq);
+        while (!link.requests.push(requestMsg.data(), hdrSize + length))
+        {
+        }
+        size_t size = 0;
+        while ((size = link.responses.pop(responseMsg.data())) == 0)
+        {
+            std::this_thread::yield();
+        }
+        if (response->hdr.instance_id != instanceId ||
+            !Command::check(response, size - hdrSize, seq))
+        {
+            state.SkipWithError("bad response");
+            break;
+        }
+        auto end = std::chrono::steady_clock::now();
+        if (latencies.size() < latencies.capacity())
+        {
+            latencies.push_back(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end -
+                                                                     start)
+                    .count());
+        }
+        ++seq;
+    }
+
+    stop.store(true, std::memory_order_relaxed);
+    responderThread.join();
+
+    state.SetItemsProcessed(state.iterations());
+    if (!latencies.empty())
+    {
+        auto percentile = [&](size_t p) {
+            auto it = latencies.begin() + (latencies.size() - 1) * p / 100;
+            std::nth_element(latencies.begin(), it, latencies.end());
+            return static_cast<double>(*it);
+        };
+        state.counters["p50_ns"] =
+            benchmark::Counter(percentile(50), benchmark::Counter::kAvgThreads);
+        state.counters["p99_ns"] =
+            benchmark::Counter(percentile(99), benchmark::Counter::kAvgThreads);
+    }
+}
+BENCHMARK_TEMPLATE(BM_RoundTrip, GetTid)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_RoundTrip, GetPdr)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_RoundTrip, GetSensorReading)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_RoundTrip, RequestFirmwareData)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
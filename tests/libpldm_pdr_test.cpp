@@ -1070,6 +1070,106 @@ TEST(EntityAssociationPDR, testPDR)
     pldm_entity_association_tree_destroy(tree);
 }
 
+TEST(EntityAssociationPDR, testPDRReplaceAndRemove)
+{
+    //        1
+    //        |
+    //        2--3--4(logical)
+    //        |
+    //        5
+
+    pldm_entity entities[5]{};
+
+    entities[0].entity_type = 1;
+    entities[1].entity_type = 2;
+    entities[2].entity_type = 3;
+    entities[3].entity_type = 4;
+    entities[4].entity_type = 5;
+
+    auto tree = pldm_entity_association_tree_init();
+    auto l1 = pldm_entity_association_tree_add(tree, &entities[0], nullptr,
+                                               PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    auto l2a = pldm_entity_association_tree_add(
+        tree, &entities[1], l1, PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    pldm_entity_association_tree_add(tree, &entities[2], l1,
+                                     PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    pldm_entity_association_tree_add(tree, &entities[3], l1,
+                                     PLDM_ENTITY_ASSOCIAION_LOGICAL);
+    pldm_entity_association_tree_add(tree, &entities[4], l2a,
+                                     PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+
+    auto repo = pldm_pdr_init();
+    std::array<uint8_t, sizeof(pldm_pdr_hdr)> local{};
+    pldm_pdr_add(repo, local.data(), local.size(), 0, false);
+
+    // The PDRs of a tree get consecutive handles after the existing records
+    pldm_entity_association_pdr_add(tree, repo, true);
+    EXPECT_EQ(pldm_pdr_get_record_count(repo), 4u);
+    uint8_t* data = nullptr;
+    uint32_t size{};
+    uint32_t nextRecHdl{};
+    for (uint32_t handle = 2; handle <= 4; ++handle)
+    {
+        ASSERT_NE(
+            pldm_pdr_find_record(repo, handle, &data, &size, &nextRecHdl),
+            nullptr);
+        auto hdr = reinterpret_cast<pldm_pdr_hdr*>(data);
+        EXPECT_EQ(le32toh(hdr->record_handle), handle);
+        EXPECT_EQ(hdr->type, PLDM_PDR_ENTITY_ASSOCIATION);
+        EXPECT_EQ(nextRecHdl, handle == 4 ? 0 : handle + 1);
+    }
+
+    // The tree remembers the PDRs it added, so a sync with nothing changed
+    // adds no copies of them
+    pldm_entity_association_pdr_changes changes{};
+    pldm_entity_association_pdr_sync(tree, repo, true, &changes);
+    EXPECT_EQ(changes.num_added + changes.num_modified + changes.num_deleted,
+              0u);
+    pldm_entity_association_pdr_changes_free(&changes);
+    EXPECT_EQ(pldm_pdr_get_record_count(repo), 4u);
+
+    // A record written in place can still be replaced or removed on its own
+    pldm_entity extra{};
+    extra.entity_type = 7;
+    pldm_entity_association_tree_add(tree, &extra, l1,
+                                     PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    pldm_entity_association_pdr_sync(tree, repo, true, &changes);
+    EXPECT_EQ(changes.num_added, 0u);
+    ASSERT_EQ(changes.num_modified, 1u);
+    EXPECT_EQ(changes.num_deleted, 0u);
+    ASSERT_NE(pldm_pdr_find_record(repo, changes.modified[0], &data, &size,
+                                   &nextRecHdl),
+              nullptr);
+    EXPECT_EQ(reinterpret_cast<pldm_pdr_hdr*>(data)->record_change_num,
+              htole16(1));
+    pldm_entity_association_pdr_changes_free(&changes);
+    EXPECT_EQ(pldm_pdr_get_record_count(repo), 4u);
+    pldm_pdr_remove_remote_pdrs(repo);
+    EXPECT_EQ(pldm_pdr_get_record_count(repo), 1u);
+    EXPECT_EQ(pldm_pdr_get_repo_size(repo), local.size());
+
+    pldm_entity_association_pdr_add(tree, repo, false);
+    EXPECT_EQ(pldm_pdr_get_record_count(repo), 4u);
+
+    auto copy = pldm_entity_association_tree_init();
+    EXPECT_TRUE(pldm_entity_association_tree_add_pdrs(copy, repo));
+    auto node = pldm_entity_association_tree_find(copy, &entities[0]);
+    ASSERT_NE(node, nullptr);
+    pldm_entity entity{};
+    entity.entity_type = 6;
+    pldm_entity_association_tree_add(copy, &entity, node,
+                                     PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    pldm_entity_association_pdr_sync(copy, repo, false, &changes);
+    EXPECT_EQ(changes.num_added, 0u);
+    EXPECT_EQ(changes.num_modified, 1u);
+    pldm_entity_association_pdr_changes_free(&changes);
+    EXPECT_EQ(pldm_pdr_get_record_count(repo), 4u);
+
+    pldm_pdr_destroy(repo);
+    pldm_entity_association_tree_destroy(copy);
+    pldm_entity_association_tree_destroy(tree);
+}
+
 TEST(EntityAssociationPDR, testFind)
 {
     //        1
@@ -1217,8 +1317,557 @@ TEST(EntityAssociationPDR, testExtract)
     EXPECT_EQ(out[5].entity_type, 6u);
     EXPECT_EQ(out[5].entity_instance_num, 1u);
     EXPECT_EQ(out[5].entity_container_id, 1u);
+    free(out);
+
+    // A PDR that claims more children than it holds extracts nothing
+    ++e->num_children;
+    pldm_entity_association_pdr_extract(pdr.data(), pdr.size(), &num, &out);
+    EXPECT_EQ(num, 0u);
+    EXPECT_EQ(out, nullptr);
+}
+
+TEST(EntityAssociationPDR, testIterate)
+{
+    std::vector<uint8_t> pdr{};
+    pdr.resize(sizeof(pldm_pdr_hdr) + sizeof(pldm_pdr_entity_association) +
+               sizeof(pldm_entity) * 2);
+    pldm_pdr_hdr* hdr = reinterpret_cast<pldm_pdr_hdr*>(pdr.data());
+    hdr->type = PLDM_PDR_ENTITY_ASSOCIATION;
+    hdr->length =
+        htole16(sizeof(pldm_pdr_entity_association) + sizeof(pldm_entity) * 2);
+
+    pldm_pdr_entity_association* e =
+        reinterpret_cast<pldm_pdr_entity_association*>(pdr.data() +
+                                                       sizeof(pldm_pdr_hdr));
+    e->container_id = htole16(0x102);
+    e->association_type = PLDM_ENTITY_ASSOCIAION_LOGICAL;
+    e->num_children = 3;
+    e->container.entity_type = htole16(1);
+    e->container.entity_instance_num = htole16(1);
+    e->container.entity_container_id = htole16(0);
+    for (uint16_t i = 0; i < e->num_children; ++i)
+    {
+        e->children[i].entity_type = htole16(0x200 + i);
+        e->children[i].entity_instance_num = htole16(i + 1);
+        e->children[i].entity_container_id = htole16(0x102);
+    }
+
+    pldm_entity_association_pdr_iter iter{};
+    ASSERT_TRUE(
+        pldm_entity_association_pdr_iter_init(&iter, pdr.data(), pdr.size()));
+    EXPECT_EQ(iter.container_id, 0x102u);
+    EXPECT_EQ(iter.association_type, PLDM_ENTITY_ASSOCIAION_LOGICAL);
+    EXPECT_EQ(iter.container.entity_type, 1u);
+    EXPECT_EQ(iter.container.entity_instance_num, 1u);
+    EXPECT_EQ(iter.container.entity_container_id, 0u);
+
+    pldm_entity entity{};
+    uint16_t num = 0;
+    while (pldm_entity_association_pdr_iter_next(&iter, &entity))
+    {
+        EXPECT_EQ(entity.entity_type, 0x200 + num);
+        EXPECT_EQ(entity.entity_instance_num, num + 1);
+        EXPECT_EQ(entity.entity_container_id, 0x102u);
+        ++num;
+    }
+    EXPECT_EQ(num, 3u);
+    EXPECT_FALSE(pldm_entity_association_pdr_iter_next(&iter, &entity));
+
+    // Truncated PDR
+    EXPECT_FALSE(pldm_entity_association_pdr_iter_init(&iter, pdr.data(),
+                                                       pdr.size() - 1));
+    // More children than the PDR holds
+    e->num_children = 4;
+    EXPECT_FALSE(
+        pldm_entity_association_pdr_iter_init(&iter, pdr.data(), pdr.size()));
+    e->num_children = 0;
+    EXPECT_FALSE(
+        pldm_entity_association_pdr_iter_init(&iter, pdr.data(), pdr.size()));
+    // Not an entity association PDR
+    e->num_children = 3;
+    hdr->type = PLDM_PDR_FRU_RECORD_SET;
+    EXPECT_FALSE(
+        pldm_entity_association_pdr_iter_init(&iter, pdr.data(), pdr.size()));
+}
+
+TEST(EntityAssociationPDR, testFlatten)
+{
+    //        1
+    //        |
+    //        2--3--4
+    //        |
+    //        5--6--7
+    //        |  |
+    //        9  8
+
+    pldm_entity entities[9]{};
+
+    entities[0].entity_type = 1;
+    entities[1].entity_type = 2;
+    entities[2].entity_type = 2;
+    entities[3].entity_type = 3;
+    entities[4].entity_type = 4;
+    entities[5].entity_type = 5;
+    entities[6].entity_type = 5;
+    entities[7].entity_type = 6;
+    entities[8].entity_type = 7;
+
+    auto tree = pldm_entity_association_tree_init();
+
+    auto l1 = pldm_entity_association_tree_add(tree, &entities[0], nullptr,
+                                               PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    auto l2a = pldm_entity_association_tree_add(
+        tree, &entities[1], l1, PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    pldm_entity_association_tree_add(tree, &entities[2], l1,
+                                     PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    pldm_entity_association_tree_add(tree, &entities[3], l1,
+                                     PLDM_ENTITY_ASSOCIAION_LOGICAL);
+    auto l3a = pldm_entity_association_tree_add(
+        tree, &entities[4], l2a, PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    auto l3b = pldm_entity_association_tree_add(
+        tree, &entities[5], l2a, PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    pldm_entity_association_tree_add(tree, &entities[6], l2a,
+                                     PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    pldm_entity_association_tree_add(tree, &entities[7], l3a,
+                                     PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    pldm_entity_association_tree_add(tree, &entities[8], l3b,
+                                     PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+
+    size_t num{};
+    pldm_entity_flat_node* flat = nullptr;
+    ASSERT_TRUE(pldm_entity_association_tree_flatten(tree, &flat, &num));
+    ASSERT_NE(flat, nullptr);
+    ASSERT_EQ(num, 9u);
+
+    // Preorder: 1, 2, 4, 6, 5, 7, 5, 2, 3
+    EXPECT_EQ(le16toh(flat[0].entity.entity_type), 1u);
+    EXPECT_EQ(le16toh(flat[0].parent_index), PLDM_ENTITY_FLAT_NO_PARENT);
+    EXPECT_EQ(le16toh(flat[0].num_children), 3u);
+    EXPECT_EQ(le16toh(flat[1].entity.entity_type), 2u);
+    EXPECT_EQ(le16toh(flat[1].parent_index), 0u);
+    EXPECT_EQ(le16toh(flat[1].num_children), 3u);
+    EXPECT_EQ(le16toh(flat[2].entity.entity_type), 4u);
+    EXPECT_EQ(le16toh(flat[2].parent_index), 1u);
+    EXPECT_EQ(le16toh(flat[3].entity.entity_type), 6u);
+    EXPECT_EQ(le16toh(flat[3].parent_index), 2u);
+    EXPECT_EQ(le16toh(flat[3].num_children), 0u);
+    EXPECT_EQ(le16toh(flat[4].entity.entity_type), 5u);
+    EXPECT_EQ(le16toh(flat[4].parent_index), 1u);
+    EXPECT_EQ(le16toh(flat[5].entity.entity_type), 7u);
+    EXPECT_EQ(le16toh(flat[5].parent_index), 4u);
+    EXPECT_EQ(le16toh(flat[6].entity.entity_type), 5u);
+    EXPECT_EQ(le16toh(flat[6].entity.entity_instance_num), 2u);
+    EXPECT_EQ(le16toh(flat[7].entity.entity_type), 2u);
+    EXPECT_EQ(le16toh(flat[7].entity.entity_instance_num), 2u);
+    EXPECT_EQ(le16toh(flat[7].parent_index), 0u);
+    EXPECT_EQ(le16toh(flat[8].entity.entity_type), 3u);
+    EXPECT_EQ(flat[8].association_type, PLDM_ENTITY_ASSOCIAION_LOGICAL);
+
+    auto copy = pldm_entity_association_tree_unflatten(flat, num);
+    ASSERT_NE(copy, nullptr);
+
+    size_t numOrig{};
+    pldm_entity* orig = nullptr;
+    pldm_entity_association_tree_visit(tree, &orig, &numOrig);
+    size_t numCopy{};
+    pldm_entity* out = nullptr;
+    pldm_entity_association_tree_visit(copy, &out, &numCopy);
+    ASSERT_EQ(numOrig, numCopy);
+    for (size_t i = 0; i < numOrig; ++i)
+    {
+        EXPECT_EQ(orig[i].entity_type, out[i].entity_type);
+        EXPECT_EQ(orig[i].entity_instance_num, out[i].entity_instance_num);
+        EXPECT_EQ(orig[i].entity_container_id, out[i].entity_container_id);
+    }
 
+    // New children of the copy get fresh container ids
+    pldm_entity entity{};
+    entity.entity_type = 8;
+    entity.entity_instance_num = 1;
+    auto node = pldm_entity_association_tree_find(copy, &entities[2]);
+    ASSERT_NE(node, nullptr);
+    pldm_entity_association_tree_add(copy, &entity, node,
+                                     PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    EXPECT_EQ(entity.entity_container_id, 5u);
+
+    free(orig);
     free(out);
+    pldm_entity_association_tree_destroy(copy);
+
+    // A child count that runs past the end of the array
+    flat[8].num_children = htole16(1);
+    EXPECT_EQ(pldm_entity_association_tree_unflatten(flat, num), nullptr);
+    flat[8].num_children = 0;
+
+    // A parent index that doesn't match the preorder layout
+    flat[3].parent_index = htole16(0);
+    EXPECT_EQ(pldm_entity_association_tree_unflatten(flat, num), nullptr);
+
+    free(flat);
+    pldm_entity_association_tree_destroy(tree);
+
+    auto empty = pldm_entity_association_tree_unflatten(nullptr, 0);
+    ASSERT_NE(empty, nullptr);
+    pldm_entity_association_tree_destroy(empty);
+}
+
+TEST(EntityAssociationPDR, testSync)
+{
+    //        1
+    //        |
+    //        2--3--4(logical)
+    //        |
+    //        5
+
+    pldm_entity entities[5]{};
+
+    entities[0].entity_type = 1;
+    entities[1].entity_type = 2;
+    entities[2].entity_type = 3;
+    entities[3].entity_type = 4;
+    entities[4].entity_type = 5;
+
+    auto tree = pldm_entity_association_tree_init();
+    auto repo = pldm_pdr_init();
+
+    auto l1 = pldm_entity_association_tree_add(tree, &entities[0], nullptr,
+                                               PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    auto l2a = pldm_entity_association_tree_add(
+        tree, &entities[1], l1, PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    pldm_entity_association_tree_add(tree, &entities[2], l1,
+                                     PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+
+    pldm_entity_association_pdr_changes changes{};
+    pldm_entity_association_pdr_sync(tree, repo, false, &changes);
+    ASSERT_EQ(changes.num_added, 1u);
+    EXPECT_EQ(changes.num_modified, 0u);
+    EXPECT_EQ(changes.num_deleted, 0u);
+    auto rootPhysical = changes.added[0];
+    pldm_entity_association_pdr_changes_free(&changes);
+    EXPECT_EQ(pldm_pdr_get_record_count(repo), 1u);
+
+    // Nothing changed, nothing to do
+    pldm_entity_association_pdr_sync(tree, repo, false, &changes);
+    EXPECT_EQ(changes.num_added + changes.num_modified + changes.num_deleted,
+              0u);
+    pldm_entity_association_pdr_changes_free(&changes);
+
+    // A new parent gets a new PDR, the PDR of its own parent is untouched
+    auto l3 = pldm_entity_association_tree_add(tree, &entities[4], l2a,
+                                               PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    // A new association type under an existing parent gets a new PDR
+    pldm_entity_association_tree_add(tree, &entities[3], l1,
+                                     PLDM_ENTITY_ASSOCIAION_LOGICAL);
+    pldm_entity_association_pdr_sync(tree, repo, false, &changes);
+    EXPECT_EQ(changes.num_added, 2u);
+    EXPECT_EQ(changes.num_modified, 0u);
+    EXPECT_EQ(changes.num_deleted, 0u);
+    pldm_entity_association_pdr_changes_free(&changes);
+    EXPECT_EQ(pldm_pdr_get_record_count(repo), 3u);
+
+    // Another physical child of the root replaces its physical PDR in place
+    pldm_entity entity{};
+    entity.entity_type = 3;
+    pldm_entity_association_tree_add(tree, &entity, l1,
+                                     PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    pldm_entity_association_pdr_sync(tree, repo, false, &changes);
+    EXPECT_EQ(changes.num_added, 0u);
+    ASSERT_EQ(changes.num_modified, 1u);
+    EXPECT_EQ(changes.modified[0], rootPhysical);
+    EXPECT_EQ(changes.num_deleted, 0u);
+    pldm_entity_association_pdr_changes_free(&changes);
+
+    uint8_t* data = nullptr;
+    uint32_t size{};
+    uint32_t nextRecHdl{};
+    ASSERT_NE(pldm_pdr_find_record(repo, rootPhysical, &data, &size,
+                                   &nextRecHdl),
+              nullptr);
+    auto hdr = reinterpret_cast<pldm_pdr_hdr*>(data);
+    EXPECT_EQ(le32toh(hdr->record_handle), rootPhysical);
+    EXPECT_EQ(le16toh(hdr->record_change_num), 1u);
+    EXPECT_EQ(size, sizeof(pldm_pdr_hdr) + sizeof(pldm_pdr_entity_association) +
+                        2 * sizeof(pldm_entity));
+    auto assoc = reinterpret_cast<pldm_pdr_entity_association*>(
+        data + sizeof(pldm_pdr_hdr));
+    EXPECT_EQ(assoc->num_children, 3u);
+    EXPECT_EQ(pldm_pdr_get_repo_size(repo),
+              3 * (sizeof(pldm_pdr_hdr) + sizeof(pldm_pdr_entity_association)) +
+                  2 * sizeof(pldm_entity));
+
+    // Deleting the only child of a parent removes the parent's PDR
+    pldm_entity_association_tree_delete_node(tree, l3);
+    pldm_entity_association_pdr_sync(tree, repo, false, &changes);
+    EXPECT_EQ(changes.num_added, 0u);
+    EXPECT_EQ(changes.num_modified, 0u);
+    EXPECT_EQ(changes.num_deleted, 1u);
+    pldm_entity_association_pdr_changes_free(&changes);
+    EXPECT_EQ(pldm_pdr_get_record_count(repo), 2u);
+
+    // Deleting a subtree removes the PDRs under it too
+    pldm_entity_association_tree_add(tree, &entities[4], l2a,
+                                     PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    pldm_entity_association_pdr_sync(tree, repo, false, nullptr);
+    EXPECT_EQ(pldm_pdr_get_record_count(repo), 3u);
+    pldm_entity_association_tree_delete_node(tree, l2a);
+    pldm_entity_association_pdr_sync(tree, repo, false, &changes);
+    EXPECT_EQ(changes.num_added, 0u);
+    EXPECT_EQ(changes.num_modified, 1u);
+    EXPECT_EQ(changes.num_deleted, 1u);
+    pldm_entity_association_pdr_changes_free(&changes);
+    EXPECT_EQ(pldm_pdr_get_record_count(repo), 2u);
+
+    // Dirty parents deleted before a sync drop out of it, while a parent
+    // marked dirty after them is still synced
+    auto l2b = pldm_entity_association_tree_add(
+        tree, &entities[1], l1, PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    auto l3b = pldm_entity_association_tree_add(
+        tree, &entities[4], l2b, PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    pldm_entity_association_tree_add(tree, &entity, l3b,
+                                     PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    auto l2c = pldm_entity_association_tree_find(tree, &entities[2]);
+    ASSERT_NE(l2c, nullptr);
+    pldm_entity_association_tree_add(tree, &entities[4], l2c,
+                                     PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    pldm_entity_association_tree_delete_node(tree, l2b);
+    pldm_entity_association_pdr_sync(tree, repo, false, &changes);
+    EXPECT_EQ(changes.num_added, 1u);
+    EXPECT_EQ(changes.num_modified, 1u);
+    EXPECT_EQ(changes.num_deleted, 0u);
+    pldm_entity_association_pdr_changes_free(&changes);
+    EXPECT_EQ(pldm_pdr_get_record_count(repo), 3u);
+
+    size_t num{};
+    pldm_entity* out = nullptr;
+    pldm_entity_association_tree_visit(tree, &out, &num);
+    EXPECT_EQ(num, 5u);
+    free(out);
+
+    pldm_pdr_destroy(repo);
+    pldm_entity_association_tree_destroy(tree);
+}
+
+TEST(EntityAssociationPDR, testTreeAddPdrs)
+{
+    //        1
+    //        |
+    //        2--3--4(logical)
+    //        |
+    //        5
+
+    pldm_entity entities[5]{};
+
+    entities[0].entity_type = 1;
+    entities[1].entity_type = 2;
+    entities[2].entity_type = 3;
+    entities[3].entity_type = 4;
+    entities[4].entity_type = 5;
+
+    auto tree = pldm_entity_association_tree_init();
+    auto l1 = pldm_entity_association_tree_add(tree, &entities[0], nullptr,
+                                               PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    auto l2a = pldm_entity_association_tree_add(
+        tree, &entities[1], l1, PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    pldm_entity_association_tree_add(tree, &entities[2], l1,
+                                     PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    pldm_entity_association_tree_add(tree, &entities[3], l1,
+                                     PLDM_ENTITY_ASSOCIAION_LOGICAL);
+    pldm_entity_association_tree_add(tree, &entities[4], l2a,
+                                     PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+
+    auto repo = pldm_pdr_init();
+    pldm_entity_association_pdr_add(tree, repo, true);
+    EXPECT_EQ(pldm_pdr_get_record_count(repo), 3u);
+
+    auto copy = pldm_entity_association_tree_init();
+    EXPECT_TRUE(pldm_entity_association_tree_add_pdrs(copy, repo));
+
+    // Nothing is left to sync in a tree built from PDRs, including a
+    // container that was linked as a child earlier in the same pass
+    pldm_entity_association_pdr_changes changes{};
+    pldm_entity_association_pdr_sync(copy, repo, true, &changes);
+    EXPECT_EQ(changes.num_added, 0u);
+    EXPECT_EQ(changes.num_modified, 0u);
+    pldm_entity_association_pdr_changes_free(&changes);
+    EXPECT_EQ(pldm_pdr_get_record_count(repo), 3u);
+
+    size_t num{};
+    pldm_entity* out = nullptr;
+    pldm_entity_association_tree_visit(copy, &out, &num);
+    EXPECT_EQ(num, 5u);
+    free(out);
+
+    auto node = pldm_entity_association_tree_find(copy, &entities[0]);
+    ASSERT_NE(node, nullptr);
+    EXPECT_EQ(pldm_entity_get_num_children(node,
+                                           PLDM_ENTITY_ASSOCIAION_PHYSICAL),
+              2u);
+    EXPECT_EQ(
+        pldm_entity_get_num_children(node, PLDM_ENTITY_ASSOCIAION_LOGICAL),
+        1u);
+    node = pldm_entity_association_tree_find(copy, &entities[4]);
+    ASSERT_NE(node, nullptr);
+    EXPECT_EQ(entities[4].entity_container_id, 2u);
+
+    // Merging the same PDRs again adds nothing
+    EXPECT_TRUE(pldm_entity_association_tree_add_pdrs(copy, repo));
+    pldm_entity_association_tree_visit(copy, &out, &num);
+    EXPECT_EQ(num, 5u);
+    free(out);
+
+    // Instance numbers and container ids from the PDRs are kept as is, and
+    // entities from another terminus are merged under existing ones
+    constexpr auto numChildren = 2;
+    std::array<uint8_t, sizeof(pldm_pdr_hdr) +
+                            sizeof(pldm_pdr_entity_association) +
+                            sizeof(pldm_entity) * (numChildren - 1)>
+        pdr{};
+    auto hdr = reinterpret_cast<pldm_pdr_hdr*>(pdr.data());
+    hdr->type = PLDM_PDR_ENTITY_ASSOCIATION;
+    hdr->length = htole16(pdr.size() - sizeof(pldm_pdr_hdr));
+    auto assoc = reinterpret_cast<pldm_pdr_entity_association*>(
+        pdr.data() + sizeof(pldm_pdr_hdr));
+    assoc->container_id = htole16(0x10);
+    assoc->association_type = PLDM_ENTITY_ASSOCIAION_PHYSICAL;
+    assoc->container.entity_type = htole16(entities[2].entity_type);
+    assoc->container.entity_instance_num =
+        htole16(entities[2].entity_instance_num);
+    assoc->container.entity_container_id =
+        htole16(entities[2].entity_container_id);
+    assoc->num_children = numChildren;
+    assoc->children[0].entity_type = htole16(6);
+    assoc->children[0].entity_instance_num = htole16(7);
+    assoc->children[0].entity_container_id = htole16(0x10);
+    assoc->children[1].entity_type = htole16(6);
+    assoc->children[1].entity_instance_num = htole16(9);
+    assoc->children[1].entity_container_id = htole16(0x10);
+    auto remote = pldm_pdr_init();
+    pldm_pdr_add(remote, pdr.data(), pdr.size(), 0, true);
+
+    // A PDR that claims more children than it holds is skipped
+    assoc->num_children = numChildren + 1;
+    pldm_pdr_add(remote, pdr.data(), pdr.size(), 0, true);
+
+    EXPECT_FALSE(pldm_entity_association_tree_add_pdrs(copy, remote));
+    pldm_entity_association_tree_visit(copy, &out, &num);
+    EXPECT_EQ(num, 7u);
+    free(out);
+    pldm_entity entity{};
+    entity.entity_type = 6;
+    entity.entity_instance_num = 9;
+    ASSERT_NE(pldm_entity_association_tree_find(copy, &entity), nullptr);
+    EXPECT_EQ(entity.entity_container_id, 0x10);
+    node = pldm_entity_association_tree_find(copy, &entities[2]);
+    EXPECT_EQ(pldm_entity_get_num_children(node,
+                                           PLDM_ENTITY_ASSOCIAION_PHYSICAL),
+              2u);
+
+    // The next container id allocated does not clash with the merged ones
+    node = pldm_entity_association_tree_find(copy, &entities[3]);
+    auto l3 = pldm_entity_association_tree_add(
+        copy, &entities[0], node, PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    ASSERT_NE(l3, nullptr);
+    EXPECT_GT(entities[0].entity_container_id, 0x10);
+
+    pldm_pdr_destroy(remote);
+    pldm_pdr_destroy(repo);
+    pldm_entity_association_tree_destroy(copy);
+    pldm_entity_association_tree_destroy(tree);
+}
+
+TEST(EntityAssociationPDR, testTreeAddPdrsFromOtherRepo)
+{
+    //        1
+    //        |
+    //        2--3
+
+    pldm_entity entities[3]{};
+
+    entities[0].entity_type = 1;
+    entities[1].entity_type = 2;
+    entities[2].entity_type = 3;
+
+    auto tree = pldm_entity_association_tree_init();
+    auto l1 = pldm_entity_association_tree_add(tree, &entities[0], nullptr,
+                                               PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    pldm_entity_association_tree_add(tree, &entities[1], l1,
+                                     PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    pldm_entity_association_tree_add(tree, &entities[2], l1,
+                                     PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    auto repo = pldm_pdr_init();
+    pldm_entity_association_pdr_sync(tree, repo, false, nullptr);
+    ASSERT_EQ(pldm_pdr_get_record_count(repo), 1u);
+
+    // Another terminus puts 4 under 3, and 6 under a new container 5, in
+    // records 1 and 2 of its own repo
+    auto makePdr = [](const pldm_entity& container, uint16_t childType) {
+        std::vector<uint8_t> pdr(sizeof(pldm_pdr_hdr) +
+                                 sizeof(pldm_pdr_entity_association));
+        auto hdr = reinterpret_cast<pldm_pdr_hdr*>(pdr.data());
+        hdr->type = PLDM_PDR_ENTITY_ASSOCIATION;
+        hdr->length = htole16(pdr.size() - sizeof(pldm_pdr_hdr));
+        auto assoc = reinterpret_cast<pldm_pdr_entity_association*>(
+            pdr.data() + sizeof(pldm_pdr_hdr));
+        assoc->container_id = htole16(0x10);
+        assoc->association_type = PLDM_ENTITY_ASSOCIAION_PHYSICAL;
+        assoc->container.entity_type = htole16(container.entity_type);
+        assoc->container.entity_instance_num =
+            htole16(container.entity_instance_num);
+        assoc->container.entity_container_id =
+            htole16(container.entity_container_id);
+        assoc->num_children = 1;
+        assoc->children[0].entity_type = htole16(childType);
+        assoc->children[0].entity_instance_num = htole16(1);
+        assoc->children[0].entity_container_id = htole16(0x10);
+        return pdr;
+    };
+    pldm_entity container{};
+    container.entity_type = 5;
+    auto remote = pldm_pdr_init();
+    auto pdr = makePdr(entities[2], 4);
+    ASSERT_EQ(pldm_pdr_add(remote, pdr.data(), pdr.size(), 0, true), 1u);
+    pdr = makePdr(container, 6);
+    ASSERT_EQ(pldm_pdr_add(remote, pdr.data(), pdr.size(), 0, true), 2u);
+    EXPECT_TRUE(pldm_entity_association_tree_add_pdrs(tree, remote));
+
+    // The sync adds a PDR for 3 rather than rewriting the local record with
+    // the remote one's handle
+    pldm_entity_association_pdr_changes changes{};
+    pldm_entity_association_pdr_sync(tree, repo, false, &changes);
+    EXPECT_EQ(changes.num_added, 1u);
+    EXPECT_EQ(changes.num_modified, 0u);
+    pldm_entity_association_pdr_changes_free(&changes);
+    EXPECT_EQ(pldm_pdr_get_record_count(repo), 2u);
+
+    uint8_t* data = nullptr;
+    uint32_t size{};
+    uint32_t nextRecHdl{};
+    ASSERT_NE(pldm_pdr_find_record(repo, 1, &data, &size, &nextRecHdl),
+              nullptr);
+    pldm_entity_association_pdr_iter iter{};
+    ASSERT_TRUE(pldm_entity_association_pdr_iter_init(&iter, data, size));
+    EXPECT_EQ(iter.container.entity_type, 1u);
+    EXPECT_EQ(iter.num_children, 2u);
+
+    // Nor does a change under the new container 5
+    auto node = pldm_entity_association_tree_find(tree, &container);
+    ASSERT_NE(node, nullptr);
+    pldm_entity entity{};
+    entity.entity_type = 7;
+    pldm_entity_association_tree_add(tree, &entity, node,
+                                     PLDM_ENTITY_ASSOCIAION_PHYSICAL);
+    pldm_entity_association_pdr_sync(tree, repo, false, &changes);
+    EXPECT_EQ(changes.num_added, 1u);
+    EXPECT_EQ(changes.num_modified, 0u);
+    pldm_entity_association_pdr_changes_free(&changes);
+    ASSERT_NE(pldm_pdr_find_record(repo, 2, &data, &size, &nextRecHdl),
+              nullptr);
+    ASSERT_TRUE(pldm_entity_association_pdr_iter_init(&iter, data, size));
+    EXPECT_EQ(iter.container.entity_type, 3u);
+
+    pldm_pdr_destroy(remote);
+    pldm_pdr_destroy(repo);
+    pldm_entity_association_tree_destroy(tree);
 }
 
 TEST(NumericSensorPDR, testParse)
@@ -12,6 +12,26 @@ TEST(Crc32, CheckSumTest)
     EXPECT_EQ(checksum, 0xcbf43926);
 }
 
+TEST(Crc32, UpdateTest)
+{
+    const char* password = "123456789";
+    auto checksum = crc32_update(0, password, 4);
+    checksum = crc32_update(checksum, password + 4, 5);
+    EXPECT_EQ(checksum, 0xcbf43926);
+    EXPECT_EQ(crc32_update(checksum, password, 0), checksum);
+}
+
+TEST(Crc32, CombineTest)
+{
+    const char* password = "123456789";
+    for (size_t i = 0; i <= 9; ++i)
+    {
+        EXPECT_EQ(crc32_combine(crc32(password, i), crc32(password + i, 9 - i),
+                                9 - i),
+                  0xcbf43926u);
+    }
+}
+
 TEST(Crc8, CheckSumTest)
 {
     const char* data = "123456789";
@@ -0,0 +1,271 @@
+#ifndef PLDM_LOOPBACK_HPP
+#define PLDM_LOOPBACK_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "../base.h"
+#include "../firmware_update.h"
+#include "../platform.h"
+
+// In-process stand-in for MCTP: a pair of single producer, single consumer
+// rings, one carrying requests and the other responses, with a reference
+// responder built on the encode/decode APIs at the far end.
+
+namespace pldm_loopback
+{
+
+constexpr size_t cacheLine = 64;
+
+// Fixed-size slots, so a message is copied in and out once and nothing is
+// allocated after construction
+template <size_t Slots, size_t SlotSize>
+class SpscRing
+{
+    static_assert((Slots & (Slots - 1)) == 0, "Slots must be a power of two");
+
+  public:
+    static constexpr size_t maxMessageSize = SlotSize;
+
+    bool push(const uint8_t* data, size_t size)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - headCache_ == Slots)
+        {
+            headCache_ = head_.load(std::memory_order_acquire);
+            if (tail - headCache_ == Slots)
+            {
+                return false;
+            }
+        }
+        Slot& slot = slots_[tail & (Slots - 1)];
+        slot.size = size;
+        std::memcpy(slot.data.data(), data, size);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Returns the size of the message, or 0 if the ring is empty
+    size_t pop(uint8_t* data)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tailCache_)
+        {
+            tailCache_ = tail_.load(std::memory_order_acquire);
+            if (head == tailCache_)
+            {
+                return 0;
+            }
+        }
+        const Slot& slot = slots_[head & (Slots - 1)];
+        size_t size = slot.size;
+        std::memcpy(data, slot.data.data(), size);
+        head_.store(head + 1, std::memory_order_release);
+        return size;
+    }
+
+  private:
+    struct Slot
+    {
+        size_t size;
+        std::array<uint8_t, SlotSize> data;
+    };
+
+    // Producer and consumer indices on their own cache lines, each with a
+    // copy of the other side's index to avoid reading it on every call
+    alignas(cacheLine) std::atomic<size_t> tail_{0};
+    size_t headCache_ = 0;
+    alignas(cacheLine) std::atomic<size_t> head_{0};
+    size_t tailCache_ = 0;
+    alignas(cacheLine) std::array<Slot, Slots> slots_{};
+};
+
+struct Link
+{
+    using Ring = SpscRing<64, 256>;
+
+    Ring requests;
+    Ring responses;
+};
+
+constexpr uint8_t tid = 9;
+constexpr uint32_t pdrRecordHandle = 1;
+constexpr uint16_t sensorId = 3;
+constexpr uint16_t sensorReading = 1234;
+constexpr uint32_t imageSize = 4096;
+constexpr uint32_t maxTransferSize = 64;
+
+inline const std::array<uint8_t, 32>& pdr()
+{
+    static const std::array<uint8_t, 32> record = [] {
+        std::array<uint8_t, 32> bytes{};
+        for (size_t i = 0; i < bytes.size(); ++i)
+        {
+            bytes[i] = static_cast<uint8_t>(i * 7);
+        }
+        return bytes;
+    }();
+    return record;
+}
+
+inline const std::vector<uint8_t>& image()
+{
+    static const std::vector<uint8_t> bytes = [] {
+        std::vector<uint8_t> data(imageSize);
+        for (size_t i = 0; i < data.size(); ++i)
+        {
+            data[i] = static_cast<uint8_t>(i ^ (i >> 8));
+        }
+        return data;
+    }();
+    return bytes;
+}
+
+// Answers GetTID, GetPDR, GetSensorReading and RequestFirmwareData through a
+// pldm_responder
+class Responder
+{
+  public:
+    Responder() : responder_(pldm_responder_init())
+    {
+        pldm_responder_register(responder_, PLDM_BASE, PLDM_GET_TID, getTid,
+                                nullptr);
+        pldm_responder_register(responder_, PLDM_PLATFORM, PLDM_GET_PDR,
+                                getPdr, nullptr);
+        pldm_responder_register(responder_, PLDM_PLATFORM,
+                                PLDM_GET_SENSOR_READING, getSensorReading,
+                                nullptr);
+        pldm_responder_register(responder_, PLDM_FWUP,
+                                PLDM_REQUEST_FIRMWARE_DATA,
+                                requestFirmwareData, nullptr);
+
+        static std::once_flag fwUpdateInit;
+        std::call_once(fwUpdateInit, [] {
+            initialize_fw_update(maxTransferSize, imageSize);
+        });
+    }
+
+    ~Responder()
+    {
+        pldm_responder_destroy(responder_);
+    }
+
+    Responder(const Responder&) = delete;
+    Responder& operator=(const Responder&) = delete;
+
+    // Answer one request, if there is one
+    bool poll(Link& link)
+    {
+        size_t size = link.requests.pop(request_.data());
+        if (size == 0)
+        {
+            return false;
+        }
+
+        auto request = reinterpret_cast<const pldm_msg*>(request_.data());
+        auto response = reinterpret_cast<pldm_msg*>(response_.data());
+        size_t responseLength = response_.size() - sizeof(pldm_msg_hdr);
+        if (pldm_responder_dispatch(responder_, request,
+                                    size - sizeof(pldm_msg_hdr), response,
+                                    &responseLength) != PLDM_SUCCESS)
+        {
+            responseLength = 1;
+            encode_cc_only_resp(request->hdr.instance_id, request->hdr.type,
+                                request->hdr.command, PLDM_ERROR, response);
+        }
+        while (!link.responses.push(response_.data(),
+                                    sizeof(pldm_msg_hdr) + responseLength))
+        {
+        }
+        return true;
+    }
+
+  private:
+    static int getTid(void*, const pldm_header_info* hdr, const pldm_msg*,
+                      size_t, pldm_msg* response, size_t* responseLength)
+    {
+        *responseLength = PLDM_GET_TID_RESP_BYTES;
+        return encode_get_tid_resp(hdr->instance, PLDM_SUCCESS, tid, response);
+    }
+
+    static int getPdr(void*, const pldm_header_info* hdr,
+                      const pldm_msg* request, size_t payloadLength,
+                      pldm_msg* response, size_t* responseLength)
+    {
+        uint32_t recordHandle = 0;
+        uint32_t transferHandle = 0;
+        uint8_t opFlag = 0;
+        uint16_t requestCount = 0;
+        uint16_t changeNumber = 0;
+        int rc = decode_get_pdr_req(request, payloadLength, &recordHandle,
+                                    &transferHandle, &opFlag, &requestCount,
+                                    &changeNumber);
+        if (rc != PLDM_SUCCESS || recordHandle != pdrRecordHandle ||
+            requestCount < pdr().size())
+        {
+            return rc != PLDM_SUCCESS ? rc : PLDM_ERROR_INVALID_DATA;
+        }
+        *responseLength = PLDM_GET_PDR_MIN_RESP_BYTES + pdr().size();
+        return encode_get_pdr_resp(hdr->instance, PLDM_SUCCESS, 0, 0,
+                                   PLDM_START_AND_END, pdr().size(),
+                                   pdr().data(), 0, response);
+    }
+
+    static int getSensorReading(void*, const pldm_header_info* hdr,
+                                const pldm_msg* request, size_t payloadLength,
+                                pldm_msg* response, size_t* responseLength)
+    {
+        uint16_t id = 0;
+        bool8_t rearm = 0;
+        int rc =
+            decode_get_sensor_reading_req(request, payloadLength, &id, &rearm);
+        if (rc != PLDM_SUCCESS || id != sensorId)
+        {
+            return rc != PLDM_SUCCESS ? rc : PLDM_ERROR_INVALID_DATA;
+        }
+        uint16_t reading = sensorReading;
+        *responseLength = PLDM_GET_SENSOR_READING_MIN_RESP_BYTES + 1;
+        return encode_get_sensor_reading_resp(
+            hdr->instance, PLDM_SUCCESS, PLDM_SENSOR_DATA_SIZE_UINT16,
+            PLDM_SENSOR_ENABLED, PLDM_NO_EVENT_GENERATION, PLDM_SENSOR_NORMAL,
+            PLDM_SENSOR_NORMAL, PLDM_SENSOR_NORMAL,
+            reinterpret_cast<uint8_t*>(&reading), response, *responseLength);
+    }
+
+    static int requestFirmwareData(void*, const pldm_header_info* hdr,
+                                   const pldm_msg* request,
+                                   size_t payloadLength, pldm_msg* response,
+                                   size_t* responseLength)
+    {
+        // firmware_update.c keeps the requested segment in file scope state
+        // between the decode and the encode
+        static std::mutex fwUpdateMutex;
+        std::lock_guard<std::mutex> lock(fwUpdateMutex);
+
+        uint32_t offset = 0;
+        uint32_t length = 0;
+        int rc = decode_request_firmware_data_req(request, payloadLength,
+                                                  &offset, &length);
+        if (rc != PLDM_SUCCESS)
+        {
+            return rc;
+        }
+        variable_field portion{image().data() + offset, length};
+        *responseLength = length + 1;
+        return encode_request_firmware_data_resp(
+            hdr->instance, response, *responseLength, PLDM_SUCCESS, &portion);
+    }
+
+    pldm_responder* responder_;
+    std::array<uint8_t, Link::Ring::maxMessageSize> request_{};
+    std::array<uint8_t, Link::Ring::maxMessageSize> response_{};
+};
+
+} // namespace pldm_loopback
+
+#endif /* PLDM_LOOPBACK_HPP */
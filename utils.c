@@ -81,15 +81,77 @@ static const uint8_t crc8_table[] = {
     0xde, 0xd9, 0xd0, 0xd7, 0xc2, 0xc5, 0xcc, 0xcb, 0xe6, 0xe1, 0xe8, 0xef,
     0xfa, 0xfd, 0xf4, 0xf3};
 
-uint32_t crc32(const void *data, size_t size)
+uint32_t crc32_update(uint32_t crc, const void *data, size_t size)
 {
 	const uint8_t *p = data;
-	uint32_t crc = ~0U;
+	crc = ~crc;
 	while (size--)
 		crc = crc32_tab[(crc ^ *p++) & 0xff] ^ (crc >> 8);
 	return crc ^ ~0U;
 }
 
+uint32_t crc32(const void *data, size_t size)
+{
+	return crc32_update(0, data, size);
+}
+
+/* GF(2) matrix helpers for crc32_combine(), as in zlib */
+static uint32_t gf2_matrix_times(const uint32_t *mat, uint32_t vec)
+{
+	uint32_t sum = 0;
+	while (vec) {
+		if (vec & 1)
+			sum ^= *mat;
+		vec >>= 1;
+		mat++;
+	}
+	return sum;
+}
+
+static void gf2_matrix_square(uint32_t *square, const uint32_t *mat)
+{
+	for (int n = 0; n < 32; n++)
+		square[n] = gf2_matrix_times(mat, mat[n]);
+}
+
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, size_t len2)
+{
+	uint32_t even[32]; /* even-power-of-two zeros operator */
+	uint32_t odd[32];  /* odd-power-of-two zeros operator */
+
+	if (len2 == 0)
+		return crc1 ^ crc2;
+
+	/* operator for one zero bit */
+	odd[0] = 0xedb88320;
+	uint32_t row = 1;
+	for (int n = 1; n < 32; n++) {
+		odd[n] = row;
+		row <<= 1;
+	}
+	gf2_matrix_square(even, odd); /* two zero bits */
+	gf2_matrix_square(odd, even); /* four zero bits */
+
+	/* apply len2 zero bytes to crc1, the first square gives the operator
+	 * for one zero byte
+	 */
+	do {
+		gf2_matrix_square(even, odd);
+		if (len2 & 1)
+			crc1 = gf2_matrix_times(even, crc1);
+		len2 >>= 1;
+		if (len2 == 0)
+			break;
+
+		gf2_matrix_square(odd, even);
+		if (len2 & 1)
+			crc1 = gf2_matrix_times(odd, crc1);
+		len2 >>= 1;
+	} while (len2 != 0);
+
+	return crc1 ^ crc2;
+}
+
 uint8_t crc8(const void *data, size_t size)
 {
 	const uint8_t *p = data;
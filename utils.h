@@ -35,6 +35,31 @@ uint8_t crc8(const void *data, size_t size);
  */
 uint32_t crc32(const void *data, size_t size);
 
+/** @brief Continue a Crc32 with more data
+ *
+ *  crc32_update(crc32(a, a_size), b, b_size) is the checksum of a followed by
+ *  b, and crc32_update(0, data, size) is crc32(data, size)
+ *
+ *  @param[in] crc - The checksum of the data so far
+ *  @param[in] data - Pointer to the data that follows
+ *  @param[in] size - Size of the data
+ *  @return The checksum
+ */
+uint32_t crc32_update(uint32_t crc, const void *data, size_t size);
+
+/** @brief Combine the Crc32s of two consecutive pieces of data
+ *
+ *  crc32_combine(crc32(a, a_size), crc32(b, b_size), b_size) is
+ *  crc32(a followed by b), computed in time logarithmic in b_size without
+ *  reading the data again.
+ *
+ *  @param[in] crc1 - The checksum of the first piece
+ *  @param[in] crc2 - The checksum of the second piece
+ *  @param[in] len2 - Size of the second piece
+ *  @return The checksum of the first piece followed by the second
+ */
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, size_t len2);
+
 /** @brief Convert ver32_t to string
  *  @param[in] version - Pointer to ver32_t
  *  @param[out] buffer - Pointer to the buffer